@@ -0,0 +1,161 @@
+/*
+ * This file contains the definition of an interface for pluggable memory
+ * allocators that can be handed to the data structures in this directory,
+ * along with the allocators that come with it.
+ */
+
+#ifndef __ALLOCATOR_H
+#define __ALLOCATOR_H
+
+#include <stddef.h>
+
+/*
+ * Structure used to represent a memory allocator.  A data structure created
+ * with an allocator gets all of its memory from that allocator's functions
+ * instead of calling malloc() and free() directly.  Each function is passed
+ * the allocator's ctx pointer as its first argument, and callers always pass
+ * back the size they originally asked for when resizing or releasing memory,
+ * so allocators don't need to record the sizes of their allocations.
+ *
+ * Fields:
+ *   alloc - allocates size bytes and returns a pointer to them
+ *   resize - resizes an allocation of old_size bytes to new_size bytes,
+ *     preserving its contents up to the smaller of the two sizes, and returns
+ *     a pointer to the (possibly moved) allocation
+ *   release - releases an allocation of size bytes
+ *   ctx - allocator-specific state passed to each of the functions above
+ */
+struct allocator {
+  void* (*alloc)(void* ctx, size_t size);
+  void* (*resize)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+  void (*release)(void* ctx, void* ptr, size_t size);
+  void* ctx;
+};
+
+/*
+ * The default allocator, used by data structures that aren't given one.  It
+ * uses malloc(), realloc() and free() for small allocations.  Allocations of a
+ * megabyte or more are mapped directly with mmap() so that they can be grown
+ * with mremap() instead of being copied.
+ */
+extern const struct allocator system_allocator;
+
+
+/*
+ * Structure used to represent a bump arena.  An arena hands out memory by
+ * bumping a pointer through large blocks and never frees individual
+ * allocations.  Instead, everything allocated from an arena is released at
+ * once by arena_reset() or arena_free().  This makes it a good fit for data
+ * structures that are built, used and then thrown away as a whole.  There's
+ * no need to call a data structure's own free function before resetting the
+ * arena it was allocated from.
+ */
+struct arena;
+
+/*
+ * Creates a new, empty arena and returns a pointer to it.
+ *
+ * Params:
+ *   block_size - the size in bytes of each block the arena allocates from.
+ *     Allocations larger than this get a block of their own.  May be 0 to use
+ *     a default size.
+ */
+struct arena* arena_create(size_t block_size);
+
+/*
+ * Frees an arena along with all of the memory allocated from it.
+ *
+ * Params:
+ *   arena - the arena to be destroyed.  May not be NULL.
+ */
+void arena_free(struct arena* arena);
+
+/*
+ * Allocates memory from an arena.  The memory is suitably aligned for any
+ * type and stays valid until the arena is reset or freed.
+ *
+ * Params:
+ *   arena - the arena from which to allocate.  May not be NULL.
+ *   size - the number of bytes to allocate
+ */
+void* arena_alloc(struct arena* arena, size_t size);
+
+/*
+ * Releases all of the memory allocated from an arena at once, so it can be
+ * reused for new allocations.  The arena keeps its first block to avoid
+ * going back to the system for it.
+ *
+ * Params:
+ *   arena - the arena to be reset.  May not be NULL.
+ */
+void arena_reset(struct arena* arena);
+
+/*
+ * Returns an allocator that allocates from a given arena.  Releasing memory
+ * through this allocator is a no-op except for the most recent allocation,
+ * which is rolled back, and resizing the most recent allocation extends it in
+ * place when there is room.
+ *
+ * Params:
+ *   arena - the arena to be wrapped.  May not be NULL.
+ */
+struct allocator arena_allocator(struct arena* arena);
+
+
+/*
+ * Structure used to represent a pool of fixed-size objects.  A pool carves
+ * large blocks into equal slots and keeps released slots on a free list, so
+ * allocating and releasing an object are each a couple of pointer operations.
+ * This suits node-based structures like linked lists and trees, whose
+ * allocations are all the same size.
+ */
+struct pool;
+
+/*
+ * Creates a new, empty pool and returns a pointer to it.
+ *
+ * Params:
+ *   obj_size - the size in bytes of each object in the pool.  Must be greater
+ *     than 0.
+ *   objs_per_block - the number of objects to carve from each block the pool
+ *     allocates.  May be 0 to use a default count.
+ */
+struct pool* pool_create(size_t obj_size, size_t objs_per_block);
+
+/*
+ * Frees a pool along with all of the objects allocated from it.
+ *
+ * Params:
+ *   pool - the pool to be destroyed.  May not be NULL.
+ */
+void pool_free(struct pool* pool);
+
+/*
+ * Allocates a single object from a pool.
+ *
+ * Params:
+ *   pool - the pool from which to allocate.  May not be NULL.
+ */
+void* pool_alloc(struct pool* pool);
+
+/*
+ * Returns a single object to a pool so that its slot can be reused.
+ *
+ * Params:
+ *   pool - the pool the object was allocated from.  May not be NULL.
+ *   obj - the object to be released.
+ */
+void pool_release(struct pool* pool, void* obj);
+
+/*
+ * Returns an allocator that allocates from a given pool.  Requests through
+ * this allocator may not be larger than the pool's object size, which means
+ * it is only suitable for data structures whose allocations all fit in one
+ * object.
+ *
+ * Params:
+ *   pool - the pool to be wrapped.  May not be NULL.
+ */
+struct allocator pool_allocator(struct pool* pool);
+
+#endif
@@ -0,0 +1,684 @@
+/*
+ * This file contains a benchmark comparing the algorithms that
+ * sort_by_inventory_with() can use to sort a large, randomly ordered array of
+ * products, along with benchmarks of building product arrays, of multi-key
+ * sorting, of incremental inventory updates, of scans over an array of
+ * products versus a columnar catalog at each SIMD level the CPU supports, of
+ * filters, top-k queries, price percentiles and name lookups, and of loading
+ * products from and writing them to TSV files.  Run it as
+ *
+ *   ./bench [num_products]
+ *
+ * where num_products defaults to 1000000.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "products.h"
+#include "product_columns.h"
+#include "product_io.h"
+#include "product_index.h"
+#include "product_filter.h"
+#include "product_catalog.h"
+#include "product_sketch.h"
+#include "simd_kernels.h"
+#include "dynarray.h"
+#include "dynarray_sort.h"
+
+/*
+ * This is the number of products sorted when none is given on the command
+ * line.
+ */
+#define BENCH_DEFAULT_PRODUCTS 1000000
+
+/*
+ * The size of the buffers make_bench_inputs() formats names into, which is
+ * enough for "product " followed by any 64-bit index.
+ */
+#define BENCH_NAME_SIZE 32
+
+
+/*
+ * Returns the current time in seconds from a monotonic clock.
+ */
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Allocates the name, inventory and price arrays for n products and fills
+ * them after seeding rand() with 1, so every benchmark sees the same input.
+ * Product i's name is name_format formatted with i as a size_t, its
+ * inventory is random below max_inventory, and its price is a random number
+ * of cents below 1000.00.  The arrays are freed with free_bench_inputs().
+ */
+void make_bench_inputs(size_t n, const char* name_format, int max_inventory,
+    char*** names, int** inventories, float** prices) {
+  size_t i;
+  *names = malloc(n * sizeof(char*));
+  *inventories = malloc(n * sizeof(int));
+  *prices = malloc(n * sizeof(float));
+  srand(1);
+  for (i = 0; i < n; i++) {
+    (*names)[i] = malloc(BENCH_NAME_SIZE);
+    snprintf((*names)[i], BENCH_NAME_SIZE, name_format, i);
+    (*inventories)[i] = rand() % max_inventory;
+    (*prices)[i] = (rand() % 100000) / 100.0;
+  }
+}
+
+
+/*
+ * Frees the arrays for n products allocated by make_bench_inputs().
+ */
+void free_bench_inputs(size_t n, char** names, int* inventories,
+    float* prices) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    free(names[i]);
+  }
+  free(prices);
+  free(inventories);
+  free(names);
+}
+
+
+/*
+ * Builds an array of n products with random inventories, sorts it with the
+ * given backend, and prints how long the sort took.  The inventories are
+ * drawn from the same seed every time, so every backend sorts the same input.
+ */
+void bench_backend(const char* label, enum sort_backend backend, size_t n,
+    int max_inventory) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray* products;
+  double start, elapsed;
+  size_t i;
+
+  make_bench_inputs(n, "product", max_inventory, &names, &inventories,
+    &prices);
+  products = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  sort_by_inventory_with(products, backend);
+  elapsed = now() - start;
+
+  for (i = 1; i < n; i++) {
+    struct product* prev = dynarray_get(products, i - 1);
+    struct product* cur = dynarray_get(products, i);
+    if (prev->inventory > cur->inventory) {
+      printf("  %s: NOT SORTED at %zu\n", label, i);
+      break;
+    }
+  }
+  printf("  %-10s %8.3f s\n", label, elapsed);
+
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds an array of n products and a columnar catalog holding the same
+ * products, and prints how long it takes to find the product with the highest
+ * investment in the array and in the catalog at each SIMD level.
+ */
+void bench_scans(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray* products;
+  struct product_columns* pc;
+  double start, elapsed;
+  size_t max;
+  const char* level_names[] = { "scalar", "sse2", "avx2" };
+  enum simd_level best = simd_get_level();
+  int level;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+  pc = create_product_columns(n, names, inventories, prices);
+
+  start = now();
+  struct product* p = find_max_investment(products);
+  elapsed = now() - start;
+  printf("  %-10s %8.3f s\n", "array", elapsed);
+
+  for (level = SIMD_SCALAR; level <= SIMD_AVX2; level++) {
+    if (!simd_level_supported(level)) {
+      continue;
+    }
+    simd_set_level(level);
+    start = now();
+    max = product_columns_find_max_investment(pc);
+    elapsed = now() - start;
+    printf("  %-10s %8.3f s\n", level_names[level], elapsed);
+    if (p->inventory != pc->inventories[max] || p->price != pc->prices[max]) {
+      printf("  %s: WRONG PRODUCT\n", level_names[level]);
+    }
+  }
+  simd_set_level(best);
+
+  free_product_columns(pc);
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds an array of n products and a columnar catalog holding the same
+ * products, and prints how long it takes to find the products with inventory
+ * below 10 and price above 50 with a loop over the array, and with a filter
+ * over the catalog at each SIMD level the CPU supports and on all online
+ * CPUs.
+ */
+void bench_filter(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  uint64_t* bitmap = malloc(PRODUCT_FILTER_WORDS(n) * sizeof(uint64_t));
+  struct dynarray* products;
+  struct product_columns* pc;
+  struct product_filter* pf;
+  double start;
+  size_t i, expected = 0, count;
+  const char* level_names[] = { "scalar", "sse2", "avx2" };
+  enum simd_level best = simd_get_level();
+  int level;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+  pc = create_product_columns(n, names, inventories, prices);
+  pf = product_filter_create();
+  product_filter_add_inventory(pf, SIMD_CMP_LT, 10);
+  product_filter_add_price(pf, SIMD_CMP_GT, 50.0);
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    struct product* p = dynarray_get(products, i);
+    if (p->inventory < 10 && p->price > 50.0) {
+      expected++;
+    }
+  }
+  printf("  %-10s %8.3f s\n", "array", now() - start);
+
+  for (level = SIMD_SCALAR; level <= SIMD_AVX2; level++) {
+    if (!simd_level_supported(level)) {
+      continue;
+    }
+    simd_set_level(level);
+    start = now();
+    count = product_filter_run(pf, pc, bitmap, 1);
+    printf("  %-10s %8.3f s\n", level_names[level], now() - start);
+    if (count != expected) {
+      printf("  %s: WRONG COUNT\n", level_names[level]);
+    }
+  }
+  simd_set_level(best);
+
+  start = now();
+  count = product_filter_run(pf, pc, bitmap, 0);
+  printf("  %-10s %8.3f s\n", "all CPUs", now() - start);
+  if (count != expected) {
+    printf("  all CPUs: WRONG COUNT\n");
+  }
+
+  product_filter_free(pf);
+  free_product_columns(pc);
+  free_product_array(products);
+  free(bitmap);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Comparison function ordering products by ascending inventory, descending
+ * price and name, the same order sort_by_inventory_price_name() sorts into.
+ */
+int compare_inventory_price_name(void* a, void* b) {
+  struct product* pa = a;
+  struct product* pb = b;
+  if (pa->inventory != pb->inventory) {
+    return pa->inventory < pb->inventory ? -1 : 1;
+  }
+  if (pa->price != pb->price) {
+    return pa->price > pb->price ? -1 : 1;
+  }
+  return strcmp(pa->name, pb->name);
+}
+
+
+/*
+ * Prints how long it takes to build an array of n products with
+ * create_product_array(), with create_product_array_interned(), and with
+ * create_product_array_parallel() on all online CPUs.
+ */
+void bench_build(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct string_arena* sa;
+  struct dynarray* products;
+  double start;
+
+  make_bench_inputs(n, "product %zu", 1000, &names, &inventories, &prices);
+
+  start = now();
+  products = create_product_array(n, names, inventories, prices);
+  printf("  %-10s %8.3f s\n", "malloc", now() - start);
+  free_product_array(products);
+
+  sa = string_arena_create();
+  start = now();
+  products = create_product_array_interned(n, names, inventories, prices, sa);
+  printf("  %-10s %8.3f s\n", "interned", now() - start);
+  free_product_array_interned(products);
+  string_arena_free(sa);
+
+  sa = string_arena_create();
+  start = now();
+  products = create_product_array_parallel(n, names, inventories, prices, sa,
+    0);
+  printf("  %-10s %8.3f s\n", "parallel", now() - start);
+  free_product_array_interned(products);
+  string_arena_free(sa);
+
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds two identical arrays of n products and prints how long it takes to
+ * sort one by inventory, price and name with dynarray_sort() and that
+ * comparison function, and the other with sort_by_inventory_price_name().
+ */
+void bench_multikey(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray *a, *b;
+  double start;
+  size_t i;
+
+  make_bench_inputs(n, "product %zu", 1000, &names, &inventories, &prices);
+  /*
+   * Prices in quarters below 25.00 leave many ties on inventory and price for
+   * the names to break.
+   */
+  for (i = 0; i < n; i++) {
+    prices[i] = (rand() % 100) / 4.0;
+  }
+  a = create_product_array(n, names, inventories, prices);
+  b = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  dynarray_sort(a, compare_inventory_price_name);
+  printf("  %-10s %8.3f s\n", "comparator", now() - start);
+
+  start = now();
+  sort_by_inventory_price_name(b);
+  printf("  %-10s %8.3f s\n", "keyed", now() - start);
+
+  for (i = 1; i < n; i++) {
+    if (compare_inventory_price_name(dynarray_get(b, i - 1),
+        dynarray_get(b, i)) > 0) {
+      printf("  keyed: NOT SORTED at %zu\n", i);
+      break;
+    }
+  }
+
+  free_product_array(a);
+  free_product_array(b);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds an array of n products and prints how long it takes to apply 1000
+ * random inventory changes to a catalog holding them and query its largest
+ * investment after each one, versus changing the array's products, sorting it
+ * again and calling find_max_investment() after each change.  The resorting
+ * is timed over just 10 changes, since each one costs a full sort.
+ */
+void bench_catalog(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray* products;
+  struct product_catalog* catalog;
+  double start;
+  size_t i;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+  catalog = product_catalog_create(products);
+
+  start = now();
+  for (i = 0; i < 1000; i++) {
+    struct product* p = dynarray_get(products, rand() % n);
+    product_update_inventory(catalog, p, rand() % 1000);
+    product_catalog_max_investment(catalog);
+  }
+  printf("  %-10s %8.3f s (1000 updates)\n", "catalog", now() - start);
+
+  start = now();
+  for (i = 0; i < 10; i++) {
+    ((struct product*)dynarray_get(products, rand() % n))->inventory =
+      rand() % 1000;
+    sort_by_inventory(products);
+    find_max_investment(products);
+  }
+  printf("  %-10s %8.3f s (10 updates)\n", "resort", now() - start);
+
+  product_catalog_free(catalog);
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds an array of n products and prints how long it takes to find the 100
+ * with the largest investments on one thread and on all online CPUs.
+ */
+void bench_top_k(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct product* out[100];
+  struct dynarray* products;
+  double start;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  find_top_k_by_investment(products, 100, out);
+  printf("  %-10s %8.3f s\n", "1 thread", now() - start);
+
+  start = now();
+  find_top_k_by_investment_parallel(products, 100, out, 0);
+  printf("  %-10s %8.3f s\n", "all CPUs", now() - start);
+
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Comparison function for qsort() to sort floats into ascending order.
+ */
+int compare_floats(const void* a, const void* b) {
+  float fa = *(const float*)a, fb = *(const float*)b;
+  return fa < fb ? -1 : fa > fb;
+}
+
+
+/*
+ * Builds an array of n products and prints how long it takes to find the
+ * 50th, 90th and 99th percentile prices by sorting a copy of the prices and
+ * with a quantile sketch, and to build a histogram of the inventories.
+ */
+void bench_sketch(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  float* sorted = malloc(n * sizeof(float));
+  double qs[] = {0.5, 0.9, 0.99};
+  float exact[3], estimate[3];
+  struct dynarray* products;
+  struct quantile_sketch* sketch;
+  struct histogram* hist;
+  double start;
+  size_t i;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    sorted[i] = ((struct product*)dynarray_get(products, i))->price;
+  }
+  qsort(sorted, n, sizeof(float), compare_floats);
+  for (i = 0; i < 3; i++) {
+    exact[i] = sorted[(size_t)(qs[i] * (n - 1))];
+  }
+  printf("  %-10s %8.3f s\n", "sort", now() - start);
+
+  start = now();
+  sketch = quantile_sketch_create(QUANTILE_SKETCH_DEFAULT_K);
+  quantile_sketch_add_prices(sketch, products);
+  for (i = 0; i < 3; i++) {
+    estimate[i] = quantile_sketch_quantile(sketch, qs[i]);
+  }
+  printf("  %-10s %8.3f s\n", "sketch", now() - start);
+  for (i = 0; i < 3; i++) {
+    printf("  p%-9g %8.2f exact, %8.2f estimated\n", qs[i] * 100, exact[i],
+      estimate[i]);
+  }
+
+  start = now();
+  hist = histogram_create(0, 1000, 20);
+  histogram_add_inventories(hist, products);
+  printf("  %-10s %8.3f s\n", "histogram", now() - start);
+
+  histogram_free(hist);
+  quantile_sketch_free(sketch);
+  free_product_array(products);
+  free(sorted);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Builds an array of n products with distinct names and prints how long it
+ * takes to build an index over them, to look every product up by name in the
+ * index, and to find 100 of them by scanning the array.
+ */
+void bench_index(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray* products;
+  struct product_index* pi;
+  double start;
+  size_t i, j, found = 0;
+
+  make_bench_inputs(n, "product %zu", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  pi = product_index_build(products);
+  printf("  %-10s %8.3f s\n", "build", now() - start);
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    found += product_index_lookup(pi, names[i]) == i;
+  }
+  printf("  %-10s %8.3f s (%zu lookups)\n", "index", now() - start, n);
+
+  start = now();
+  for (i = 0; i < n; i += n / 100 + 1) {
+    for (j = 0; j < n; j++) {
+      struct product* p = dynarray_get(products, j);
+      if (strcmp(p->name, names[i]) == 0) {
+        break;
+      }
+    }
+  }
+  printf("  %-10s %8.3f s (100 lookups)\n", "scan", now() - start);
+  if (found != n) {
+    printf("  INDEX LOOKUP FAILED\n");
+  }
+
+  product_index_free(pi);
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Writes n products to a TSV file, then prints how long it takes to load
+ * them back with load_product_array_tsv() using one thread and using all
+ * online CPUs.  Then prints how long it takes to save the loaded products as
+ * a binary snapshot and to load the snapshot back with and without
+ * verification.
+ */
+void bench_load(size_t n) {
+  const char* path = "bench_products.tsv";
+  const char* snapshot_path = "bench_products.snap";
+  struct product_snapshot* ps;
+  int verify;
+  FILE* f = fopen(path, "w");
+  struct string_arena* sa;
+  struct dynarray* products;
+  double start, elapsed;
+  size_t i;
+  int threads;
+
+  srand(1);
+  for (i = 0; i < n; i++) {
+    fprintf(f, "product %d\t%d\t%f\n", rand() % 100000, rand() % 1000,
+      (rand() % 100000) / 100.0);
+  }
+  fclose(f);
+
+  for (threads = 1; threads >= 0; threads--) {
+    sa = string_arena_create();
+    start = now();
+    products = load_product_array_tsv(path, sa, threads);
+    elapsed = now() - start;
+    printf("  %-10s %8.3f s\n", threads ? "1 thread" : "all CPUs", elapsed);
+    if (!products || dynarray_length(products) != n) {
+      printf("  LOAD FAILED\n");
+      products = NULL;
+    } else if (threads) {
+      free_product_array_interned(products);
+    }
+    if (threads) {
+      string_arena_free(sa);
+    }
+  }
+  remove(path);
+  if (!products) {
+    string_arena_free(sa);
+    return;
+  }
+
+  start = now();
+  save_products_binary(products, snapshot_path);
+  printf("  %-10s %8.3f s\n", "snap save", now() - start);
+  for (verify = 1; verify >= 0; verify--) {
+    start = now();
+    ps = load_products_binary(snapshot_path, verify);
+    elapsed = now() - start;
+    printf("  %-10s %8.3f s\n", verify ? "snap check" : "snap map", elapsed);
+    if (!ps || product_snapshot_length(ps) != n) {
+      printf("  SNAPSHOT LOAD FAILED\n");
+    }
+    if (ps) {
+      product_snapshot_close(ps);
+    }
+  }
+
+  remove(snapshot_path);
+  free_product_array_interned(products);
+  string_arena_free(sa);
+}
+
+
+/*
+ * Builds an array of n products and prints how long it takes to write them
+ * all to /dev/null with fprintf() in print_products()' format, and with
+ * write_products_tsv() and write_products_tsv_fd().
+ */
+void bench_write(size_t n) {
+  char** names;
+  int* inventories;
+  float* prices;
+  struct dynarray* products;
+  double start;
+  FILE* f = fopen("/dev/null", "w");
+  size_t i;
+
+  make_bench_inputs(n, "product", 1000, &names, &inventories, &prices);
+  products = create_product_array(n, names, inventories, prices);
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    struct product* p = dynarray_get(products, i);
+    fprintf(f, "%s\t%d\t%f\n", p->name, p->inventory, p->price);
+  }
+  fflush(f);
+  printf("  %-10s %8.3f s\n", "fprintf", now() - start);
+
+  start = now();
+  write_products_tsv(products, f);
+  fflush(f);
+  printf("  %-10s %8.3f s\n", "stream", now() - start);
+
+  start = now();
+  write_products_tsv_fd(products, fileno(f));
+  printf("  %-10s %8.3f s\n", "fd", now() - start);
+
+  fclose(f);
+  free_product_array(products);
+  free_bench_inputs(n, names, inventories, prices);
+}
+
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_PRODUCTS;
+
+  printf("\n== Sorting %zu products with inventories in [0, %d):\n", n,
+    RAND_MAX);
+  bench_backend("quicksort", SORT_BACKEND_QUICKSORT, n, RAND_MAX);
+  bench_backend("radix", SORT_BACKEND_RADIX, n, RAND_MAX);
+  bench_backend("parallel", SORT_BACKEND_PARALLEL, n, RAND_MAX);
+
+  printf("\n== Sorting %zu products with inventories in [0, 1000):\n", n);
+  bench_backend("quicksort", SORT_BACKEND_QUICKSORT, n, 1000);
+  bench_backend("radix", SORT_BACKEND_RADIX, n, 1000);
+  bench_backend("parallel", SORT_BACKEND_PARALLEL, n, 1000);
+
+  printf("\n== Building an array of %zu products:\n", n);
+  bench_build(n);
+
+  printf("\n== Sorting %zu products by inventory, price and name:\n", n);
+  bench_multikey(n);
+
+  printf("\n== Updating inventories of %zu sorted products:\n", n);
+  bench_catalog(n);
+
+  printf("\n== Finding the max investment among %zu products:\n", n);
+  bench_scans(n);
+
+  printf("\n== Filtering %zu products by inventory and price:\n", n);
+  bench_filter(n);
+
+  printf("\n== Finding the top 100 investments among %zu products:\n", n);
+  bench_top_k(n);
+
+  printf("\n== Finding price percentiles of %zu products:\n", n);
+  bench_sketch(n);
+
+  printf("\n== Finding %zu products by name:\n", n);
+  bench_index(n);
+
+  printf("\n== Loading %zu products from a TSV file:\n", n);
+  bench_load(n);
+
+  printf("\n== Writing %zu products as TSV:\n", n);
+  bench_write(n);
+
+  return 0;
+}
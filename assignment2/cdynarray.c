@@ -0,0 +1,162 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * a concurrent, append-only dynamic array.  Atomic operations use the GCC
+ * __atomic builtins, which are also supported by Clang.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "cdynarray.h"
+
+/*
+ * The first segment holds 2^CDYNARRAY_FIRST_SEGMENT_BITS elements, and each
+ * segment after it holds twice as many as the one before.  That's enough
+ * segments to cover every index a size_t can represent.
+ */
+#define CDYNARRAY_FIRST_SEGMENT_BITS 6
+#define CDYNARRAY_NUM_SEGMENTS \
+  (sizeof(size_t) * 8 - CDYNARRAY_FIRST_SEGMENT_BITS)
+
+/*
+ * This is the definition of the concurrent dynamic array structure.  Each
+ * entry of segments is either NULL or points to a zeroed segment published by
+ * whichever appending thread allocated it first.  length counts claimed slots.
+ */
+struct cdynarray {
+  void** segments[CDYNARRAY_NUM_SEGMENTS];
+  size_t length;
+};
+
+
+struct cdynarray* cdynarray_create() {
+
+  struct cdynarray* ca = calloc(1, sizeof(struct cdynarray));
+  assert(ca);
+  return ca;
+
+}
+
+
+void cdynarray_free(struct cdynarray* ca) {
+
+  assert(ca);
+  for (size_t k = 0; k < CDYNARRAY_NUM_SEGMENTS; k++) {
+    free(ca->segments[k]);
+  }
+  free(ca);
+
+}
+
+
+size_t cdynarray_length(struct cdynarray* ca) {
+
+  assert(ca);
+  return __atomic_load_n(&ca->length, __ATOMIC_ACQUIRE);
+
+}
+
+
+/*
+ * Auxilliary function to find the segment holding a given index and the
+ * index's offset within that segment.  Segment k starts at index
+ * 2^FIRST_SEGMENT_BITS * (2^k - 1), so k is the position of the highest set
+ * bit of idx / 2^FIRST_SEGMENT_BITS + 1.
+ */
+size_t _cdynarray_locate(size_t idx, size_t* offset) {
+
+  unsigned long long scaled = (idx >> CDYNARRAY_FIRST_SEGMENT_BITS) + 1;
+  size_t k = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(scaled);
+  *offset = idx - (((size_t)1 << CDYNARRAY_FIRST_SEGMENT_BITS) *
+    (((size_t)1 << k) - 1));
+  return k;
+
+}
+
+
+/*
+ * Auxilliary function to return segment k, allocating and publishing it first
+ * if no thread has done so yet.  If several threads race to allocate the same
+ * segment, the first to publish wins and the others free their copies.
+ */
+void** _cdynarray_segment(struct cdynarray* ca, size_t k) {
+
+  void** segment = __atomic_load_n(&ca->segments[k], __ATOMIC_ACQUIRE);
+  if (segment) {
+    return segment;
+  }
+
+  size_t size = (size_t)1 << (CDYNARRAY_FIRST_SEGMENT_BITS + k);
+  void** fresh = calloc(size, sizeof(void*));
+  assert(fresh);
+  if (__atomic_compare_exchange_n(&ca->segments[k], &segment, fresh, 0,
+      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return fresh;
+  }
+
+  /*
+   * Another thread beat us to it, and the failed exchange loaded its segment
+   * into segment.
+   */
+  free(fresh);
+  return segment;
+
+}
+
+
+size_t cdynarray_push_back(struct cdynarray* ca, void* val) {
+
+  assert(ca);
+  assert(val);
+
+  size_t idx = __atomic_fetch_add(&ca->length, 1, __ATOMIC_ACQ_REL);
+  assert(idx != (size_t)-1);
+
+  size_t offset;
+  size_t k = _cdynarray_locate(idx, &offset);
+  void** segment = _cdynarray_segment(ca, k);
+
+  /*
+   * The release store pairs with the acquire load in cdynarray_get(), so a
+   * reader that sees val also sees everything written before it was appended.
+   */
+  __atomic_store_n(&segment[offset], val, __ATOMIC_RELEASE);
+  return idx;
+
+}
+
+
+void* cdynarray_get(struct cdynarray* ca, size_t idx) {
+
+  assert(ca);
+  assert(idx < cdynarray_length(ca));
+
+  size_t offset;
+  size_t k = _cdynarray_locate(idx, &offset);
+  void** segment = __atomic_load_n(&ca->segments[k], __ATOMIC_ACQUIRE);
+  if (!segment) {
+    return NULL;
+  }
+  return __atomic_load_n(&segment[offset], __ATOMIC_ACQUIRE);
+
+}
+
+
+void cdynarray_append_to(struct cdynarray* ca, struct dynarray* da) {
+
+  assert(ca && da);
+  assert(dynarray_elem_size(da) == 0);
+
+  size_t length = cdynarray_length(ca);
+  dynarray_reserve(da, dynarray_length(da) + length);
+
+  size_t copied = 0;
+  for (size_t k = 0; copied < length; k++) {
+    size_t size = (size_t)1 << (CDYNARRAY_FIRST_SEGMENT_BITS + k);
+    size_t count = length - copied < size ? length - copied : size;
+    void** segment = _cdynarray_segment(ca, k);
+    dynarray_append_array(da, segment, count);
+    copied += count;
+  }
+
+}
@@ -0,0 +1,96 @@
+/*
+ * This file contains the definition of an interface for a concurrent,
+ * append-only dynamic array.
+ */
+
+#ifndef __CDYNARRAY_H
+#define __CDYNARRAY_H
+
+#include <stddef.h>
+
+#include "dynarray.h"
+
+/*
+ * Structure used to represent a concurrent dynamic array.  Any number of
+ * threads may append to the array and read from it at the same time without
+ * locking.  Elements are stored in a series of segments, each twice the size
+ * of the one before it, that are never moved or freed until the array itself
+ * is freed.  That means the address of an element never changes once it has
+ * been appended, and readers never see a buffer being reallocated out from
+ * under them.
+ */
+struct cdynarray;
+
+/*
+ * Creates a new, empty concurrent dynamic array and returns a pointer to it.
+ */
+struct cdynarray* cdynarray_create();
+
+/*
+ * Free the memory associated with a concurrent dynamic array.  As with
+ * dynarray_free(), this does not free the memory pointed to by the values
+ * stored in the array.  No other thread may be using the array when it is
+ * freed.
+ *
+ * Params:
+ *   ca - the array to be destroyed.  May not be NULL.
+ */
+void cdynarray_free(struct cdynarray* ca);
+
+/*
+ * Returns the number of slots that have been claimed in a concurrent dynamic
+ * array.  Slots are claimed when a call to cdynarray_push_back() starts, so
+ * while other threads are still appending, this may include slots whose values
+ * haven't been stored yet.
+ *
+ * Params:
+ *   ca - the array whose length is to be returned.  May not be NULL.
+ */
+size_t cdynarray_length(struct cdynarray* ca);
+
+/*
+ * Appends a value to the end of a concurrent dynamic array.  This is safe to
+ * call from many threads at once.  Each call claims its own slot with a single
+ * atomic increment, so appending threads never wait for one another, except
+ * briefly when several of them race to allocate the same new segment.
+ *
+ * Params:
+ *   ca - the array onto which to append a value.  May not be NULL.
+ *   val - the value to be appended.  May not be NULL, since NULL is what
+ *     readers see in slots whose values haven't been stored yet.
+ *
+ * Return:
+ *   Returns the index at which val was stored.
+ */
+size_t cdynarray_push_back(struct cdynarray* ca, void* val);
+
+/*
+ * Returns the value stored at a given index of a concurrent dynamic array.
+ * This is safe to call while other threads are appending.  Once a call to
+ * cdynarray_push_back() has returned an index, any thread that learns that
+ * index from the appending thread will see the value stored there.
+ *
+ * Params:
+ *   ca - the array from which to get a value.  May not be NULL.
+ *   idx - the index of the value to be returned.  Must be less than the
+ *     array's length.
+ *
+ * Return:
+ *   Returns the value stored at idx, or NULL if the slot at idx has been
+ *   claimed but its value hasn't been stored yet.
+ */
+void* cdynarray_get(struct cdynarray* ca, size_t idx);
+
+/*
+ * Appends all of the values in a concurrent dynamic array to a regular
+ * dynamic array, in index order, one segment at a time.  This is meant to be
+ * called once the appending threads have finished, for example to hand the
+ * collected values to code that works with struct dynarray.
+ *
+ * Params:
+ *   ca - the array whose values are to be copied.  May not be NULL.
+ *   da - the pointer array onto which to append the values.  May not be NULL.
+ */
+void cdynarray_append_to(struct cdynarray* ca, struct dynarray* da);
+
+#endif
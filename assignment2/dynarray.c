@@ -1,155 +1,657 @@
 /*
  * This file contains the definitions of structures and functions implementing
- * a dynamic array.  You should not modify anything in this file.
+ * a dynamic array.
  */
 
+#define _GNU_SOURCE
+
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dynarray.h"
 
-#define DYNARRAY_INIT_CAPACITY 1
+/*
+ * The smallest capacity an array's storage is given once it moves out of the
+ * structure's built-in small buffer.
+ */
+#define DYNARRAY_INIT_CAPACITY 8
+#define DYNARRAY_DEFAULT_GROWTH_FACTOR 2.0
 
 /*
- * This is the definition of the dynamic array structure.  Note that because
- * we're storing generic pointers as void*, the data array needs to be an
- * array of void*, hence it is of type void**.
+ * Records up to this size that dynarray_insert() has to copy out of the array
+ * itself are copied onto the stack rather than into a heap allocation.
  */
-struct dynarray {
-  void** data;
-  int length;
-  int capacity;
+#define DYNARRAY_LOCAL_RECORD_BYTES 64
+
+/*
+ * Identifies files created by dynarray_open_mapped().  The version should be
+ * bumped whenever the layout of struct dynarray_file_header changes.
+ */
+#define DYNARRAY_FILE_MAGIC "DYNARRAY"
+#define DYNARRAY_FILE_VERSION 1
+
+/*
+ * This is the header at the start of every file created by
+ * dynarray_open_mapped().  Records start right after it, at an offset that
+ * keeps them aligned for any type.
+ */
+struct dynarray_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t elem_size;
+  uint64_t length;
+  char padding[32];
 };
 
+/*
+ * Auxilliary function to allocate and initialize an empty dynamic array whose
+ * elements are each elem_size bytes long, using a given allocator for both the
+ * array structure and any storage it needs beyond its small buffer.
+ */
+struct dynarray* _dynarray_create(size_t elem_size, int inline_elems,
+    const struct allocator* alloc) {
+
+  assert(alloc);
+  assert(elem_size <= UINT32_MAX);
+  assert(elem_size <= SIZE_MAX / DYNARRAY_INIT_CAPACITY);
 
-struct dynarray* dynarray_create() {
-  struct dynarray* da = malloc(sizeof(struct dynarray));
+  struct dynarray* da = alloc->alloc(alloc->ctx, sizeof(struct dynarray));
   assert(da);
 
-  da->data = malloc(DYNARRAY_INIT_CAPACITY * sizeof(void*));
-  assert(da->data);
+  /*
+   * Start out with elements stored in the structure's small buffer.  Records
+   * too large to fit there get a capacity of 0 and move out on first insert.
+   */
+  da->alloc = *alloc;
+  da->fd = -1;
+  da->data = da->small.bytes;
   da->length = 0;
-  da->capacity = DYNARRAY_INIT_CAPACITY;
+  da->capacity = sizeof(da->small.bytes) / elem_size;
+  da->elem_size = elem_size;
+  da->inline_elems = inline_elems;
+  da->growth_factor = DYNARRAY_DEFAULT_GROWTH_FACTOR;
 
   return da;
+
+}
+
+
+struct dynarray* dynarray_create() {
+
+  return _dynarray_create(sizeof(void*), 0, &system_allocator);
+
+}
+
+
+struct dynarray* dynarray_create_sized(size_t elem_size) {
+
+  assert(elem_size > 0);
+  return _dynarray_create(elem_size, 1, &system_allocator);
+
+}
+
+
+struct dynarray* dynarray_create_with_alloc(const struct allocator* alloc) {
+
+  return _dynarray_create(sizeof(void*), 0, alloc);
+
+}
+
+
+struct dynarray* dynarray_create_sized_with_alloc(size_t elem_size,
+    const struct allocator* alloc) {
+
+  assert(elem_size > 0);
+  return _dynarray_create(elem_size, 1, alloc);
+
+}
+
+
+/*
+ * Auxilliary function to return the total size of a mapped array's file for a
+ * given capacity.
+ */
+size_t _dynarray_file_bytes(struct dynarray* da, size_t capacity) {
+
+  size_t header = sizeof(struct dynarray_file_header);
+  assert(capacity <= (SIZE_MAX - header) / da->elem_size);
+  return header + capacity * da->elem_size;
+
+}
+
+
+/*
+ * Auxilliary function to move a mapped array's mapping from old_bytes to
+ * new_bytes of its file.  Returns the new mapping, or MAP_FAILED if it
+ * couldn't be made, in which case the old mapping is left in place.
+ */
+char* _dynarray_remap_file(struct dynarray* da, size_t old_bytes,
+    size_t new_bytes) {
+
+  char* old_map = da->data - sizeof(struct dynarray_file_header);
+#ifdef MREMAP_MAYMOVE
+  return mremap(old_map, old_bytes, new_bytes, MREMAP_MAYMOVE);
+#else
+  char* map = mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+    da->fd, 0);
+  if (map != MAP_FAILED) {
+    munmap(old_map, old_bytes);
+  }
+  return map;
+#endif
+
+}
+
+
+/*
+ * Auxilliary function to resize a mapped array by resizing its file and its
+ * mapping.  The records live in the file, so even when the mapping has to
+ * move to a new address, nothing gets copied.  Returns 0 on success or -1 if
+ * the file or mapping couldn't be resized, in which case the array is left
+ * unchanged.
+ *
+ * Growing allocates the file's new blocks with posix_fallocate() before
+ * mapping them, so a full disk is reported here rather than by a SIGBUS on
+ * the first write to a page the file has no room for.  Shrinking unmaps the
+ * end of the file before truncating it, so the mapping never covers pages
+ * past the end of the file.
+ */
+int _dynarray_resize_file(struct dynarray* da, size_t new_capacity) {
+
+  size_t old_bytes = _dynarray_file_bytes(da, da->capacity);
+  size_t new_bytes = _dynarray_file_bytes(da, new_capacity);
+  char* map;
+
+  if (new_bytes > old_bytes) {
+    if (posix_fallocate(da->fd, (off_t)old_bytes,
+        (off_t)(new_bytes - old_bytes)) != 0) {
+      return -1;
+    }
+    map = _dynarray_remap_file(da, old_bytes, new_bytes);
+    if (map == MAP_FAILED) {
+      /*
+       * Give the blocks back, so the file still matches the mapping.
+       */
+      if (ftruncate(da->fd, (off_t)old_bytes) != 0) {
+        /* The file just keeps the extra capacity, which is harmless. */
+      }
+      return -1;
+    }
+  } else {
+    map = _dynarray_remap_file(da, old_bytes, new_bytes);
+    if (map == MAP_FAILED) {
+      return -1;
+    }
+    if (ftruncate(da->fd, (off_t)new_bytes) != 0) {
+      /*
+       * The file keeps its old size, which only means it holds more capacity
+       * than the mapping covers.  Reopening it will reclaim that capacity.
+       */
+    }
+  }
+
+  da->data = map + sizeof(struct dynarray_file_header);
+  da->capacity = new_capacity;
+  return 0;
+
+}
+
+
+/*
+ * Auxilliary function to record a mapped array's length in its file header,
+ * then unmap and close the file.
+ */
+void _dynarray_unmap_file(struct dynarray* da) {
+
+  struct dynarray_file_header* header = (struct dynarray_file_header*)
+    (da->data - sizeof(struct dynarray_file_header));
+  header->length = da->length;
+  munmap(header, _dynarray_file_bytes(da, da->capacity));
+  close(da->fd);
+
+}
+
+
+/*
+ * Auxilliary function to set up a mapped array's storage from its open file,
+ * which is file_bytes long.  An empty file gets a fresh header, and an
+ * existing one has its header validated.  Returns 0 on success or -1 if the
+ * file can't be used.
+ */
+int _dynarray_map_file(struct dynarray* da, size_t file_bytes) {
+
+  size_t header_bytes = sizeof(struct dynarray_file_header);
+  struct dynarray_file_header header;
+
+  if (file_bytes == 0) {
+
+    /*
+     * This is a new file, so write out a header and make room for a few
+     * records.
+     */
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DYNARRAY_FILE_MAGIC, sizeof(header.magic));
+    header.version = DYNARRAY_FILE_VERSION;
+    header.elem_size = da->elem_size;
+    header.length = 0;
+    da->capacity = DYNARRAY_INIT_CAPACITY;
+    file_bytes = _dynarray_file_bytes(da, da->capacity);
+    if (pwrite(da->fd, &header, header_bytes, 0) != (ssize_t)header_bytes ||
+        posix_fallocate(da->fd, 0, (off_t)file_bytes) != 0) {
+      return -1;
+    }
+
+  } else {
+
+    /*
+     * This is an existing file, so make sure it was written by an array with
+     * the same record size before trusting anything in it.
+     */
+    if (file_bytes < header_bytes ||
+        pread(da->fd, &header, header_bytes, 0) != (ssize_t)header_bytes ||
+        memcmp(header.magic, DYNARRAY_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DYNARRAY_FILE_VERSION ||
+        header.elem_size != da->elem_size ||
+        header.length > (file_bytes - header_bytes) / da->elem_size) {
+      return -1;
+    }
+    da->capacity = (file_bytes - header_bytes) / da->elem_size;
+
+  }
+
+  char* map = mmap(NULL, file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+    da->fd, 0);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+  da->data = map + header_bytes;
+  da->length = header.length;
+  return 0;
+
+}
+
+
+struct dynarray* dynarray_open_mapped(const char* path, size_t elem_size) {
+
+  assert(path);
+  assert(elem_size > 0);
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct dynarray* da = _dynarray_create(elem_size, 1, &system_allocator);
+  da->fd = fd;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || _dynarray_map_file(da, (size_t)st.st_size) != 0) {
+    close(fd);
+    system_allocator.release(NULL, da, sizeof(struct dynarray));
+    return NULL;
+  }
+
+  return da;
+
+}
+
+
+int dynarray_sync(struct dynarray* da) {
+
+  assert(da);
+  if (da->fd < 0) {
+    return 0;
+  }
+
+  struct dynarray_file_header* header = (struct dynarray_file_header*)
+    (da->data - sizeof(struct dynarray_file_header));
+  header->length = da->length;
+  return msync(header, _dynarray_file_bytes(da, da->capacity), MS_SYNC);
+
 }
 
 
 void dynarray_free(struct dynarray* da) {
+
   assert(da);
-  free(da->data);
-  free(da);
+
+  /*
+   * Copy the allocator out first, since it lives inside the structure we're
+   * about to release.
+   */
+  struct allocator alloc = da->alloc;
+  if (da->fd >= 0) {
+    _dynarray_unmap_file(da);
+  } else if (da->data != da->small.bytes) {
+    alloc.release(alloc.ctx, da->data, da->capacity * da->elem_size);
+  }
+  alloc.release(alloc.ctx, da, sizeof(struct dynarray));
+
 }
 
 
-int dynarray_length(struct dynarray* da) {
+size_t dynarray_length(struct dynarray* da) {
+
   assert(da);
   return da->length;
+
+}
+
+
+size_t dynarray_elem_size(struct dynarray* da) {
+
+  assert(da);
+  return da->inline_elems ? da->elem_size : 0;
+
 }
 
 
 /*
- * Auxilliary function to perform a resize on the underlying array.
+ * Auxilliary function to perform a resize on the underlying array.  Arrays
+ * that fit in the structure's small buffer are kept there.  Otherwise, the
+ * array's allocator takes care of moving the data; the system allocator, for
+ * example, uses realloc() for small arrays and mremap() for large ones, so
+ * elements are rarely copied one by one.  Returns 0 on success or -1 if a
+ * mapped array's file couldn't be resized, in which case the array is left
+ * unchanged.
  */
-void _dynarray_resize(struct dynarray* da, int new_capacity) {
-  assert(new_capacity > da->length);
+int _dynarray_resize(struct dynarray* da, size_t new_capacity) {
 
-  /*
-   * Allocate space for the new array.
-   */
-  void** new_data = malloc(new_capacity * sizeof(void*));
-  assert(new_data);
+  assert(new_capacity >= da->length && new_capacity > 0);
+  assert(new_capacity <= SIZE_MAX / da->elem_size);
+
+  size_t small_capacity = sizeof(da->small.bytes) / da->elem_size;
+  size_t used_bytes = da->length * da->elem_size;
+  int is_small = da->data == da->small.bytes;
+
+  if (da->fd >= 0) {
+
+    return _dynarray_resize_file(da, new_capacity);
+
+  } else if (new_capacity <= small_capacity) {
+
+    /*
+     * Move back into the small buffer if we're shrinking enough to fit.
+     */
+    if (!is_small) {
+      memcpy(da->small.bytes, da->data, used_bytes);
+      da->alloc.release(da->alloc.ctx, da->data,
+        da->capacity * da->elem_size);
+      da->data = da->small.bytes;
+    }
+    da->capacity = small_capacity;
+
+  } else if (is_small) {
+
+    /*
+     * Spill out of the small buffer into allocated storage.
+     */
+    char* new_data = da->alloc.alloc(da->alloc.ctx,
+      new_capacity * da->elem_size);
+    assert(new_data);
+    memcpy(new_data, da->small.bytes, used_bytes);
+    da->data = new_data;
+    da->capacity = new_capacity;
+
+  } else {
+
+    da->data = da->alloc.resize(da->alloc.ctx, da->data,
+      da->capacity * da->elem_size, new_capacity * da->elem_size);
+    assert(da->data);
+    da->capacity = new_capacity;
+
+  }
+  return 0;
+
+}
+
+
+/*
+ * Auxilliary function to make sure the underlying array can hold at least
+ * min_capacity elements, growing it geometrically by the array's growth factor
+ * if it can't.  Returns 0 on success or -1 if the array couldn't be grown.
+ */
+int _dynarray_grow(struct dynarray* da, size_t min_capacity) {
+
+  if (min_capacity <= da->capacity) {
+    return 0;
+  }
+  assert(min_capacity <= SIZE_MAX / da->elem_size);
+
+  double new_capacity = da->capacity;
+  if (new_capacity < DYNARRAY_INIT_CAPACITY) {
+    new_capacity = DYNARRAY_INIT_CAPACITY;
+  }
+  while (new_capacity < min_capacity) {
+    /*
+     * Always grow by at least one element, so that tiny capacities combined
+     * with growth factors close to 1 still make progress.
+     */
+    double next = new_capacity * da->growth_factor;
+    new_capacity = next >= new_capacity + 1 ? next : new_capacity + 1;
+  }
+  if (new_capacity > (double)(SIZE_MAX / da->elem_size)) {
+    new_capacity = (double)(SIZE_MAX / da->elem_size);
+  }
+
+  return _dynarray_resize(da, (size_t)new_capacity);
+
+}
+
+
+int dynarray_reserve(struct dynarray* da, size_t capacity) {
+
+  assert(da);
+  if (capacity > da->capacity) {
+    return _dynarray_resize(da, capacity);
+  }
+  return 0;
+
+}
+
+
+int dynarray_shrink_to_fit(struct dynarray* da) {
+
+  assert(da);
+  size_t new_capacity = da->length > 0 ? da->length : 1;
+  if (new_capacity < da->capacity) {
+    return _dynarray_resize(da, new_capacity);
+  }
+  return 0;
+
+}
+
+
+void dynarray_set_growth_factor(struct dynarray* da, double factor) {
+
+  assert(da);
+  assert(factor > 1.0);
+  da->growth_factor = factor;
+
+}
+
+
+int dynarray_insert(struct dynarray* da, size_t idx, void* val) {
+
+  assert(da);
 
   /*
-   * Copy data from the old array to the new one.
+   * Pointer arrays store val itself, while record arrays copy the record val
+   * points to.
    */
-  for (int i = 0; i < da->length; i++) {
-    new_data[i] = da->data[i];
+  if (!da->inline_elems) {
+    return dynarray_insert_range(da, idx, &val, 1);
   }
 
   /*
-   * Put the new array into the dynarray struct.
+   * A record from the array itself, like one returned by dynarray_get(),
+   * would be moved by the insert, or freed if the array grows, before it's
+   * copied into place, so copy it out first.
    */
-  free(da->data);
-  da->data = new_data;
-  da->capacity = new_capacity;
+  uintptr_t addr = (uintptr_t)val;
+  uintptr_t begin = (uintptr_t)da->data;
+  if (!val || addr < begin || addr >= begin + da->length * da->elem_size) {
+    return dynarray_insert_range(da, idx, val, 1);
+  }
+  char local[DYNARRAY_LOCAL_RECORD_BYTES];
+  char* copy = da->elem_size <= sizeof(local) ? local : malloc(da->elem_size);
+  assert(copy);
+  memcpy(copy, val, da->elem_size);
+  int result = dynarray_insert_range(da, idx, copy, 1);
+  if (copy != local) {
+    free(copy);
+  }
+  return result;
+
 }
 
 
-void dynarray_insert(struct dynarray* da, int idx, void* val) {
+int dynarray_insert_range(struct dynarray* da, size_t idx, const void* vals,
+    size_t count) {
+
   assert(da);
-  assert((idx <= da->length && idx >= 0) || idx == -1);
+  assert(idx <= da->length || idx == DYNARRAY_END);
 
-  // Let users specify idx = -1 to indicate the end of the array.
-  if (idx == -1) {
+  // Let users specify idx = DYNARRAY_END to indicate the end of the array.
+  if (idx == DYNARRAY_END) {
     idx = da->length;
   }
 
   /*
-   * Make sure we have enough space for the new element.
+   * Make sure we have enough space for the new elements.
    */
-  if (da->length == da->capacity) {
-    _dynarray_resize(da, 2 * da->capacity);
+  assert(count <= SIZE_MAX - da->length);
+  if (_dynarray_grow(da, da->length + count) != 0) {
+    return -1;
   }
 
   /*
-   * Move all elements behind the new one back one index to make space
-   * for the new one.
+   * Move all elements behind the insertion point back count indices in one
+   * go to make space for the new ones, then copy the new ones in.  Records
+   * inserted without a value to copy from are zeroed.
    */
-  for (int i = da->length; i > idx; i--) {
-    da->data[i] = da->data[i-1];
+  char* slot = da->data + idx * da->elem_size;
+  size_t block_bytes = count * da->elem_size;
+  memmove(slot + block_bytes, slot, (da->length - idx) * da->elem_size);
+  if (vals) {
+    memcpy(slot, vals, block_bytes);
+  } else {
+    memset(slot, 0, block_bytes);
   }
+  da->length += count;
+  return 0;
 
-  /*
-   * Put the new element into the array.
-   */
-  da->data[idx] = val;
-  da->length++;
 }
 
 
-void dynarray_remove(struct dynarray* da, int idx) {
+int dynarray_append_array(struct dynarray* da, const void* vals,
+    size_t count) {
+
+  return dynarray_insert_range(da, DYNARRAY_END, vals, count);
+
+}
+
+
+void dynarray_remove(struct dynarray* da, size_t idx) {
+
   assert(da);
-  assert((idx < da->length && idx >= 0) || idx == -1);
+  assert(idx < da->length || (idx == DYNARRAY_END && da->length > 0));
 
-  // Let users specify idx = -1 to indicate the end of the array.
-  if (idx == -1) {
+  // Let users specify idx = DYNARRAY_END to indicate the end of the array.
+  if (idx == DYNARRAY_END) {
     idx = da->length - 1;
   }
 
+  dynarray_remove_range(da, idx, 1);
+
+}
+
+
+void dynarray_remove_range(struct dynarray* da, size_t idx, size_t count) {
+
+  assert(da);
+  assert(count <= da->length && idx <= da->length - count);
+
   /*
-   * Move all elements behind the one being removed forward one index,
-   * overwriting the element to be removed in the process.
+   * Move all elements behind the removed block forward count indices,
+   * overwriting the removed elements in the process.
    */
-  for (int i = idx; i < da->length - 1; i++) {
-    da->data[i] = da->data[i+1];
-  }
+  char* slot = da->data + idx * da->elem_size;
+  memmove(slot, slot + count * da->elem_size,
+    (da->length - idx - count) * da->elem_size);
+  da->length -= count;
 
-  da->length--;
 }
 
 
-void* dynarray_get(struct dynarray* da, int idx) {
+void* dynarray_get(struct dynarray* da, size_t idx) {
+
   assert(da);
-  assert((idx < da->length && idx >= 0) || idx == -1);
+  assert(idx < da->length || (idx == DYNARRAY_END && da->length > 0));
 
-  // Let users specify idx = -1 to indicate the end of the array.
-  if (idx == -1) {
+  // Let users specify idx = DYNARRAY_END to indicate the end of the array.
+  if (idx == DYNARRAY_END) {
     idx = da->length - 1;
   }
 
-  return da->data[idx];
+  char* slot = da->data + idx * da->elem_size;
+  return da->inline_elems ? (void*)slot : *(void**)slot;
+
 }
 
 
-void dynarray_set(struct dynarray* da, int idx, void* val) {
+void dynarray_set(struct dynarray* da, size_t idx, void* val) {
+
   assert(da);
-  assert((idx < da->length && idx >= 0) || idx == -1);
+  assert(idx < da->length || (idx == DYNARRAY_END && da->length > 0));
 
-  // Let users specify idx = -1 to indicate the end of the array.
-  if (idx == -1) {
+  // Let users specify idx = DYNARRAY_END to indicate the end of the array.
+  if (idx == DYNARRAY_END) {
     idx = da->length - 1;
   }
 
-  da->data[idx] = val;
+  char* slot = da->data + idx * da->elem_size;
+  if (da->inline_elems) {
+    memmove(slot, val, da->elem_size);
+  } else {
+    *(void**)slot = val;
+  }
+
+}
+
+
+void dynarray_swap(struct dynarray* da, size_t i, size_t j) {
+
+  assert(da);
+  assert(i < da->length && j < da->length);
+
+  char* a = da->data + i * da->elem_size;
+  char* b = da->data + j * da->elem_size;
+  if (a == b) {
+    return;
+  }
+
+  /*
+   * Swap through a small bounce buffer so records of any size can be
+   * exchanged without allocating.
+   */
+  char tmp[64];
+  size_t left = da->elem_size;
+  while (left > 0) {
+    size_t n = left < sizeof(tmp) ? left : sizeof(tmp);
+    memcpy(tmp, a, n);
+    memcpy(a, b, n);
+    memcpy(b, tmp, n);
+    a += n;
+    b += n;
+    left -= n;
+  }
+
 }
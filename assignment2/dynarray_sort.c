@@ -0,0 +1,1068 @@
+/*
+ * This file contains the definitions of the functions declared in
+ * dynarray_sort.h.  The unstable sort is a C port of Orson Peters'
+ * pattern-defeating quicksort (https://github.com/orlp/pdqsort).
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "dynarray_sort.h"
+
+/*
+ * Ranges shorter than this are sorted with insertion sort instead of being
+ * partitioned further.
+ */
+#define SORT_INSERTION_THRESHOLD 24
+
+/*
+ * Ranges longer than this use the median of three medians ("ninther") as
+ * their pivot instead of the median of three elements.
+ */
+#define SORT_NINTHER_THRESHOLD 128
+
+/*
+ * Partial insertion sort gives up on a range after moving elements this many
+ * places in total.
+ */
+#define SORT_PARTIAL_INSERTION_LIMIT 8
+
+/*
+ * Merge sort finishes runs of this many elements with insertion sort.
+ */
+#define SORT_STABLE_RUN 16
+
+/*
+ * Temporary elements up to this many bytes are kept on the stack instead of
+ * being allocated.
+ */
+#define SORT_LOCAL_BYTES 64
+
+/*
+ * Radix sort processes keys this many bits at a time.
+ */
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_BUCKETS (1 << SORT_RADIX_BITS)
+#define SORT_RADIX_PASSES (32 / SORT_RADIX_BITS)
+
+/*
+ * This structure holds everything the sorting functions below need to know
+ * about the array being sorted.  Elements are addressed by pointers into the
+ * array's storage, width bytes apart.  ptrs is set for pointer arrays, whose
+ * comparison functions are passed the stored pointers instead of pointers to
+ * the elements.  less, if set, is used to order elements instead of cmp, and
+ * is handed the state itself, so sorts over scratch arrays of our own can
+ * reach whatever they need to compare them.  pivot and hole each hold one
+ * temporary element.
+ */
+struct sort_state {
+  size_t width;
+  int ptrs;
+  dynarray_cmp_fn cmp;
+  int (*less)(struct sort_state* s, char* a, char* b);
+  char* pivot;
+  char* hole;
+};
+
+/*
+ * This structure is the scratch entry dynarray_keyed_sort() sorts in place of
+ * each element: the element's key, high half first, and its index.
+ */
+struct sort_key_entry {
+  uint64_t hi;
+  uint64_t lo;
+  size_t index;
+};
+
+/*
+ * This structure holds what dynarray_keyed_sort() needs to sort its entries.
+ * s describes the array of entries, and elems the array of elements, whose
+ * storage starts at data and which only the tiebreak function looks at.  s
+ * must come first, since the entries' less function is handed a pointer to
+ * it.
+ */
+struct keyed_sort {
+  struct sort_state s;
+  struct sort_state elems;
+  char* data;
+  dynarray_cmp_fn tiebreak;
+};
+
+
+/*
+ * Auxilliary function to return the value passed to the comparison function
+ * for the element at p.
+ */
+void* _sort_val(struct sort_state* s, char* p) {
+
+  return s->ptrs ? *(void**)p : p;
+
+}
+
+
+/*
+ * Auxilliary function to return whether the element at a belongs strictly
+ * before the element at b.
+ */
+int _sort_less(struct sort_state* s, char* a, char* b) {
+
+  if (s->less) {
+    return s->less(s, a, b);
+  }
+  return s->cmp(_sort_val(s, a), _sort_val(s, b)) < 0;
+
+}
+
+
+/*
+ * Auxilliary function to copy the element at src over the element at dst.
+ */
+void _sort_copy(struct sort_state* s, char* dst, char* src) {
+
+  if (s->ptrs) {
+    *(void**)dst = *(void**)src;
+  } else {
+    memcpy(dst, src, s->width);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to exchange the elements at a and b.  Records are
+ * swapped a chunk at a time so records of any size can be swapped without
+ * allocating.
+ */
+void _sort_swap(struct sort_state* s, char* a, char* b) {
+
+  if (s->ptrs) {
+    void* tmp = *(void**)a;
+    *(void**)a = *(void**)b;
+    *(void**)b = tmp;
+    return;
+  }
+
+  char tmp[SORT_LOCAL_BYTES];
+  size_t left = s->width;
+  while (left > 0) {
+    size_t chunk = left < sizeof(tmp) ? left : sizeof(tmp);
+    memcpy(tmp, a, chunk);
+    memcpy(a, b, chunk);
+    memcpy(b, tmp, chunk);
+    a += chunk;
+    b += chunk;
+    left -= chunk;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to sort the elements in [begin, end) with insertion
+ * sort.  If unguarded is set, the element just before begin must be no
+ * greater than any element in the range, which lets the inner loop skip its
+ * bounds check.  Only strictly smaller elements are moved past one another,
+ * so the sort is stable.
+ */
+void _sort_insertion(struct sort_state* s, char* begin, char* end,
+    int unguarded) {
+
+  size_t w = s->width;
+  if (begin == end) {
+    return;
+  }
+
+  for (char* cur = begin + w; cur < end; cur += w) {
+    if (_sort_less(s, cur, cur - w)) {
+      char* sift = cur;
+      _sort_copy(s, s->hole, cur);
+      do {
+        _sort_copy(s, sift, sift - w);
+        sift -= w;
+      } while ((unguarded || sift != begin) &&
+        _sort_less(s, s->hole, sift - w));
+      _sort_copy(s, sift, s->hole);
+    }
+  }
+
+}
+
+
+/*
+ * Auxilliary function to attempt an insertion sort of [begin, end) that gives
+ * up once it has moved elements more than SORT_PARTIAL_INSERTION_LIMIT places
+ * in total.  Returns 1 if the range was sorted or 0 if the sort gave up, in
+ * which case the range is still a permutation of its original elements.
+ */
+int _sort_partial_insertion(struct sort_state* s, char* begin, char* end) {
+
+  size_t w = s->width;
+  size_t moves = 0;
+  if (begin == end) {
+    return 1;
+  }
+
+  for (char* cur = begin + w; cur < end; cur += w) {
+    if (_sort_less(s, cur, cur - w)) {
+      char* sift = cur;
+      _sort_copy(s, s->hole, cur);
+      do {
+        _sort_copy(s, sift, sift - w);
+        sift -= w;
+      } while (sift != begin && _sort_less(s, s->hole, sift - w));
+      _sort_copy(s, sift, s->hole);
+      moves += (size_t)(cur - sift) / w;
+    }
+    if (moves > SORT_PARTIAL_INSERTION_LIMIT) {
+      return 0;
+    }
+  }
+  return 1;
+
+}
+
+
+/*
+ * Auxilliary function to put the elements at a, b and c in sorted order.
+ */
+void _sort_sort3(struct sort_state* s, char* a, char* b, char* c) {
+
+  if (_sort_less(s, b, a)) {
+    _sort_swap(s, a, b);
+  }
+  if (_sort_less(s, c, b)) {
+    _sort_swap(s, b, c);
+  }
+  if (_sort_less(s, b, a)) {
+    _sort_swap(s, a, b);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to sift the element at index i of the heap at begin
+ * down into place.  The heap holds n elements with the largest at the root.
+ */
+void _sort_sift_down(struct sort_state* s, char* begin, size_t i, size_t n) {
+
+  size_t w = s->width;
+  while (1) {
+    size_t largest = i;
+    size_t l = 2 * i + 1;
+    size_t r = 2 * i + 2;
+    if (l < n && _sort_less(s, begin + largest * w, begin + l * w)) {
+      largest = l;
+    }
+    if (r < n && _sort_less(s, begin + largest * w, begin + r * w)) {
+      largest = r;
+    }
+    if (largest == i) {
+      return;
+    }
+    _sort_swap(s, begin + i * w, begin + largest * w);
+    i = largest;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to sort the elements in [begin, end) with heapsort.
+ * This is the fallback that keeps the quicksort from going quadratic.
+ */
+void _sort_heapsort(struct sort_state* s, char* begin, char* end) {
+
+  size_t w = s->width;
+  size_t n = (size_t)(end - begin) / w;
+
+  for (size_t i = n / 2; i > 0; i--) {
+    _sort_sift_down(s, begin, i - 1, n);
+  }
+  for (size_t i = n; i > 1; i--) {
+    _sort_swap(s, begin, begin + (i - 1) * w);
+    _sort_sift_down(s, begin, 0, i - 1);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to partition [begin, end) around the pivot at begin.
+ * Elements less than the pivot end up to its left and all others to its
+ * right.  Returns a pointer to the pivot's final position and sets
+ * *already_partitioned if no elements had to be swapped.
+ *
+ * Both scans are guarded without bounds checks: the pivot at begin stops the
+ * right-to-left scan, and the median-of-three pivot selection guarantees an
+ * element no less than the pivot for the left-to-right scan to stop at.
+ */
+char* _sort_partition_right(struct sort_state* s, char* begin, char* end,
+    int* already_partitioned) {
+
+  size_t w = s->width;
+  char* first = begin;
+  char* last = end;
+  _sort_copy(s, s->pivot, begin);
+
+  do {
+    first += w;
+  } while (_sort_less(s, first, s->pivot));
+
+  if (first - w == begin) {
+    do {
+      last -= w;
+    } while (first < last && !_sort_less(s, last, s->pivot));
+  } else {
+    do {
+      last -= w;
+    } while (!_sort_less(s, last, s->pivot));
+  }
+
+  *already_partitioned = first >= last;
+
+  while (first < last) {
+    _sort_swap(s, first, last);
+    do {
+      first += w;
+    } while (_sort_less(s, first, s->pivot));
+    do {
+      last -= w;
+    } while (!_sort_less(s, last, s->pivot));
+  }
+
+  char* pivot_pos = first - w;
+  _sort_copy(s, begin, pivot_pos);
+  _sort_copy(s, pivot_pos, s->pivot);
+  return pivot_pos;
+
+}
+
+
+/*
+ * Auxilliary function to partition [begin, end) around the pivot at begin,
+ * putting elements equal to the pivot on its left.  This is used when the
+ * pivot is equal to the element just before the range, in which case every
+ * element equal to the pivot is already in its final place, so runs of equal
+ * elements are finished in a single pass.  Returns a pointer to the pivot's
+ * final position.
+ */
+char* _sort_partition_left(struct sort_state* s, char* begin, char* end) {
+
+  size_t w = s->width;
+  char* first = begin;
+  char* last = end;
+  _sort_copy(s, s->pivot, begin);
+
+  do {
+    last -= w;
+  } while (_sort_less(s, s->pivot, last));
+
+  if (last + w == end) {
+    do {
+      first += w;
+    } while (first < last && !_sort_less(s, s->pivot, first));
+  } else {
+    do {
+      first += w;
+    } while (!_sort_less(s, s->pivot, first));
+  }
+
+  while (first < last) {
+    _sort_swap(s, first, last);
+    do {
+      last -= w;
+    } while (_sort_less(s, s->pivot, last));
+    do {
+      first += w;
+    } while (!_sort_less(s, s->pivot, first));
+  }
+
+  _sort_copy(s, begin, last);
+  _sort_copy(s, last, s->pivot);
+  return last;
+
+}
+
+
+/*
+ * Auxilliary function to shuffle a few elements of a range that was badly
+ * partitioned, to break up whatever pattern caused the bad pivot.  n is the
+ * number of elements in the range.
+ */
+void _sort_break_patterns(struct sort_state* s, char* begin, char* end,
+    size_t n) {
+
+  size_t w = s->width;
+  size_t q = n / 4;
+  if (n < SORT_INSERTION_THRESHOLD) {
+    return;
+  }
+
+  _sort_swap(s, begin, begin + q * w);
+  _sort_swap(s, end - w, end - q * w);
+  if (n > SORT_NINTHER_THRESHOLD) {
+    _sort_swap(s, begin + w, begin + (q + 1) * w);
+    _sort_swap(s, begin + 2 * w, begin + (q + 2) * w);
+    _sort_swap(s, end - 2 * w, end - (q + 1) * w);
+    _sort_swap(s, end - 3 * w, end - (q + 2) * w);
+  }
+
+}
+
+
+/*
+ * Auxilliary function implementing the main pattern-defeating quicksort loop
+ * on [begin, end).  bad_allowed is the number of badly unbalanced partitions
+ * still allowed before falling back to heapsort.  leftmost is set if the
+ * range starts at the beginning of the array; otherwise, the element just
+ * before begin is no greater than any element in the range.
+ *
+ * Only the smaller side of each partition is sorted recursively, and the loop
+ * continues with the larger side, so recursion never goes more than
+ * O(log n) deep.
+ */
+void _sort_pdq(struct sort_state* s, char* begin, char* end,
+    int bad_allowed, int leftmost) {
+
+  size_t w = s->width;
+
+  while (1) {
+    size_t n = (size_t)(end - begin) / w;
+    if (n < SORT_INSERTION_THRESHOLD) {
+      _sort_insertion(s, begin, end, !leftmost);
+      return;
+    }
+
+    /*
+     * Choose a pivot and move it to begin.
+     */
+    size_t half = n / 2;
+    if (n > SORT_NINTHER_THRESHOLD) {
+      _sort_sort3(s, begin, begin + half * w, end - w);
+      _sort_sort3(s, begin + w, begin + (half - 1) * w, end - 2 * w);
+      _sort_sort3(s, begin + 2 * w, begin + (half + 1) * w, end - 3 * w);
+      _sort_sort3(s, begin + (half - 1) * w, begin + half * w,
+        begin + (half + 1) * w);
+      _sort_swap(s, begin, begin + half * w);
+    } else {
+      _sort_sort3(s, begin + half * w, begin, end - w);
+    }
+
+    /*
+     * If the pivot equals the element before this range, every element equal
+     * to it belongs here already, so put them on the left and move on.
+     */
+    if (!leftmost && !_sort_less(s, begin - w, begin)) {
+      begin = _sort_partition_left(s, begin, end) + w;
+      continue;
+    }
+
+    int already_partitioned;
+    char* pivot_pos = _sort_partition_right(s, begin, end,
+      &already_partitioned);
+    size_t l_size = (size_t)(pivot_pos - begin) / w;
+    size_t r_size = (size_t)(end - (pivot_pos + w)) / w;
+
+    if (l_size < n / 8 || r_size < n / 8) {
+      if (--bad_allowed == 0) {
+        _sort_heapsort(s, begin, end);
+        return;
+      }
+      _sort_break_patterns(s, begin, pivot_pos, l_size);
+      _sort_break_patterns(s, pivot_pos + w, end, r_size);
+    } else if (already_partitioned &&
+        _sort_partial_insertion(s, begin, pivot_pos) &&
+        _sort_partial_insertion(s, pivot_pos + w, end)) {
+      return;
+    }
+
+    if (l_size < r_size) {
+      _sort_pdq(s, begin, pivot_pos, bad_allowed, leftmost);
+      begin = pivot_pos + w;
+      leftmost = 0;
+    } else {
+      _sort_pdq(s, pivot_pos + w, end, bad_allowed, 0);
+      end = pivot_pos;
+    }
+  }
+
+}
+
+
+/*
+ * Auxilliary function to sort the n elements starting at begin with
+ * pattern-defeating quicksort.  s must already have its temporary elements.
+ */
+void _sort_unstable(struct sort_state* s, char* begin, size_t n) {
+
+  int bad_allowed = 0;
+  for (size_t m = n; m > 1; m >>= 1) {
+    bad_allowed++;
+  }
+  _sort_pdq(s, begin, begin + n * s->width, bad_allowed, 1);
+
+}
+
+
+/*
+ * Auxilliary function to set up the parts of a sort_state that don't involve
+ * temporary elements.
+ */
+void _sort_state_init(struct sort_state* s, struct dynarray* da,
+    dynarray_cmp_fn cmp) {
+
+  s->ptrs = dynarray_elem_size(da) == 0;
+  s->width = s->ptrs ? sizeof(void*) : dynarray_elem_size(da);
+  s->cmp = cmp;
+  s->less = NULL;
+
+}
+
+
+void dynarray_sort(struct dynarray* da, dynarray_cmp_fn cmp) {
+
+  assert(da && cmp);
+
+  size_t n = dynarray_length(da);
+  if (n < 2) {
+    return;
+  }
+
+  struct sort_state s;
+  _sort_state_init(&s, da, cmp);
+
+  /*
+   * The pivot and hole elements are handed to the comparison function, so
+   * they need the same alignment as the array's own storage.
+   */
+  union {
+    char bytes[2 * SORT_LOCAL_BYTES];
+    void* align_ptr;
+    long double align_ld;
+    long long align_ll;
+  } local;
+  char* tmp = local.bytes;
+  if (2 * s.width > sizeof(local.bytes)) {
+    tmp = da->alloc.alloc(da->alloc.ctx, 2 * s.width);
+  }
+  s.pivot = tmp;
+  s.hole = tmp + s.width;
+
+  _sort_unstable(&s, dynarray_data(da), n);
+
+  if (tmp != local.bytes) {
+    da->alloc.release(da->alloc.ctx, tmp, 2 * s.width);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to merge sort [begin, end).  scratch must have room for
+ * half of the range's elements, rounded up.
+ */
+void _sort_merge(struct sort_state* s, char* begin, char* end, char* scratch) {
+
+  size_t w = s->width;
+  size_t n = (size_t)(end - begin) / w;
+  if (n <= SORT_STABLE_RUN) {
+    _sort_insertion(s, begin, end, 0);
+    return;
+  }
+
+  char* mid = begin + (n / 2) * w;
+  _sort_merge(s, begin, mid, scratch);
+  _sort_merge(s, mid, end, scratch);
+
+  /*
+   * Nothing to do if the two halves are already in order, which makes
+   * sorting sorted input linear.
+   */
+  if (!_sort_less(s, mid, mid - w)) {
+    return;
+  }
+
+  /*
+   * Move the left half out of the way and merge the two halves back into
+   * place.  Ties go to the left half, which keeps the sort stable.
+   */
+  size_t left_bytes = (size_t)(mid - begin);
+  memcpy(scratch, begin, left_bytes);
+  char* l = scratch;
+  char* l_end = scratch + left_bytes;
+  char* r = mid;
+  char* out = begin;
+  while (l < l_end && r < end) {
+    if (_sort_less(s, r, l)) {
+      _sort_copy(s, out, r);
+      r += w;
+    } else {
+      _sort_copy(s, out, l);
+      l += w;
+    }
+    out += w;
+  }
+  memcpy(out, l, (size_t)(l_end - l));
+
+}
+
+
+void dynarray_stable_sort(struct dynarray* da, dynarray_cmp_fn cmp) {
+
+  assert(da && cmp);
+
+  size_t n = dynarray_length(da);
+  if (n < 2) {
+    return;
+  }
+
+  struct sort_state s;
+  _sort_state_init(&s, da, cmp);
+
+  size_t scratch_size = (n - n / 2) * s.width + s.width;
+  char* scratch = da->alloc.alloc(da->alloc.ctx, scratch_size);
+  s.hole = scratch + (n - n / 2) * s.width;
+  s.pivot = NULL;
+
+  char* begin = dynarray_data(da);
+  _sort_merge(&s, begin, begin + n * s.width, scratch);
+
+  da->alloc.release(da->alloc.ctx, scratch, scratch_size);
+
+}
+
+
+/*
+ * This structure holds the state shared by all of the threads taking part in
+ * a parallel sort.  The array is split into num_threads chunks, chunk c
+ * covering elements [bounds[c], bounds[c + 1]).  Each thread sorts its own
+ * chunk, then the threads merge runs of chunks pairwise, back and forth
+ * between the array and scratch, until a single sorted run remains.
+ */
+struct parallel_sort {
+  struct sort_state state;
+  char* bufs[2];
+  size_t* bounds;
+  int num_threads;
+  int num_rounds;
+  pthread_barrier_t barrier;
+};
+
+/*
+ * Per-thread arguments for a parallel sort.  Each thread gets its own
+ * sort_state, since the temporary elements can't be shared.
+ */
+struct parallel_sort_worker {
+  struct parallel_sort* ps;
+  struct sort_state state;
+  int id;
+};
+
+
+/*
+ * Auxilliary function to find how many of the first k elements of the merge
+ * of sorted runs a (a_len elements) and b (b_len elements) come from a.  Ties
+ * go to a, matching _sort_merge_into().
+ */
+size_t _sort_co_rank(struct sort_state* s, char* a, size_t a_len, char* b,
+    size_t b_len, size_t k) {
+
+  size_t w = s->width;
+  size_t lo = k > b_len ? k - b_len : 0;
+  size_t hi = k < a_len ? k : a_len;
+  while (lo < hi) {
+    size_t i = lo + (hi - lo) / 2;
+    size_t j = k - i;
+    if (!_sort_less(s, b + (j - 1) * w, a + i * w)) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+
+}
+
+
+/*
+ * Auxilliary function to merge the sorted runs [a, a_end) and [b, b_end) into
+ * out, taking from a when elements are equivalent.
+ */
+void _sort_merge_into(struct sort_state* s, char* a, char* a_end, char* b,
+    char* b_end, char* out) {
+
+  size_t w = s->width;
+  while (a < a_end && b < b_end) {
+    if (_sort_less(s, b, a)) {
+      _sort_copy(s, out, b);
+      b += w;
+    } else {
+      _sort_copy(s, out, a);
+      a += w;
+    }
+    out += w;
+  }
+  memcpy(out, a, (size_t)(a_end - a));
+  out += a_end - a;
+  memcpy(out, b, (size_t)(b_end - b));
+
+}
+
+
+/*
+ * Auxilliary function to do one thread's share of a merge round.  In round r,
+ * runs of 2^r chunks are merged pairwise into runs of 2^(r + 1) chunks.  The
+ * threads whose ids fall in the chunks of a merged run share that merge
+ * equally: each one finds where its slice of the output starts and ends in
+ * the two input runs and merges just that slice, so every thread stays busy
+ * through the final round.
+ */
+void _sort_merge_round(struct parallel_sort* ps, struct sort_state* s,
+    int round, int id) {
+
+  size_t w = s->width;
+  char* src = ps->bufs[round % 2];
+  char* dst = ps->bufs[(round + 1) % 2];
+
+  int run = 1 << round;
+  int first = id / (2 * run) * (2 * run);
+  int mid = first + run < ps->num_threads ? first + run : ps->num_threads;
+  int last = first + 2 * run < ps->num_threads ? first + 2 * run
+    : ps->num_threads;
+
+  char* a = src + ps->bounds[first] * w;
+  size_t a_len = ps->bounds[mid] - ps->bounds[first];
+  char* b = src + ps->bounds[mid] * w;
+  size_t b_len = ps->bounds[last] - ps->bounds[mid];
+
+  size_t total = a_len + b_len;
+  size_t pieces = (size_t)(last - first);
+  size_t piece = (size_t)(id - first);
+  size_t out_lo = total * piece / pieces;
+  size_t out_hi = total * (piece + 1) / pieces;
+
+  size_t i_lo = _sort_co_rank(s, a, a_len, b, b_len, out_lo);
+  size_t i_hi = _sort_co_rank(s, a, a_len, b, b_len, out_hi);
+  _sort_merge_into(s, a + i_lo * w, a + i_hi * w, b + (out_lo - i_lo) * w,
+    b + (out_hi - i_hi) * w, dst + (ps->bounds[first] + out_lo) * w);
+
+}
+
+
+/*
+ * Auxilliary function run by each thread taking part in a parallel sort.
+ */
+void* _sort_parallel_worker(void* arg) {
+
+  struct parallel_sort_worker* worker = arg;
+  struct parallel_sort* ps = worker->ps;
+  struct sort_state* s = &worker->state;
+  int id = worker->id;
+  size_t w = s->width;
+
+  size_t lo = ps->bounds[id];
+  size_t hi = ps->bounds[id + 1];
+  _sort_unstable(s, ps->bufs[0] + lo * w, hi - lo);
+  pthread_barrier_wait(&ps->barrier);
+
+  for (int round = 0; round < ps->num_rounds; round++) {
+    _sort_merge_round(ps, s, round, id);
+    pthread_barrier_wait(&ps->barrier);
+  }
+
+  /*
+   * If the final run ended up in scratch, copy it back into the array.
+   */
+  if (ps->num_rounds % 2) {
+    memcpy(ps->bufs[0] + lo * w, ps->bufs[1] + lo * w, (hi - lo) * w);
+  }
+  return NULL;
+
+}
+
+
+void dynarray_parallel_sort(struct dynarray* da, dynarray_cmp_fn cmp,
+    int num_threads, size_t cutoff) {
+
+  assert(da && cmp && num_threads >= 0);
+
+  size_t n = dynarray_length(da);
+  if (num_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  if (cutoff == 0) {
+    cutoff = DYNARRAY_PARALLEL_SORT_CUTOFF;
+  }
+
+  /*
+   * Don't give any thread less than cutoff elements to sort.
+   */
+  if ((size_t)num_threads > n / cutoff) {
+    num_threads = (int)(n / cutoff);
+  }
+  if (num_threads <= 1) {
+    dynarray_sort(da, cmp);
+    return;
+  }
+
+  struct parallel_sort ps;
+  _sort_state_init(&ps.state, da, cmp);
+  size_t w = ps.state.width;
+  ps.num_threads = num_threads;
+  ps.num_rounds = 0;
+  while ((1 << ps.num_rounds) < num_threads) {
+    ps.num_rounds++;
+  }
+
+  /*
+   * Everything the threads need is allocated up front, since the array's
+   * allocator isn't necessarily safe to call from several threads at once.
+   */
+  size_t bounds_size = (num_threads + 1) * sizeof(size_t);
+  size_t workers_size = num_threads * sizeof(struct parallel_sort_worker);
+  size_t tmp_size = 2 * num_threads * w;
+  size_t threads_size = num_threads * sizeof(pthread_t);
+  ps.bounds = da->alloc.alloc(da->alloc.ctx, bounds_size);
+  struct parallel_sort_worker* workers = da->alloc.alloc(da->alloc.ctx,
+    workers_size);
+  char* tmp = da->alloc.alloc(da->alloc.ctx, tmp_size);
+  pthread_t* threads = da->alloc.alloc(da->alloc.ctx, threads_size);
+  ps.bufs[0] = dynarray_data(da);
+  ps.bufs[1] = ps.num_rounds > 0 ? da->alloc.alloc(da->alloc.ctx, n * w)
+    : NULL;
+
+  for (int t = 0; t <= num_threads; t++) {
+    ps.bounds[t] = n / num_threads * t + n % num_threads * t / num_threads;
+  }
+  pthread_barrier_init(&ps.barrier, NULL, num_threads);
+
+  /*
+   * The calling thread does its share of the work as worker 0.
+   */
+  for (int t = 0; t < num_threads; t++) {
+    workers[t].ps = &ps;
+    workers[t].state = ps.state;
+    workers[t].state.pivot = tmp + 2 * t * w;
+    workers[t].state.hole = tmp + (2 * t + 1) * w;
+    workers[t].id = t;
+    if (t > 0) {
+      int err = pthread_create(&threads[t], NULL, _sort_parallel_worker,
+        &workers[t]);
+      assert(err == 0);
+    }
+  }
+  _sort_parallel_worker(&workers[0]);
+  for (int t = 1; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  pthread_barrier_destroy(&ps.barrier);
+  if (ps.bufs[1]) {
+    da->alloc.release(da->alloc.ctx, ps.bufs[1], n * w);
+  }
+  da->alloc.release(da->alloc.ctx, threads, threads_size);
+  da->alloc.release(da->alloc.ctx, tmp, tmp_size);
+  da->alloc.release(da->alloc.ctx, workers, workers_size);
+  da->alloc.release(da->alloc.ctx, ps.bounds, bounds_size);
+
+}
+
+
+/*
+ * Auxilliary function to return whether the entry at a belongs strictly
+ * before the entry at b in a keyed sort.  Entries with equal keys are ordered
+ * by the tiebreak function and then by index, so no two entries are ever
+ * equal, which makes the result stable even though the entries are sorted
+ * with pattern-defeating quicksort.
+ */
+int _sort_key_less(struct sort_state* s, char* a, char* b) {
+
+  struct keyed_sort* ks = (struct keyed_sort*)s;
+  struct sort_key_entry* ea = (struct sort_key_entry*)a;
+  struct sort_key_entry* eb = (struct sort_key_entry*)b;
+  if (ea->hi != eb->hi) {
+    return ea->hi < eb->hi;
+  }
+  if (ea->lo != eb->lo) {
+    return ea->lo < eb->lo;
+  }
+  if (ks->tiebreak) {
+    size_t w = ks->elems.width;
+    int c = ks->tiebreak(_sort_val(&ks->elems, ks->data + ea->index * w),
+      _sort_val(&ks->elems, ks->data + eb->index * w));
+    if (c != 0) {
+      return c < 0;
+    }
+  }
+  return ea->index < eb->index;
+
+}
+
+
+/*
+ * Auxilliary function to sort the n entries a keyed sort has extracted from
+ * an array, then move the array's elements into the order of the sorted
+ * entries and release the entries.
+ */
+void _sort_keyed_entries(struct dynarray* da, struct keyed_sort* ks,
+    struct sort_key_entry* entries, size_t n) {
+
+  struct sort_key_entry tmp[2];
+  ks->s.width = sizeof(struct sort_key_entry);
+  ks->s.ptrs = 0;
+  ks->s.cmp = NULL;
+  ks->s.less = _sort_key_less;
+  ks->s.pivot = (char*)&tmp[0];
+  ks->s.hole = (char*)&tmp[1];
+  _sort_unstable(&ks->s, (char*)entries, n);
+
+  /*
+   * Gather the elements into sorted order and copy them back.
+   */
+  size_t w = ks->elems.width;
+  char* sorted = da->alloc.alloc(da->alloc.ctx, n * w);
+  for (size_t i = 0; i < n; i++) {
+    _sort_copy(&ks->elems, sorted + i * w, ks->data + entries[i].index * w);
+  }
+  memcpy(ks->data, sorted, n * w);
+
+  da->alloc.release(da->alloc.ctx, sorted, n * w);
+  da->alloc.release(da->alloc.ctx, entries,
+    n * sizeof(struct sort_key_entry));
+
+}
+
+
+void dynarray_radix_sort(struct dynarray* da, dynarray_key_fn key) {
+
+  assert(da && key);
+
+  size_t n = dynarray_length(da);
+  if (n < 2) {
+    return;
+  }
+
+  struct sort_state s;
+  _sort_state_init(&s, da, NULL);
+  size_t w = s.width;
+  char* data = dynarray_data(da);
+
+  /*
+   * Indices past UINT32_MAX don't fit next to the key in a packed entry, so
+   * arrays that long are sorted through wide (key, index) entries the way
+   * dynarray_keyed_sort() sorts them.  No two entries compare equal, so the
+   * sort is still stable.
+   */
+  if (n > UINT32_MAX) {
+    struct keyed_sort ks;
+    ks.elems = s;
+    ks.data = data;
+    ks.tiebreak = NULL;
+    struct sort_key_entry* wide = da->alloc.alloc(da->alloc.ctx,
+      n * sizeof(struct sort_key_entry));
+    for (size_t i = 0; i < n; i++) {
+      wide[i].hi = key(_sort_val(&s, data + i * w));
+      wide[i].lo = 0;
+      wide[i].index = i;
+    }
+    _sort_keyed_entries(da, &ks, wide, n);
+    return;
+  }
+
+  /*
+   * Each entry packs an element's key into its high 32 bits and the
+   * element's index into its low 32 bits, so the passes below move keys and
+   * indices together with a single 8-byte copy.
+   */
+  size_t entries_size = 2 * n * sizeof(uint64_t);
+  uint64_t* entries = da->alloc.alloc(da->alloc.ctx, entries_size);
+  uint64_t* src = entries;
+  uint64_t* dst = entries + n;
+
+  size_t counts[SORT_RADIX_PASSES][SORT_RADIX_BUCKETS];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < n; i++) {
+    uint32_t k = key(_sort_val(&s, data + i * w));
+    src[i] = (uint64_t)k << 32 | i;
+    for (int p = 0; p < SORT_RADIX_PASSES; p++) {
+      counts[p][(k >> (p * SORT_RADIX_BITS)) & (SORT_RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  for (int p = 0; p < SORT_RADIX_PASSES; p++) {
+    int shift = 32 + p * SORT_RADIX_BITS;
+
+    /*
+     * If every key has the same digit in this position, the pass wouldn't
+     * change anything.
+     */
+    size_t first = (src[0] >> shift) & (SORT_RADIX_BUCKETS - 1);
+    if (counts[p][first] == n) {
+      continue;
+    }
+
+    size_t offsets[SORT_RADIX_BUCKETS];
+    size_t total = 0;
+    for (int b = 0; b < SORT_RADIX_BUCKETS; b++) {
+      offsets[b] = total;
+      total += counts[p][b];
+    }
+    for (size_t i = 0; i < n; i++) {
+      dst[offsets[(src[i] >> shift) & (SORT_RADIX_BUCKETS - 1)]++] = src[i];
+    }
+
+    uint64_t* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  /*
+   * Gather the elements into sorted order and copy them back.
+   */
+  char* sorted = da->alloc.alloc(da->alloc.ctx, n * w);
+  for (size_t i = 0; i < n; i++) {
+    _sort_copy(&s, sorted + i * w, data + (uint32_t)src[i] * w);
+  }
+  memcpy(data, sorted, n * w);
+
+  da->alloc.release(da->alloc.ctx, sorted, n * w);
+  da->alloc.release(da->alloc.ctx, entries, entries_size);
+
+}
+
+
+void dynarray_keyed_sort(struct dynarray* da, dynarray_wide_key_fn key,
+    dynarray_cmp_fn tiebreak) {
+
+  assert(da && key);
+
+  size_t n = dynarray_length(da);
+  if (n < 2) {
+    return;
+  }
+
+  struct keyed_sort ks;
+  _sort_state_init(&ks.elems, da, NULL);
+  ks.data = dynarray_data(da);
+  ks.tiebreak = tiebreak;
+  size_t w = ks.elems.width;
+
+  struct sort_key_entry* entries = da->alloc.alloc(da->alloc.ctx,
+    n * sizeof(struct sort_key_entry));
+  for (size_t i = 0; i < n; i++) {
+    uint64_t k[2];
+    key(_sort_val(&ks.elems, ks.data + i * w), k);
+    entries[i].hi = k[0];
+    entries[i].lo = k[1];
+    entries[i].index = i;
+  }
+  _sort_keyed_entries(da, &ks, entries, n);
+
+}
@@ -0,0 +1,151 @@
+/*
+ * This file contains the definition of an interface for sorting the elements
+ * of a dynamic array.
+ */
+
+#ifndef __DYNARRAY_SORT_H
+#define __DYNARRAY_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dynarray.h"
+
+/*
+ * The default minimum number of elements each thread is given by
+ * dynarray_parallel_sort().  Below this, the cost of starting threads and
+ * merging their results outweighs the time saved by sorting in parallel.
+ */
+#define DYNARRAY_PARALLEL_SORT_CUTOFF 65536
+
+/*
+ * Type of the comparison functions used to order the elements of a dynamic
+ * array.  Each argument is what dynarray_get() would return for one of the
+ * elements being compared, i.e. the stored pointer for pointer arrays and a
+ * pointer to the record for record arrays.  A comparison function should
+ * return a negative value if a belongs before b, a positive value if a belongs
+ * after b, and 0 if the two are equivalent.
+ */
+typedef int (*dynarray_cmp_fn)(void* a, void* b);
+
+/*
+ * Type of the key extraction functions used by dynarray_radix_sort().  The
+ * argument is what dynarray_get() would return for an element, and the
+ * return value is the element's sort key.  Keys are compared as unsigned
+ * integers, so a signed key k should be returned as (uint32_t)k ^ 0x80000000
+ * to keep negative keys in front of positive ones.
+ */
+typedef uint32_t (*dynarray_key_fn)(void* elem);
+
+/*
+ * Type of the key extraction functions used by dynarray_keyed_sort().  The
+ * first argument is what dynarray_get() would return for an element, and the
+ * function should store the element's 128-bit sort key in key, with the most
+ * significant 64 bits in key[0].  Keys are compared as unsigned integers, so
+ * several fields can be packed into one key, most significant field first,
+ * as long as each is encoded so that it orders correctly as an unsigned
+ * integer.
+ */
+typedef void (*dynarray_wide_key_fn)(void* elem, uint64_t key[2]);
+
+/*
+ * Sorts the elements of a dynamic array in place into ascending order.  This
+ * is a pattern-defeating quicksort: small ranges are finished with insertion
+ * sort, already-sorted and reversed runs are detected and handled in linear
+ * time, and ranges that keep partitioning badly fall back to heapsort, so the
+ * sort always runs in O(n log n) time.  Recursion depth is bounded by
+ * O(log n).  The sort is not stable, i.e. equivalent elements may end up in
+ * any order.  It allocates no memory beyond a couple of temporary elements.
+ *
+ * Params:
+ *   da - the dynamic array to be sorted.  May not be NULL.
+ *   cmp - the comparison function used to order the array's elements.  May
+ *     not be NULL.
+ */
+void dynarray_sort(struct dynarray* da, dynarray_cmp_fn cmp);
+
+/*
+ * Sorts the elements of a dynamic array in place into ascending order,
+ * keeping equivalent elements in the order they were in before sorting.  This
+ * is a merge sort that runs in O(n log n) time and uses a temporary buffer
+ * half the size of the array, allocated from the array's allocator.
+ *
+ * Params:
+ *   da - the dynamic array to be sorted.  May not be NULL.
+ *   cmp - the comparison function used to order the array's elements.  May
+ *     not be NULL.
+ */
+void dynarray_stable_sort(struct dynarray* da, dynarray_cmp_fn cmp);
+
+/*
+ * Sorts the elements of a dynamic array in place into ascending order using
+ * several threads.  The array is split into one chunk per thread, each
+ * thread sorts its chunk with the same algorithm as dynarray_sort(), and then
+ * the chunks are merged pairwise in rounds until the whole array is sorted.
+ * Each merge is itself split evenly across all of the threads whose chunks it
+ * covers, so every thread stays busy until the end.  The sort is not stable.
+ * It uses a temporary buffer the size of the array, allocated from the
+ * array's allocator before any threads are started.
+ *
+ * The comparison function is called from several threads at once, so it must
+ * not modify any shared state.
+ *
+ * Params:
+ *   da - the dynamic array to be sorted.  May not be NULL.
+ *   cmp - the comparison function used to order the array's elements.  May
+ *     not be NULL.
+ *   num_threads - the maximum number of threads to use, including the calling
+ *     thread.  May be 0 to use one thread per online CPU.
+ *   cutoff - the minimum number of elements to give each thread.  Fewer
+ *     threads are used when the array is too small to give each of them this
+ *     many, and arrays smaller than twice this are sorted by the calling
+ *     thread alone with dynarray_sort().  May be 0 to use
+ *     DYNARRAY_PARALLEL_SORT_CUTOFF.
+ */
+void dynarray_parallel_sort(struct dynarray* da, dynarray_cmp_fn cmp,
+  int num_threads, size_t cutoff);
+
+/*
+ * Sorts the elements of a dynamic array in place into ascending order of a
+ * 32-bit integer key, keeping elements with equal keys in their original
+ * order.  This is an LSD radix sort: each element's key is extracted once into
+ * a scratch array alongside its index, the radix passes then run over that
+ * scratch array alone, and finally the elements are moved into their sorted
+ * positions in one pass.  It takes O(n) time and skips passes over bytes that
+ * are the same in every key, so narrow key ranges cost fewer passes.  It uses
+ * scratch space of about 16 bytes plus one element per array element,
+ * allocated from the array's allocator.  Arrays of more than UINT32_MAX
+ * elements, whose indices don't fit in the scratch entries, are instead
+ * sorted like dynarray_keyed_sort() sorts them, in O(n log n) time.
+ *
+ * Params:
+ *   da - the dynamic array to be sorted.  May not be NULL.
+ *   key - the function used to extract each element's key.  May not be NULL.
+ */
+void dynarray_radix_sort(struct dynarray* da, dynarray_key_fn key);
+
+/*
+ * Sorts the elements of a dynamic array in place by a precomputed 128-bit
+ * key, keeping elements that compare equal in their original order.  Each
+ * element's key is extracted once into a scratch array of (key, index)
+ * entries, the entries are sorted by the same pattern-defeating quicksort as
+ * dynarray_sort(), with comparisons that are plain integer compares on that
+ * contiguous array, and finally the elements are moved into their sorted
+ * positions in one pass.  Compared to sorting the
+ * elements with a comparison function, this trades one key extraction per
+ * element for never following an element's pointer during the sort itself.
+ * It uses scratch space of about 24 bytes plus one element per array
+ * element, allocated from the array's allocator.
+ *
+ * Params:
+ *   da - the dynamic array to be sorted.  May not be NULL.
+ *   key - the function used to extract each element's key.  May not be NULL.
+ *   tiebreak - a comparison function used to order elements with equal keys,
+ *     or NULL to leave them in their original order.  It's only called for
+ *     elements whose keys are equal, so a key that captures most of the
+ *     ordering keeps it off the sort's fast path.
+ */
+void dynarray_keyed_sort(struct dynarray* da, dynarray_wide_key_fn key,
+  dynarray_cmp_fn tiebreak);
+
+#endif
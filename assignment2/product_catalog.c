@@ -0,0 +1,401 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the sorted product catalog declared in product_catalog.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "product_catalog.h"
+#include "products.h"
+#include "dynarray_sort.h"
+
+/*
+ * This is the definition of the product catalog structure.  products is an
+ * array of pointers sorted by inventory and then address, and ids is a record
+ * array of size_t moved in step with it, giving each product an id that stays
+ * the same while the product moves around the catalog.
+ *
+ * by_price and by_investment are tournament trees over those ids, stored as
+ * implicit binary trees with num_leaves leaves.  Leaf num_leaves + id holds
+ * the product with that id, or NULL if the id isn't in use, node i holds the
+ * winner of its children 2 * i and 2 * i + 1, and node 1 holds the maximum.
+ * Ids [0, next_id) have been handed out, and the num_free ids at the start of
+ * free_ids have been given back by removed products and can be reused.
+ */
+struct product_catalog {
+  struct dynarray* products;
+  struct dynarray* ids;
+  struct product** by_price;
+  struct product** by_investment;
+  size_t* free_ids;
+  size_t num_free;
+  size_t next_id;
+  size_t num_leaves;
+};
+
+
+/*
+ * Auxilliary function to return whether product a, with inventory
+ * inventory_a, comes before product b, with inventory inventory_b, in a
+ * catalog's order.  The inventories are passed separately so that a product
+ * can be compared as if it already had the inventory it's being given.
+ */
+int _product_catalog_before(int inventory_a, struct product* a,
+    int inventory_b, struct product* b) {
+
+  return inventory_a < inventory_b ||
+    (inventory_a == inventory_b && (uintptr_t)a < (uintptr_t)b);
+
+}
+
+
+/*
+ * Comparison function used to sort a new catalog's products.
+ */
+int _product_catalog_compare(void* a, void* b) {
+
+  struct product* pa = a;
+  struct product* pb = b;
+  if (_product_catalog_before(pa->inventory, pa, pb->inventory, pb)) {
+    return -1;
+  }
+  return pa == pb ? 0 : 1;
+
+}
+
+
+/*
+ * Auxilliary functions to return whether a product ranks above another by
+ * price or by investment.  Ties go to the product that comes first in the
+ * catalog's order.
+ */
+int _product_catalog_better_price(struct product* a, struct product* b) {
+
+  return a->price > b->price ||
+    (a->price == b->price &&
+      _product_catalog_before(a->inventory, a, b->inventory, b));
+
+}
+
+
+int _product_catalog_better_investment(struct product* a, struct product* b) {
+
+  float ia = a->inventory * a->price;
+  float ib = b->inventory * b->price;
+  return ia > ib ||
+    (ia == ib && _product_catalog_before(a->inventory, a, b->inventory, b));
+
+}
+
+
+/*
+ * Auxilliary function to return whichever of two products ranks higher
+ * according to better.  Either product may be NULL, in which case the other
+ * one wins.
+ */
+struct product* _product_catalog_winner(struct product* a, struct product* b,
+    int (*better)(struct product*, struct product*)) {
+
+  if (!a) {
+    return b;
+  }
+  if (!b) {
+    return a;
+  }
+  return better(b, a) ? b : a;
+
+}
+
+
+/*
+ * Auxilliary function to replay the matches of a catalog's tournaments at
+ * node i from the winners of its children.
+ */
+void _product_catalog_replay(struct product_catalog* catalog, size_t i) {
+
+  catalog->by_price[i] = _product_catalog_winner(catalog->by_price[2 * i],
+    catalog->by_price[2 * i + 1], _product_catalog_better_price);
+  catalog->by_investment[i] = _product_catalog_winner(
+    catalog->by_investment[2 * i], catalog->by_investment[2 * i + 1],
+    _product_catalog_better_investment);
+
+}
+
+
+/*
+ * Auxilliary function to put a product, or NULL, at the leaf of a catalog's
+ * tournaments for a given id and replay the matches on the way up from it.
+ * This is also how a product whose inventory changed is reranked, since only
+ * the matches it played in can have a different outcome.
+ */
+void _product_catalog_set_leaf(struct product_catalog* catalog, size_t id,
+    struct product* p) {
+
+  size_t i = catalog->num_leaves + id;
+  catalog->by_price[i] = p;
+  catalog->by_investment[i] = p;
+  for (i /= 2; i > 0; i /= 2) {
+    _product_catalog_replay(catalog, i);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to give a catalog's tournaments num_leaves leaves and
+ * fill them in from scratch from the catalog's products and their ids.
+ */
+void _product_catalog_rebuild(struct product_catalog* catalog,
+    size_t num_leaves) {
+
+  free(catalog->by_price);
+  free(catalog->by_investment);
+  catalog->by_price = calloc(2 * num_leaves, sizeof(struct product*));
+  catalog->by_investment = calloc(2 * num_leaves, sizeof(struct product*));
+  catalog->free_ids = realloc(catalog->free_ids, num_leaves * sizeof(size_t));
+  assert(catalog->by_price && catalog->by_investment && catalog->free_ids);
+  catalog->num_leaves = num_leaves;
+
+  size_t length = dynarray_length(catalog->products);
+  size_t* ids = dynarray_data(catalog->ids);
+  for (size_t i = 0; i < length; i++) {
+    struct product* p = dynarray_get_unchecked(catalog->products, i);
+    catalog->by_price[num_leaves + ids[i]] = p;
+    catalog->by_investment[num_leaves + ids[i]] = p;
+  }
+  for (size_t i = num_leaves - 1; i > 0; i--) {
+    _product_catalog_replay(catalog, i);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to hand out an id for a product being added to a
+ * catalog, reusing one given back by a removed product if there is one and
+ * doubling the number of leaves in the catalog's tournaments if they're full.
+ */
+size_t _product_catalog_new_id(struct product_catalog* catalog) {
+
+  if (catalog->num_free > 0) {
+    return catalog->free_ids[--catalog->num_free];
+  }
+  if (catalog->next_id == catalog->num_leaves) {
+    _product_catalog_rebuild(catalog, 2 * catalog->num_leaves);
+  }
+  return catalog->next_id++;
+
+}
+
+
+/*
+ * Auxilliary function to return the first position in [lo, hi) of a
+ * catalog's array holding a product that doesn't come before product p with
+ * the given inventory, or hi if there is none.  p itself must not be in
+ * [lo, hi) unless its inventory is the one given.
+ */
+size_t _product_catalog_lower_bound(struct product_catalog* catalog,
+    size_t lo, size_t hi, int inventory, struct product* p) {
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    struct product* q = dynarray_get_unchecked(catalog->products, mid);
+    if (_product_catalog_before(q->inventory, q, inventory, p)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+
+}
+
+
+/*
+ * Auxilliary function to return the position of a product in a catalog, or
+ * DYNARRAY_END if it isn't there.
+ */
+size_t _product_catalog_find(struct product_catalog* catalog,
+    struct product* p) {
+
+  size_t length = dynarray_length(catalog->products);
+  size_t pos = _product_catalog_lower_bound(catalog, 0, length, p->inventory,
+    p);
+  if (pos < length && dynarray_get_unchecked(catalog->products, pos) == p) {
+    return pos;
+  }
+  return DYNARRAY_END;
+
+}
+
+
+struct product_catalog* product_catalog_create(struct dynarray* products) {
+
+  assert(products);
+
+  struct product_catalog* catalog = malloc(sizeof(struct product_catalog));
+  assert(catalog);
+  catalog->products = dynarray_create();
+  size_t length = dynarray_length(products);
+  dynarray_reserve(catalog->products, length);
+  for (size_t i = 0; i < length; i++) {
+    dynarray_insert(catalog->products, DYNARRAY_END,
+      dynarray_get(products, i));
+  }
+  dynarray_sort(catalog->products, _product_catalog_compare);
+
+  /*
+   * Number the products in order, and give the tournaments room for all of
+   * them.
+   */
+  catalog->ids = dynarray_create_sized(sizeof(size_t));
+  dynarray_insert_range(catalog->ids, DYNARRAY_END, NULL, length);
+  size_t* ids = dynarray_data(catalog->ids);
+  for (size_t i = 0; i < length; i++) {
+    ids[i] = i;
+  }
+  size_t num_leaves = 1;
+  while (num_leaves < length) {
+    num_leaves *= 2;
+  }
+  catalog->by_price = NULL;
+  catalog->by_investment = NULL;
+  catalog->free_ids = NULL;
+  catalog->num_free = 0;
+  catalog->next_id = length;
+  _product_catalog_rebuild(catalog, num_leaves);
+  return catalog;
+
+}
+
+
+void product_catalog_free(struct product_catalog* catalog) {
+
+  assert(catalog);
+  dynarray_free(catalog->products);
+  dynarray_free(catalog->ids);
+  free(catalog->by_price);
+  free(catalog->by_investment);
+  free(catalog->free_ids);
+  free(catalog);
+
+}
+
+
+size_t product_catalog_length(struct product_catalog* catalog) {
+
+  assert(catalog);
+  return dynarray_length(catalog->products);
+
+}
+
+
+struct product* product_catalog_get(struct product_catalog* catalog,
+    size_t idx) {
+
+  assert(catalog && idx < dynarray_length(catalog->products));
+  return dynarray_get_unchecked(catalog->products, idx);
+
+}
+
+
+void product_catalog_insert(struct product_catalog* catalog,
+    struct product* product) {
+
+  assert(catalog && product);
+  size_t pos = _product_catalog_lower_bound(catalog, 0,
+    dynarray_length(catalog->products), product->inventory, product);
+  size_t id = _product_catalog_new_id(catalog);
+  dynarray_insert(catalog->products, pos, product);
+  dynarray_insert(catalog->ids, pos, &id);
+  _product_catalog_set_leaf(catalog, id, product);
+
+}
+
+
+int product_catalog_remove(struct product_catalog* catalog,
+    struct product* product) {
+
+  assert(catalog && product);
+  size_t pos = _product_catalog_find(catalog, product);
+  if (pos == DYNARRAY_END) {
+    return -1;
+  }
+  size_t id = *(size_t*)dynarray_get_unchecked(catalog->ids, pos);
+  dynarray_remove(catalog->products, pos);
+  dynarray_remove(catalog->ids, pos);
+  _product_catalog_set_leaf(catalog, id, NULL);
+  catalog->free_ids[catalog->num_free++] = id;
+  return 0;
+
+}
+
+
+int product_update_inventory(struct product_catalog* catalog,
+    struct product* product, int new_value) {
+
+  assert(catalog && product);
+  size_t old_pos = _product_catalog_find(catalog, product);
+  if (old_pos == DYNARRAY_END) {
+    return -1;
+  }
+  int moves_up = new_value > product->inventory;
+
+  /*
+   * Find the product's new place among the products on the side it's moving
+   * towards, then shift the products in between, and their ids, over by one
+   * and drop the product into the gap.
+   */
+  size_t length = dynarray_length(catalog->products);
+  void** data = dynarray_data(catalog->products);
+  size_t* ids = dynarray_data(catalog->ids);
+  size_t id = ids[old_pos];
+  if (moves_up) {
+    size_t new_pos = _product_catalog_lower_bound(catalog, old_pos + 1,
+      length, new_value, product) - 1;
+    memmove(data + old_pos, data + old_pos + 1,
+      (new_pos - old_pos) * sizeof(void*));
+    memmove(ids + old_pos, ids + old_pos + 1,
+      (new_pos - old_pos) * sizeof(size_t));
+    data[new_pos] = product;
+    ids[new_pos] = id;
+  } else {
+    size_t new_pos = _product_catalog_lower_bound(catalog, 0, old_pos,
+      new_value, product);
+    memmove(data + new_pos + 1, data + new_pos,
+      (old_pos - new_pos) * sizeof(void*));
+    memmove(ids + new_pos + 1, ids + new_pos,
+      (old_pos - new_pos) * sizeof(size_t));
+    data[new_pos] = product;
+    ids[new_pos] = id;
+  }
+  product->inventory = new_value;
+
+  /*
+   * Only the product's own investment and place in the order changed, so
+   * replaying the matches it played in reranks it against everything else.
+   */
+  _product_catalog_set_leaf(catalog, id, product);
+  return 0;
+
+}
+
+
+struct product* product_catalog_max_price(struct product_catalog* catalog) {
+
+  assert(catalog);
+  return catalog->by_price[1];
+
+}
+
+
+struct product* product_catalog_max_investment(
+    struct product_catalog* catalog) {
+
+  assert(catalog);
+  return catalog->by_investment[1];
+
+}
@@ -0,0 +1,140 @@
+/*
+ * This file contains the definition of an interface for a product catalog
+ * that keeps its products sorted by inventory as their inventories change.
+ */
+
+#ifndef __PRODUCT_CATALOG_H
+#define __PRODUCT_CATALOG_H
+
+#include <stddef.h>
+
+#include "dynarray.h"
+
+struct product;
+
+/*
+ * Structure used to represent a sorted product catalog.  The catalog holds
+ * pointers to products, kept in ascending order of inventory, so it always
+ * looks like an array that sort_by_inventory() has just sorted.  Products with
+ * equal inventories are ordered by address, which makes the order total and
+ * lets any product be found by binary search.
+ *
+ * Changing a product's inventory through product_update_inventory() moves
+ * just that product to its new place, shifting only the products between its
+ * old and new positions, instead of sorting the whole catalog again.  The
+ * catalog also remembers which products have the highest price and the
+ * largest investment, and updates them as products change, so they don't
+ * need a full scan after every change either.
+ *
+ * The catalog doesn't own its products.  Their inventories must only be
+ * changed through product_update_inventory() while they're in the catalog,
+ * and their prices must not be changed at all.
+ */
+struct product_catalog;
+
+/*
+ * Creates a catalog holding the products in an array and returns a pointer
+ * to it.  The array itself is left alone.
+ *
+ * Params:
+ *   products - the products to be added to the catalog.  May be an array of
+ *     pointers or of records, but a record array must not be modified while
+ *     the catalog holds pointers into it.  May not be NULL.
+ */
+struct product_catalog* product_catalog_create(struct dynarray* products);
+
+/*
+ * Frees a catalog.  The products in it are left alone.
+ *
+ * Params:
+ *   catalog - the catalog to be freed.  May not be NULL.
+ */
+void product_catalog_free(struct product_catalog* catalog);
+
+/*
+ * Returns the number of products in a catalog.
+ *
+ * Params:
+ *   catalog - the catalog whose products are to be counted.  May not be NULL.
+ */
+size_t product_catalog_length(struct product_catalog* catalog);
+
+/*
+ * Returns the product at a given position in a catalog's sorted order, so
+ * that position 0 holds the product with the lowest inventory.
+ *
+ * Params:
+ *   catalog - the catalog from which to get the product.  May not be NULL.
+ *   idx - the position of the product.  Must be less than the number of
+ *     products in the catalog.
+ */
+struct product* product_catalog_get(struct product_catalog* catalog,
+  size_t idx);
+
+/*
+ * Adds a product to a catalog at its place in the sorted order.
+ *
+ * Params:
+ *   catalog - the catalog to which to add the product.  May not be NULL.
+ *   product - the product to be added.  May not already be in the catalog.
+ *     May not be NULL.
+ */
+void product_catalog_insert(struct product_catalog* catalog,
+  struct product* product);
+
+/*
+ * Removes a product from a catalog.  The product itself isn't freed.
+ *
+ * Params:
+ *   catalog - the catalog from which to remove the product.  May not be NULL.
+ *   product - the product to be removed.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success, or -1 if the product isn't in the catalog.
+ */
+int product_catalog_remove(struct product_catalog* catalog,
+  struct product* product);
+
+/*
+ * Changes the inventory of a product in a catalog and moves the product to
+ * its new place in the sorted order.  The product is found and its new place
+ * chosen by binary search, and only the products in between are shifted, so
+ * an update costs O(log n) comparisons plus a move of however many products
+ * the product passes.
+ *
+ * Params:
+ *   catalog - the catalog holding the product.  May not be NULL.
+ *   product - the product whose inventory is to be changed.  May not be NULL.
+ *   new_value - the product's new inventory
+ *
+ * Return:
+ *   Returns 0 on success, or -1 if the product isn't in the catalog, in which
+ *   case its inventory isn't changed.
+ */
+int product_update_inventory(struct product_catalog* catalog,
+  struct product* product, int new_value);
+
+/*
+ * Return the product in a catalog with the highest price, or with the largest
+ * investment (inventory times price).  Ties go to the product that comes
+ * first in the catalog's order, so these return the same products that
+ * find_max_price() and find_max_investment() would return for an array
+ * holding the catalog's products in order, as long as no price or investment
+ * is NaN.
+ *
+ * These take constant time.  The catalog keeps each maximum at the root of a
+ * tournament tree over its products, and every insert, removal or update
+ * replays only the O(log n) matches the product it changes played in, so the
+ * maximums are never rescanned.
+ *
+ * Params:
+ *   catalog - the catalog to be queried.  May not be NULL.
+ *
+ * Return:
+ *   Returns the product, or NULL if the catalog is empty.
+ */
+struct product* product_catalog_max_price(struct product_catalog* catalog);
+struct product* product_catalog_max_investment(
+  struct product_catalog* catalog);
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * This file contains the definitions of the functions declared in
+ * product_columns.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "product_columns.h"
+#include "simd_kernels.h"
+
+#define PRODUCT_COLUMNS_INIT_CAPACITY 8
+#define PRODUCT_COLUMNS_INIT_NAMES_CAPACITY 64
+
+
+/*
+ * Auxilliary function to resize the price, inventory and name offset columns
+ * of a catalog to hold a given number of products.
+ */
+void _product_columns_resize(struct product_columns* pc, size_t capacity) {
+
+  assert(capacity < SIZE_MAX / sizeof(size_t));
+  pc->prices = realloc(pc->prices, capacity * sizeof(float));
+  pc->inventories = realloc(pc->inventories, capacity * sizeof(int32_t));
+  pc->name_offsets = realloc(pc->name_offsets,
+    (capacity + 1) * sizeof(size_t));
+  assert(pc->prices && pc->inventories && pc->name_offsets);
+  pc->capacity = capacity;
+
+}
+
+
+/*
+ * Auxilliary function to make sure a catalog's names blob has room for at
+ * least a given number of bytes in total.
+ */
+void _product_columns_reserve_names(struct product_columns* pc, size_t size) {
+
+  if (size <= pc->names_capacity) {
+    return;
+  }
+  size_t capacity = pc->names_capacity;
+  while (capacity < size) {
+    assert(capacity <= SIZE_MAX / 2);
+    capacity *= 2;
+  }
+  pc->names = realloc(pc->names, capacity);
+  assert(pc->names);
+  pc->names_capacity = capacity;
+
+}
+
+
+struct product_columns* product_columns_create(size_t capacity) {
+
+  struct product_columns* pc = malloc(sizeof(struct product_columns));
+  assert(pc);
+
+  pc->length = 0;
+  pc->prices = NULL;
+  pc->inventories = NULL;
+  pc->name_offsets = NULL;
+  _product_columns_resize(pc, capacity > 0 ? capacity
+    : PRODUCT_COLUMNS_INIT_CAPACITY);
+  pc->name_offsets[0] = 0;
+
+  pc->names_capacity = PRODUCT_COLUMNS_INIT_NAMES_CAPACITY;
+  pc->names = malloc(pc->names_capacity);
+  assert(pc->names);
+
+  return pc;
+
+}
+
+
+struct product_columns* create_product_columns(size_t num_products,
+    char** names, int* inventories, float* prices) {
+
+  struct product_columns* pc = product_columns_create(num_products);
+
+  /*
+   * Size the names blob exactly, so the appends below never reallocate it.
+   */
+  size_t names_size = 0;
+  for (size_t i = 0; i < num_products; i++) {
+    names_size += strlen(names[i]) + 1;
+  }
+  _product_columns_reserve_names(pc, names_size);
+
+  for (size_t i = 0; i < num_products; i++) {
+    product_columns_append(pc, names[i], inventories[i], prices[i]);
+  }
+  return pc;
+
+}
+
+
+void free_product_columns(struct product_columns* pc) {
+
+  assert(pc);
+  free(pc->prices);
+  free(pc->inventories);
+  free(pc->name_offsets);
+  free(pc->names);
+  free(pc);
+
+}
+
+
+size_t product_columns_append(struct product_columns* pc, const char* name,
+    int inventory, float price) {
+
+  assert(pc && name);
+
+  if (pc->length == pc->capacity) {
+    _product_columns_resize(pc, 2 * pc->capacity);
+  }
+
+  size_t offset = pc->name_offsets[pc->length];
+  size_t size = strlen(name) + 1;
+  _product_columns_reserve_names(pc, offset + size);
+  memcpy(pc->names + offset, name, size);
+
+  size_t idx = pc->length++;
+  pc->prices[idx] = price;
+  pc->inventories[idx] = inventory;
+  pc->name_offsets[idx + 1] = offset + size;
+  return idx;
+
+}
+
+
+size_t product_columns_length(struct product_columns* pc) {
+
+  assert(pc);
+  return pc->length;
+
+}
+
+
+const char* product_columns_name(struct product_columns* pc, size_t idx) {
+
+  assert(pc && idx < pc->length);
+  return pc->names + pc->name_offsets[idx];
+
+}
+
+
+int product_columns_inventory(struct product_columns* pc, size_t idx) {
+
+  assert(pc && idx < pc->length);
+  return pc->inventories[idx];
+
+}
+
+
+float product_columns_price(struct product_columns* pc, size_t idx) {
+
+  assert(pc && idx < pc->length);
+  return pc->prices[idx];
+
+}
+
+
+size_t product_columns_find_max_price(struct product_columns* pc) {
+
+  assert(pc);
+  return simd_argmax_f32(pc->prices, pc->length);
+
+}
+
+
+size_t product_columns_find_max_investment(struct product_columns* pc) {
+
+  assert(pc);
+  return simd_argmax_mul_i32_f32(pc->inventories, pc->prices, pc->length);
+
+}
+
+
+double product_columns_total_value(struct product_columns* pc) {
+
+  assert(pc);
+  return simd_sum_mul_i32_f32(pc->inventories, pc->prices, pc->length);
+
+}
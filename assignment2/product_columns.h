@@ -0,0 +1,143 @@
+/*
+ * This file contains the definition of an interface for a columnar product
+ * catalog, which stores the same information as an array of struct product
+ * but with each field in its own contiguous column.
+ */
+
+#ifndef __PRODUCT_COLUMNS_H
+#define __PRODUCT_COLUMNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Value returned by the scan functions below when the catalog is empty.  This
+ * is the same value as SIMD_NONE, which the scans pass through.
+ */
+#define PRODUCT_COLUMNS_NONE ((size_t)-1)
+
+/*
+ * Structure used to represent a columnar product catalog.  Product i's price
+ * is prices[i] and its inventory is inventories[i].  Names are packed one
+ * after another, each with its terminating NUL, into the names blob, and
+ * product i's name starts at names + name_offsets[i].  name_offsets has one
+ * more entry than there are products, so name_offsets[i + 1] -
+ * name_offsets[i] - 1 is the length of product i's name.
+ *
+ * Because each column is contiguous, a scan that reads only prices walks
+ * through 4 bytes per product instead of following a pointer to each one.
+ * The fields are exposed so that scans can work on whole columns at once, but
+ * they should only be modified through the functions below.
+ */
+struct product_columns {
+  size_t length;
+  size_t capacity;
+  float* prices;
+  int32_t* inventories;
+  size_t* name_offsets;
+  char* names;
+  size_t names_capacity;
+};
+
+/*
+ * Creates a new, empty columnar catalog and returns a pointer to it.
+ *
+ * Params:
+ *   capacity - the number of products to allocate room for up front.  The
+ *     catalog grows as needed, so this may be 0.
+ */
+struct product_columns* product_columns_create(size_t capacity);
+
+/*
+ * Creates a columnar catalog holding the given products, so that the i'th
+ * product has the i'th name, inventory and price.  This is the columnar
+ * counterpart of create_product_array().
+ *
+ * Params:
+ *   num_products - the number of products to be stored
+ *   names, inventories, prices - arrays of length num_products holding each
+ *     product's fields.  The names are copied into the catalog.
+ *
+ * Return:
+ *   Returns a pointer to the new catalog, which should be freed with
+ *   free_product_columns().
+ */
+struct product_columns* create_product_columns(size_t num_products,
+  char** names, int* inventories, float* prices);
+
+/*
+ * Frees all of the memory associated with a columnar catalog, including its
+ * names.  This is the columnar counterpart of free_product_array().
+ *
+ * Params:
+ *   pc - the catalog to be freed.  May not be NULL.
+ */
+void free_product_columns(struct product_columns* pc);
+
+/*
+ * Appends a product to the end of a columnar catalog.
+ *
+ * Params:
+ *   pc - the catalog to which to append.  May not be NULL.
+ *   name - the product's name, which is copied into the catalog.  May not be
+ *     NULL.
+ *   inventory - the product's inventory
+ *   price - the product's price
+ *
+ * Return:
+ *   Returns the index of the new product.
+ */
+size_t product_columns_append(struct product_columns* pc, const char* name,
+  int inventory, float price);
+
+/*
+ * Accessors for the number of products in a columnar catalog and for the
+ * fields of the product at index idx, which must be less than the number of
+ * products.  The pointer returned by product_columns_name() points into the
+ * catalog and is only valid until the next product is appended.
+ */
+size_t product_columns_length(struct product_columns* pc);
+const char* product_columns_name(struct product_columns* pc, size_t idx);
+int product_columns_inventory(struct product_columns* pc, size_t idx);
+float product_columns_price(struct product_columns* pc, size_t idx);
+
+/*
+ * Returns the index of the product with the highest price in a columnar
+ * catalog, reading only the price column with the vectorized kernels in
+ * simd_kernels.h.  Ties go to the earliest product, as with find_max_price().
+ *
+ * Params:
+ *   pc - the catalog to be scanned.  May not be NULL.
+ *
+ * Return:
+ *   Returns the index of the product with the highest price, or
+ *   PRODUCT_COLUMNS_NONE if the catalog is empty.
+ */
+size_t product_columns_find_max_price(struct product_columns* pc);
+
+/*
+ * Returns the index of the product with the largest investment (inventory
+ * times price) in a columnar catalog, reading only the inventory and price
+ * columns with the vectorized kernels in simd_kernels.h.  Ties go to the
+ * earliest product, as with find_max_investment().
+ *
+ * Params:
+ *   pc - the catalog to be scanned.  May not be NULL.
+ *
+ * Return:
+ *   Returns the index of the product with the largest investment, or
+ *   PRODUCT_COLUMNS_NONE if the catalog is empty.
+ */
+size_t product_columns_find_max_investment(struct product_columns* pc);
+
+/*
+ * Returns the total value of the inventory in a columnar catalog, i.e. the sum
+ * over all products of inventory times price, computed in double precision
+ * with the vectorized kernels in simd_kernels.h.
+ *
+ * Params:
+ *   pc - the catalog to be scanned.  May not be NULL.
+ */
+double product_columns_total_value(struct product_columns* pc);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the product filters declared in product_filter.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "product_filter.h"
+#include "dynarray.h"
+
+/*
+ * Catalogs are filtered in blocks of this many products.  It must be a
+ * multiple of 64, so that each block covers whole words of the bitmap, and is
+ * chosen so that a block of a column stays in the L1 cache while every
+ * predicate is applied to it.
+ */
+#define PRODUCT_FILTER_BLOCK 4096
+
+/*
+ * The columns predicates can be applied to.
+ */
+enum product_filter_column {
+  PRODUCT_FILTER_INVENTORY,
+  PRODUCT_FILTER_PRICE
+};
+
+/*
+ * This structure represents a single predicate.  Only the value matching the
+ * predicate's column is used.
+ */
+struct product_predicate {
+  enum product_filter_column column;
+  enum simd_cmp op;
+  int inventory;
+  float price;
+};
+
+/*
+ * This is the definition of the product filter structure.  predicates is a
+ * record array of struct product_predicate, in the order they were added.
+ */
+struct product_filter {
+  struct dynarray* predicates;
+};
+
+/*
+ * This structure holds one thread's share of a parallel filter.  The thread
+ * filters products [begin, end), where begin is a multiple of 64, and leaves
+ * the number of them that match in count.
+ */
+struct product_filter_task {
+  struct product_filter* pf;
+  struct product_columns* pc;
+  uint64_t* bitmap;
+  size_t begin;
+  size_t end;
+  size_t count;
+};
+
+
+/*
+ * Auxilliary function to filter products [begin, end) of a catalog into the
+ * corresponding words of a bitmap and return how many of them match.  begin
+ * must be a multiple of 64.
+ */
+size_t _product_filter_range(struct product_filter* pf,
+    struct product_columns* pc, uint64_t* bitmap, size_t begin, size_t end) {
+
+  size_t count = 0;
+  size_t num_predicates = dynarray_length(pf->predicates);
+
+  for (size_t b = begin; b < end; b += PRODUCT_FILTER_BLOCK) {
+    size_t len = end - b < PRODUCT_FILTER_BLOCK ? end - b :
+      PRODUCT_FILTER_BLOCK;
+    size_t words = PRODUCT_FILTER_WORDS(len);
+    uint64_t* bits = bitmap + b / 64;
+    for (size_t w = 0; w < words; w++) {
+      bits[w] = ~(uint64_t)0;
+    }
+    if (len % 64) {
+      bits[words - 1] = ((uint64_t)1 << (len % 64)) - 1;
+    }
+
+    for (size_t p = 0; p < num_predicates; p++) {
+      struct product_predicate* pred =
+        dynarray_get_unchecked(pf->predicates, p);
+      if (pred->column == PRODUCT_FILTER_INVENTORY) {
+        simd_filter_i32(pc->inventories + b, len, pred->op, pred->inventory,
+          bits);
+      } else {
+        simd_filter_f32(pc->prices + b, len, pred->op, pred->price, bits);
+      }
+    }
+
+    for (size_t w = 0; w < words; w++) {
+      count += __builtin_popcountll(bits[w]);
+    }
+  }
+  return count;
+
+}
+
+
+/*
+ * Auxilliary function run by each thread taking part in a parallel filter.
+ */
+void* _product_filter_thread(void* arg) {
+
+  struct product_filter_task* task = arg;
+  task->count = _product_filter_range(task->pf, task->pc, task->bitmap,
+    task->begin, task->end);
+  return NULL;
+
+}
+
+
+/*
+ * Auxilliary function to add a predicate to a filter.
+ */
+void _product_filter_add(struct product_filter* pf,
+    enum product_filter_column column, enum simd_cmp op, int inventory,
+    float price) {
+
+  assert(pf);
+  struct product_predicate pred;
+  pred.column = column;
+  pred.op = op;
+  pred.inventory = inventory;
+  pred.price = price;
+  dynarray_insert(pf->predicates, DYNARRAY_END, &pred);
+
+}
+
+
+struct product_filter* product_filter_create() {
+
+  struct product_filter* pf = malloc(sizeof(struct product_filter));
+  assert(pf);
+  pf->predicates = dynarray_create_sized(sizeof(struct product_predicate));
+  return pf;
+
+}
+
+
+void product_filter_free(struct product_filter* pf) {
+
+  assert(pf);
+  dynarray_free(pf->predicates);
+  free(pf);
+
+}
+
+
+void product_filter_add_inventory(struct product_filter* pf, enum simd_cmp op,
+    int value) {
+
+  _product_filter_add(pf, PRODUCT_FILTER_INVENTORY, op, value, 0.0);
+
+}
+
+
+void product_filter_add_price(struct product_filter* pf, enum simd_cmp op,
+    float value) {
+
+  _product_filter_add(pf, PRODUCT_FILTER_PRICE, op, 0, value);
+
+}
+
+
+size_t product_filter_run(struct product_filter* pf, struct product_columns* pc,
+    uint64_t* bitmap, int num_threads) {
+
+  assert(pf && pc && (bitmap || pc->length == 0) && num_threads >= 0);
+
+  size_t n = pc->length;
+  if (num_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  if ((size_t)num_threads > n / PRODUCT_FILTER_PARALLEL_CUTOFF) {
+    num_threads = (int)(n / PRODUCT_FILTER_PARALLEL_CUTOFF);
+  }
+  if (num_threads <= 1) {
+    return _product_filter_range(pf, pc, bitmap, 0, n);
+  }
+
+  /*
+   * Split the bitmap's words evenly between the threads, so that no two
+   * threads ever write to the same word.
+   */
+  size_t words = PRODUCT_FILTER_WORDS(n);
+  struct product_filter_task* tasks =
+    malloc(num_threads * sizeof(struct product_filter_task));
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  assert(tasks && threads);
+  for (int t = 0; t < num_threads; t++) {
+    size_t end = words * (t + 1) / num_threads * 64;
+    tasks[t].pf = pf;
+    tasks[t].pc = pc;
+    tasks[t].bitmap = bitmap;
+    tasks[t].begin = words * t / num_threads * 64;
+    tasks[t].end = end < n ? end : n;
+  }
+  for (int t = 1; t < num_threads; t++) {
+    int err = pthread_create(&threads[t], NULL, _product_filter_thread,
+      &tasks[t]);
+    assert(err == 0);
+  }
+  _product_filter_thread(&tasks[0]);
+  size_t count = tasks[0].count;
+  for (int t = 1; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+    count += tasks[t].count;
+  }
+
+  free(threads);
+  free(tasks);
+  return count;
+
+}
+
+
+size_t product_filter_select(struct product_filter* pf,
+    struct product_columns* pc, size_t* indices, int num_threads) {
+
+  assert(pf && pc && (indices || pc->length == 0));
+
+  size_t words = PRODUCT_FILTER_WORDS(pc->length);
+  uint64_t* bitmap = malloc(words * sizeof(uint64_t));
+  assert(bitmap || words == 0);
+  product_filter_run(pf, pc, bitmap, num_threads);
+
+  size_t count = 0;
+  for (size_t w = 0; w < words; w++) {
+    uint64_t bits = bitmap[w];
+    while (bits) {
+      indices[count++] = w * 64 + __builtin_ctzll(bits);
+      bits &= bits - 1;
+    }
+  }
+
+  free(bitmap);
+  return count;
+
+}
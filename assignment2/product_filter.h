@@ -0,0 +1,109 @@
+/*
+ * This file contains the definition of an interface for filters that select
+ * the products in a columnar product catalog matching a set of predicates.
+ */
+
+#ifndef __PRODUCT_FILTER_H
+#define __PRODUCT_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "product_columns.h"
+#include "simd_kernels.h"
+
+/*
+ * Returns the number of 64-bit words in a selection bitmap over n products.
+ */
+#define PRODUCT_FILTER_WORDS(n) (((n) + 63) / 64)
+
+/*
+ * The parallel filters give each thread at least this many products, since
+ * smaller scans finish faster than a thread can be started.
+ */
+#define PRODUCT_FILTER_PARALLEL_CUTOFF 65536
+
+/*
+ * Structure used to represent a filter, which is a conjunction of predicates
+ * each comparing one column of a catalog with a constant, such as
+ * "inventory < 10 and price > 50".
+ *
+ * Running a filter doesn't look at products one at a time.  Each predicate is
+ * handed to a vectorized kernel from simd_kernels.h that compares a whole run
+ * of its column at once and clears the bits of the products that fail it in
+ * a selection bitmap.  The catalog is filtered in blocks small enough to stay
+ * in cache, with every predicate applied to a block before moving on to the
+ * next, and once a word of the bitmap is 0 the later predicates skip its
+ * products entirely.  Adding the most selective predicates first therefore
+ * makes filters run faster.
+ */
+struct product_filter;
+
+/*
+ * Creates a new filter with no predicates, which matches every product, and
+ * returns a pointer to it.
+ */
+struct product_filter* product_filter_create();
+
+/*
+ * Frees a filter.
+ *
+ * Params:
+ *   pf - the filter to be freed.  May not be NULL.
+ */
+void product_filter_free(struct product_filter* pf);
+
+/*
+ * Adds a predicate on products' inventories or prices to a filter, so that it
+ * only matches products for which inventory op value, or price op value, also
+ * holds.
+ *
+ * Params:
+ *   pf - the filter to which to add the predicate.  May not be NULL.
+ *   op - the comparison to be made
+ *   value - the constant with which to compare
+ */
+void product_filter_add_inventory(struct product_filter* pf, enum simd_cmp op,
+  int value);
+void product_filter_add_price(struct product_filter* pf, enum simd_cmp op,
+  float value);
+
+/*
+ * Runs a filter over a catalog, building a bitmap of the products it matches.
+ *
+ * Params:
+ *   pf - the filter to be run.  May not be NULL.
+ *   pc - the catalog to be filtered.  May not be NULL.
+ *   bitmap - an array of PRODUCT_FILTER_WORDS(n) words, where n is the length
+ *     of the catalog, in which bit i % 64 of word i / 64 is set if product i
+ *     matches and cleared otherwise.  Bits past the last product are cleared.
+ *   num_threads - the maximum number of threads to use, including the calling
+ *     thread, or 0 to use one per online CPU.  Each thread is given at least
+ *     PRODUCT_FILTER_PARALLEL_CUTOFF products, so small catalogs are filtered
+ *     on the calling thread alone.
+ *
+ * Return:
+ *   Returns the number of products the filter matches.
+ */
+size_t product_filter_run(struct product_filter* pf, struct product_columns* pc,
+  uint64_t* bitmap, int num_threads);
+
+/*
+ * Runs a filter over a catalog, like product_filter_run(), but returns the
+ * indices of the matching products instead of a bitmap.
+ *
+ * Params:
+ *   pf - the filter to be run.  May not be NULL.
+ *   pc - the catalog to be filtered.  May not be NULL.
+ *   indices - an array with room for the index of every product in the
+ *     catalog, in which the indices of the matching products are stored in
+ *     ascending order
+ *   num_threads - see product_filter_run()
+ *
+ * Return:
+ *   Returns the number of indices stored.
+ */
+size_t product_filter_select(struct product_filter* pf,
+  struct product_columns* pc, size_t* indices, int num_threads);
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the product index declared in product_index.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "product_index.h"
+#include "products.h"
+
+#define PRODUCT_INDEX_MIN_SLOTS 16
+
+/*
+ * This structure represents a slot in an index's hash table.  pos is the
+ * position in the array of the product the slot refers to, or
+ * PRODUCT_INDEX_NONE for empty slots, and hash is part of the hash of that
+ * product's name.
+ */
+struct product_index_slot {
+  size_t pos;
+  uint32_t hash;
+};
+
+/*
+ * This is the definition of the product index structure.  The number of
+ * slots is always a power of 2, and an entry's home slot is given by the low
+ * bits of its hash.
+ */
+struct product_index {
+  struct dynarray* products;
+  struct product_index_slot* slots;
+  size_t num_slots;
+  size_t count;
+};
+
+
+/*
+ * Auxilliary function to hash a name with 64-bit FNV-1a and keep the low 32
+ * bits of the result.
+ */
+uint32_t _product_index_hash(const char* name) {
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (; *name; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 1099511628211ULL;
+  }
+  return (uint32_t)hash;
+
+}
+
+
+/*
+ * Auxilliary function to return the name of the product at position pos in
+ * an index's array.
+ */
+const char* _product_index_name(struct product_index* pi, size_t pos) {
+
+  struct product* p = dynarray_get_unchecked(pi->products, pos);
+  return p->name;
+
+}
+
+
+/*
+ * Auxilliary function to return how far the entry in slot i of an index is
+ * from its home slot.
+ */
+size_t _product_index_distance(struct product_index* pi, size_t i) {
+
+  return (i - (pi->slots[i].hash & (pi->num_slots - 1))) &
+    (pi->num_slots - 1);
+
+}
+
+
+/*
+ * Auxilliary function to allocate num_slots empty slots.
+ */
+struct product_index_slot* _product_index_alloc_slots(size_t num_slots) {
+
+  struct product_index_slot* slots =
+    malloc(num_slots * sizeof(struct product_index_slot));
+  assert(slots);
+  for (size_t i = 0; i < num_slots; i++) {
+    slots[i].pos = PRODUCT_INDEX_NONE;
+  }
+  return slots;
+
+}
+
+
+/*
+ * Auxilliary function to return the slot holding the entry for name, whose
+ * hash is given, or PRODUCT_INDEX_NONE if the name isn't in the index.
+ */
+size_t _product_index_find_slot(struct product_index* pi, const char* name,
+    uint32_t hash) {
+
+  size_t mask = pi->num_slots - 1;
+  size_t i = hash & mask;
+  for (size_t dist = 0; ; dist++) {
+    struct product_index_slot* slot = &pi->slots[i];
+    /*
+     * Had the name been in the index, it would have displaced any entry
+     * closer to its home slot than it is to the name's, so reaching such an
+     * entry means the name isn't there.
+     */
+    if (slot->pos == PRODUCT_INDEX_NONE ||
+        _product_index_distance(pi, i) < dist) {
+      return PRODUCT_INDEX_NONE;
+    }
+    if (slot->hash == hash &&
+        strcmp(_product_index_name(pi, slot->pos), name) == 0) {
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to add an entry to an index's hash table, which must
+ * have an empty slot.  Whenever the entry being placed is further from home
+ * than the entry in the slot it's probing, the two trade places and the
+ * displaced entry carries on probing instead.
+ */
+void _product_index_place(struct product_index* pi, size_t pos,
+    uint32_t hash) {
+
+  size_t mask = pi->num_slots - 1;
+  struct product_index_slot entry;
+  entry.pos = pos;
+  entry.hash = hash;
+  size_t i = hash & mask;
+  for (size_t dist = 0; ; dist++) {
+    if (pi->slots[i].pos == PRODUCT_INDEX_NONE) {
+      pi->slots[i] = entry;
+      return;
+    }
+    size_t existing = _product_index_distance(pi, i);
+    if (existing < dist) {
+      struct product_index_slot displaced = pi->slots[i];
+      pi->slots[i] = entry;
+      entry = displaced;
+      dist = existing;
+    }
+    i = (i + 1) & mask;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to double the number of slots in an index's hash table
+ * and reinsert every entry into the new slots.
+ */
+void _product_index_grow(struct product_index* pi) {
+
+  struct product_index_slot* old = pi->slots;
+  size_t old_num_slots = pi->num_slots;
+  pi->num_slots *= 2;
+  pi->slots = _product_index_alloc_slots(pi->num_slots);
+  for (size_t i = 0; i < old_num_slots; i++) {
+    if (old[i].pos != PRODUCT_INDEX_NONE) {
+      _product_index_place(pi, old[i].pos, old[i].hash);
+    }
+  }
+  free(old);
+
+}
+
+
+struct product_index* product_index_build(struct dynarray* products) {
+
+  assert(products);
+
+  /*
+   * Robin Hood hashing keeps probe sequences short even when the table is
+   * nearly full, so the table is kept at most 7/8 full.
+   */
+  size_t n = dynarray_length(products);
+  size_t num_slots = PRODUCT_INDEX_MIN_SLOTS;
+  while (8 * n > 7 * num_slots) {
+    num_slots *= 2;
+  }
+
+  struct product_index* pi = malloc(sizeof(struct product_index));
+  assert(pi);
+  pi->products = products;
+  pi->num_slots = num_slots;
+  pi->slots = _product_index_alloc_slots(num_slots);
+  pi->count = 0;
+
+  for (size_t pos = 0; pos < n; pos++) {
+    const char* name = _product_index_name(pi, pos);
+    uint32_t hash = _product_index_hash(name);
+    if (_product_index_find_slot(pi, name, hash) != PRODUCT_INDEX_NONE) {
+      product_index_free(pi);
+      return NULL;
+    }
+    _product_index_place(pi, pos, hash);
+    pi->count++;
+  }
+  return pi;
+
+}
+
+
+void product_index_free(struct product_index* pi) {
+
+  assert(pi);
+  free(pi->slots);
+  free(pi);
+
+}
+
+
+size_t product_index_count(struct product_index* pi) {
+
+  assert(pi);
+  return pi->count;
+
+}
+
+
+size_t product_index_lookup(struct product_index* pi, const char* name) {
+
+  assert(pi && name);
+  size_t i = _product_index_find_slot(pi, name, _product_index_hash(name));
+  return i == PRODUCT_INDEX_NONE ? PRODUCT_INDEX_NONE : pi->slots[i].pos;
+
+}
+
+
+struct product* product_index_find(struct product_index* pi,
+    const char* name) {
+
+  size_t pos = product_index_lookup(pi, name);
+  if (pos == PRODUCT_INDEX_NONE) {
+    return NULL;
+  }
+  return dynarray_get_unchecked(pi->products, pos);
+
+}
+
+
+int product_index_insert(struct product_index* pi, struct product* product) {
+
+  assert(pi && product);
+
+  uint32_t hash = _product_index_hash(product->name);
+  if (_product_index_find_slot(pi, product->name, hash) !=
+      PRODUCT_INDEX_NONE) {
+    return -1;
+  }
+  if (8 * (pi->count + 1) > 7 * pi->num_slots) {
+    _product_index_grow(pi);
+  }
+  dynarray_insert(pi->products, DYNARRAY_END, product);
+  _product_index_place(pi, dynarray_length(pi->products) - 1, hash);
+  pi->count++;
+  return 0;
+
+}
+
+
+int product_index_remove(struct product_index* pi, const char* name) {
+
+  assert(pi && name);
+
+  size_t mask = pi->num_slots - 1;
+  size_t i = _product_index_find_slot(pi, name, _product_index_hash(name));
+  if (i == PRODUCT_INDEX_NONE) {
+    return -1;
+  }
+  size_t pos = pi->slots[i].pos;
+
+  /*
+   * Shift the entries after the removed one back a slot, until reaching one
+   * that's already in its home slot, so that no probe sequence is broken by
+   * the gap.
+   */
+  size_t next = (i + 1) & mask;
+  while (pi->slots[next].pos != PRODUCT_INDEX_NONE &&
+      _product_index_distance(pi, next) > 0) {
+    pi->slots[i] = pi->slots[next];
+    i = next;
+    next = (next + 1) & mask;
+  }
+  pi->slots[i].pos = PRODUCT_INDEX_NONE;
+  pi->count--;
+
+  /*
+   * Fill the removed product's place in the array with the last product,
+   * then point the last product's entry at its new position.
+   */
+  size_t last = dynarray_length(pi->products) - 1;
+  if (pos != last) {
+    uint32_t hash = _product_index_hash(_product_index_name(pi, last));
+    size_t j = hash & mask;
+    while (pi->slots[j].pos != last) {
+      j = (j + 1) & mask;
+    }
+    pi->slots[j].pos = pos;
+    dynarray_set(pi->products, pos, dynarray_get(pi->products, last));
+  }
+  dynarray_remove(pi->products, DYNARRAY_END);
+  return 0;
+
+}
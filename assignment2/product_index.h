@@ -0,0 +1,131 @@
+/*
+ * This file contains the definition of an interface for a hash index that
+ * finds products in a dynamic array by name.
+ */
+
+#ifndef __PRODUCT_INDEX_H
+#define __PRODUCT_INDEX_H
+
+#include <stddef.h>
+
+#include "dynarray.h"
+
+/*
+ * Value returned by product_index_lookup() when no product has the given
+ * name.
+ */
+#define PRODUCT_INDEX_NONE ((size_t)-1)
+
+struct product;
+
+/*
+ * Structure used to represent a hash index over a product array.  The index
+ * maps each product's name to the product's position in the array, so a
+ * product can be found by name in constant expected time instead of by
+ * scanning the array.  Names must be unique.
+ *
+ * The index is an open-addressing hash table using Robin Hood hashing: an
+ * entry being inserted takes the slot of any entry it finds that sits closer
+ * to its own home slot, so every entry ends up about as far from home as
+ * every other one, and a lookup can stop as soon as it passes the distance
+ * its name would have been stored at.  Each slot caches its name's hash, so
+ * almost every mismatch is rejected without touching the product.
+ *
+ * The index doesn't own the array or the products in it.  It only stays in
+ * sync with the array as long as products are added and removed through
+ * product_index_insert() and product_index_remove(), and names aren't
+ * changed.  After any other change to the array, the index must be rebuilt.
+ */
+struct product_index;
+
+/*
+ * Builds an index over the products in an array.
+ *
+ * Params:
+ *   products - the array of products to be indexed.  May be an array of
+ *     pointers or of records.  May not be NULL.
+ *
+ * Return:
+ *   Returns a pointer to the new index, which should be freed with
+ *   product_index_free(), or NULL if two products in the array have the same
+ *   name.
+ */
+struct product_index* product_index_build(struct dynarray* products);
+
+/*
+ * Frees an index.  The indexed array and its products are left alone.
+ *
+ * Params:
+ *   pi - the index to be freed.  May not be NULL.
+ */
+void product_index_free(struct product_index* pi);
+
+/*
+ * Returns the number of products in an index.
+ *
+ * Params:
+ *   pi - the index whose products are to be counted.  May not be NULL.
+ */
+size_t product_index_count(struct product_index* pi);
+
+/*
+ * Finds the position of a product in the indexed array by name.
+ *
+ * Params:
+ *   pi - the index in which to look the name up.  May not be NULL.
+ *   name - the name of the product to be found.  May not be NULL.
+ *
+ * Return:
+ *   Returns the index in the array of the product with the given name, or
+ *   PRODUCT_INDEX_NONE if there is no such product.
+ */
+size_t product_index_lookup(struct product_index* pi, const char* name);
+
+/*
+ * Finds a product in the indexed array by name.  This works like
+ * product_index_lookup(), but returns the product itself, the same way
+ * dynarray_get() would.
+ *
+ * Params:
+ *   pi - the index in which to look the name up.  May not be NULL.
+ *   name - the name of the product to be found.  May not be NULL.
+ *
+ * Return:
+ *   Returns the product with the given name, or NULL if there is no such
+ *   product.  For record arrays this points into the array, and is only valid
+ *   until the array is next modified.
+ */
+struct product* product_index_find(struct product_index* pi, const char* name);
+
+/*
+ * Appends a product to the end of the indexed array and adds it to the index.
+ *
+ * Params:
+ *   pi - the index to which to add the product.  May not be NULL.
+ *   product - the product to be added.  For pointer arrays the pointer itself
+ *     is stored in the array, and for record arrays the record is copied into
+ *     it.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success, or -1 if a product with the same name is already in
+ *   the index, in which case nothing is changed.
+ */
+int product_index_insert(struct product_index* pi, struct product* product);
+
+/*
+ * Removes the product with a given name from the indexed array and from the
+ * index.  To avoid shifting the rest of the array, the last product in the
+ * array is moved into the removed product's place, and its entry in the index
+ * is updated to match.  The removed product isn't freed, so if it needs to be,
+ * it should be found with product_index_find() before it's removed.
+ *
+ * Params:
+ *   pi - the index from which to remove the product.  May not be NULL.
+ *   name - the name of the product to be removed.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success, or -1 if there is no product with the given name.
+ */
+int product_index_remove(struct product_index* pi, const char* name);
+
+#endif
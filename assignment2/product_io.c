@@ -0,0 +1,834 @@
+/*
+ * This file contains the definitions of the functions declared in
+ * product_io.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "product_io.h"
+#include "products.h"
+
+/*
+ * When the number of threads is chosen automatically, no thread is given
+ * less than this many bytes of the file to parse.
+ */
+#define TSV_MIN_CHUNK_BYTES (1 << 20)
+
+/*
+ * Numeric fields longer than this are rejected as malformed.
+ */
+#define TSV_MAX_NUMBER_CHARS 63
+
+/*
+ * Rows are formatted into a buffer of this many bytes, which is written out
+ * whenever it fills up.  A row's inventory and price take at most
+ * TSV_MAX_NUMBERS_CHARS bytes, tabs and newline included.
+ */
+#define TSV_WRITE_BUFFER_SIZE (1 << 16)
+#define TSV_MAX_NUMBERS_CHARS 128
+
+/*
+ * Prices smaller than this in magnitude are formatted by hand.  Larger ones,
+ * which need more digits than fit in a uint64_t, go through snprintf().
+ */
+#define TSV_MAX_FAST_PRICE 1e12
+
+#define SNAPSHOT_MAGIC "PRODSNAP"
+#define SNAPSHOT_VERSION 1
+
+/*
+ * This structure represents one parsed line of a TSV file.  The name first
+ * points into the mapped file, where it isn't NUL-terminated, and is then
+ * replaced with the copy interned by the thread that parsed it.
+ */
+struct tsv_line {
+  const char* name;
+  size_t name_len;
+  int inventory;
+  float price;
+};
+
+/*
+ * This structure holds one thread's share of a TSV load.  The thread parses
+ * the lines starting in [begin, end) into lines, a record array of struct
+ * tsv_line, interning their names in names_arena, and sets failed if any of
+ * them is malformed.  Once every chunk's arena has been merged, the thread
+ * copies its lines into products, first pointing their names at the merged
+ * arena's copies if canonicalize is set.
+ */
+struct tsv_chunk {
+  const char* begin;
+  const char* end;
+  struct dynarray* lines;
+  struct string_arena* names_arena;
+  struct product* products;
+  int canonicalize;
+  int failed;
+};
+
+/*
+ * This structure holds the state of a TSV write.  Output goes to stream if
+ * it isn't NULL, or to the file descriptor fd otherwise.  failed is set once
+ * any write fails, after which nothing more is written.
+ */
+struct tsv_writer {
+  char* buf;
+  size_t used;
+  int fd;
+  FILE* stream;
+  int failed;
+};
+
+
+/*
+ * This structure is the header at the start of every snapshot file.  It's
+ * padded to 64 bytes so the records after it start on a cache line.  The
+ * records start right after the header, and the names section starts right
+ * after the records.  The checksum covers everything after the header.
+ */
+struct snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+  uint64_t names_offset;
+  uint64_t names_size;
+  uint64_t checksum;
+  char padding[16];
+};
+
+/*
+ * This structure is the fixed-width record stored in a snapshot file for each
+ * product.  name_offset is relative to the start of the names section.
+ */
+struct snapshot_record {
+  uint64_t name_offset;
+  int32_t inventory;
+  float price;
+};
+
+/*
+ * This is the definition of the product snapshot structure.  records and
+ * names point into the mapping of the whole file, which is size bytes long.
+ */
+struct product_snapshot {
+  char* data;
+  size_t size;
+  struct snapshot_record* records;
+  size_t count;
+  const char* names;
+  size_t names_size;
+};
+
+
+/*
+ * Auxilliary function to copy the numeric field [begin, end) into buf and
+ * NUL-terminate it, so it can be handed to strtol() or strtof() without
+ * letting them read past the end of the field.  Returns 0 on success or -1
+ * if the field is empty, too long to be a number, or starts with whitespace,
+ * which strtol() and strtof() would otherwise skip.
+ */
+int _tsv_copy_number(const char* begin, const char* end, char* buf) {
+
+  size_t len = (size_t)(end - begin);
+  if (len == 0 || len > TSV_MAX_NUMBER_CHARS ||
+      isspace((unsigned char)*begin)) {
+    return -1;
+  }
+  memcpy(buf, begin, len);
+  buf[len] = '\0';
+  return 0;
+
+}
+
+
+/*
+ * Auxilliary function to parse the line [begin, end), which doesn't include
+ * its newline, into line.  Returns 0 on success or -1 if the line is
+ * malformed, meaning it doesn't have three fields, or either number has
+ * anything after it or is out of range.  A price too large for a float is
+ * rejected, but one too small rounds towards 0 as strtof() rounds it.
+ */
+int _tsv_parse_line(const char* begin, const char* end,
+    struct tsv_line* line) {
+
+  char buf[TSV_MAX_NUMBER_CHARS + 1];
+  char* parsed;
+
+  const char* tab1 = memchr(begin, '\t', (size_t)(end - begin));
+  if (!tab1) {
+    return -1;
+  }
+  const char* tab2 = memchr(tab1 + 1, '\t', (size_t)(end - tab1 - 1));
+  if (!tab2) {
+    return -1;
+  }
+  line->name = begin;
+  line->name_len = (size_t)(tab1 - begin);
+
+  if (_tsv_copy_number(tab1 + 1, tab2, buf) != 0) {
+    return -1;
+  }
+  errno = 0;
+  long inventory = strtol(buf, &parsed, 10);
+  if (*parsed != '\0' || errno != 0 || inventory < INT_MIN ||
+      inventory > INT_MAX) {
+    return -1;
+  }
+  line->inventory = (int)inventory;
+
+  if (_tsv_copy_number(tab2 + 1, end, buf) != 0) {
+    return -1;
+  }
+  errno = 0;
+  line->price = strtof(buf, &parsed);
+  if (*parsed != '\0' || (errno == ERANGE && isinf(line->price))) {
+    return -1;
+  }
+
+  return 0;
+
+}
+
+
+/*
+ * Auxilliary function run by each thread taking part in a TSV load to parse
+ * its chunk, interning names in an arena of its own.
+ */
+void* _tsv_parse_chunk(void* arg) {
+
+  struct tsv_chunk* chunk = arg;
+  const char* cur = chunk->begin;
+  chunk->names_arena = string_arena_create();
+
+  while (cur < chunk->end) {
+    const char* nl = memchr(cur, '\n', (size_t)(chunk->end - cur));
+    const char* line_end = nl ? nl : chunk->end;
+    const char* next = nl ? nl + 1 : chunk->end;
+    if (line_end > cur && line_end[-1] == '\r') {
+      line_end--;
+    }
+
+    if (line_end > cur) {
+      struct tsv_line line;
+      if (_tsv_parse_line(cur, line_end, &line) != 0) {
+        chunk->failed = 1;
+        return NULL;
+      }
+      line.name = string_arena_intern_n(chunk->names_arena, line.name,
+        line.name_len);
+      dynarray_insert(chunk->lines, DYNARRAY_END, &line);
+    }
+    cur = next;
+  }
+  return NULL;
+
+}
+
+
+/*
+ * Auxilliary function run by each thread taking part in a TSV load to copy
+ * its lines into their final places in the product array, once every
+ * thread's arena has been merged into the caller's.
+ */
+void* _tsv_fill_chunk(void* arg) {
+
+  struct tsv_chunk* chunk = arg;
+  size_t n = dynarray_length(chunk->lines);
+  struct tsv_line* lines = dynarray_data(chunk->lines);
+  for (size_t i = 0; i < n; i++) {
+    struct product* p = &chunk->products[i];
+    p->name = (char*)(chunk->canonicalize ?
+      string_arena_find(chunk->names_arena, lines[i].name) : lines[i].name);
+    p->inventory = lines[i].inventory;
+    p->price = lines[i].price;
+  }
+  return NULL;
+
+}
+
+
+/*
+ * Auxilliary function to run fn on every chunk of a TSV load, with the
+ * calling thread taking the first chunk.
+ */
+void _tsv_run_chunks(struct tsv_chunk* chunks, pthread_t* threads,
+    int num_threads, void* (*fn)(void*)) {
+
+  for (int t = 1; t < num_threads; t++) {
+    int err = pthread_create(&threads[t], NULL, fn, &chunks[t]);
+    assert(err == 0);
+  }
+  fn(&chunks[0]);
+  for (int t = 1; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to return where the first line starting at or after
+ * pos begins, i.e. just past the first newline at or after pos - 1.
+ */
+const char* _tsv_line_start(const char* data, const char* end,
+    const char* pos) {
+
+  if (pos == data) {
+    return pos;
+  }
+  const char* nl = memchr(pos - 1, '\n', (size_t)(end - (pos - 1)));
+  return nl ? nl + 1 : end;
+
+}
+
+
+struct dynarray* load_product_array_tsv(const char* path,
+    struct string_arena* names_arena, int num_threads) {
+
+  assert(path && names_arena && num_threads >= 0);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  if (size == 0) {
+    close(fd);
+    return dynarray_create_sized(sizeof(struct product));
+  }
+
+  char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+  const char* end = data + size;
+
+  if (num_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+    if ((size_t)num_threads > size / TSV_MIN_CHUNK_BYTES) {
+      num_threads = (int)(size / TSV_MIN_CHUNK_BYTES);
+    }
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  if ((size_t)num_threads > size) {
+    num_threads = (int)size;
+  }
+
+  /*
+   * Split the file into roughly equal chunks, then move each boundary
+   * forward to the start of a line so every line belongs to exactly one
+   * chunk.  Some chunks may end up empty.
+   */
+  struct tsv_chunk* chunks = malloc(num_threads * sizeof(struct tsv_chunk));
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  assert(chunks && threads);
+  for (int t = 0; t < num_threads; t++) {
+    chunks[t].begin = _tsv_line_start(data, end, data + size / num_threads *
+      t + size % num_threads * t / num_threads);
+    chunks[t].lines = dynarray_create_sized(sizeof(struct tsv_line));
+    chunks[t].names_arena = NULL;
+    chunks[t].canonicalize = 0;
+    chunks[t].failed = 0;
+  }
+  for (int t = 0; t < num_threads; t++) {
+    chunks[t].end = t + 1 < num_threads ? chunks[t + 1].begin : end;
+  }
+
+  _tsv_run_chunks(chunks, threads, num_threads, _tsv_parse_chunk);
+
+  size_t total = 0;
+  int failed = 0;
+  for (int t = 0; t < num_threads; t++) {
+    total += dynarray_length(chunks[t].lines);
+    failed |= chunks[t].failed;
+  }
+
+  /*
+   * Merge the threads' arenas into names_arena without copying any names,
+   * then have each thread copy its lines into its range of the array.  Only
+   * if a name was interned by more than one arena, or was already in
+   * names_arena, do the threads need to look up names_arena's copy of it.
+   */
+  struct dynarray* products = NULL;
+  if (!failed) {
+    products = dynarray_create_sized(sizeof(struct product));
+    dynarray_insert_range(products, DYNARRAY_END, NULL, total);
+    struct product* out = dynarray_data(products);
+    size_t duplicates = 0;
+    for (int t = 0; t < num_threads; t++) {
+      duplicates += string_arena_merge(names_arena, chunks[t].names_arena);
+      chunks[t].names_arena = names_arena;
+      chunks[t].products = out;
+      out += dynarray_length(chunks[t].lines);
+    }
+    for (int t = 0; t < num_threads; t++) {
+      chunks[t].canonicalize = duplicates > 0;
+    }
+    _tsv_run_chunks(chunks, threads, num_threads, _tsv_fill_chunk);
+  } else {
+    for (int t = 0; t < num_threads; t++) {
+      string_arena_free(chunks[t].names_arena);
+    }
+  }
+
+  for (int t = 0; t < num_threads; t++) {
+    dynarray_free(chunks[t].lines);
+  }
+  free(threads);
+  free(chunks);
+  munmap(data, size);
+  return products;
+
+}
+
+
+/*
+ * Auxilliary function to write len bytes straight to a TSV writer's output,
+ * bypassing its buffer.  Writes to a file descriptor are retried until
+ * everything is written, since write() may write only part of its buffer.
+ */
+void _tsv_writer_emit(struct tsv_writer* w, const char* data, size_t len) {
+
+  if (w->failed) {
+    return;
+  }
+  if (w->stream) {
+    if (fwrite(data, 1, len, w->stream) != len) {
+      w->failed = 1;
+    }
+    return;
+  }
+  while (len > 0) {
+    ssize_t written = write(w->fd, data, len);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      w->failed = 1;
+      return;
+    }
+    data += written;
+    len -= (size_t)written;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to write out everything in a TSV writer's buffer.
+ */
+void _tsv_writer_flush(struct tsv_writer* w) {
+
+  _tsv_writer_emit(w, w->buf, w->used);
+  w->used = 0;
+
+}
+
+
+/*
+ * Auxilliary function to add len bytes to a TSV writer's buffer, flushing it
+ * first if they don't fit.  Strings bigger than the whole buffer are written
+ * out directly.
+ */
+void _tsv_writer_append(struct tsv_writer* w, const char* data, size_t len) {
+
+  if (len > TSV_WRITE_BUFFER_SIZE - w->used) {
+    _tsv_writer_flush(w);
+    if (len > TSV_WRITE_BUFFER_SIZE) {
+      _tsv_writer_emit(w, data, len);
+      return;
+    }
+  }
+  memcpy(w->buf + w->used, data, len);
+  w->used += len;
+
+}
+
+
+/*
+ * Auxilliary function to write the decimal digits of value to out, most
+ * significant first, and return the end of the digits.
+ */
+char* _tsv_format_digits(char* out, uint64_t value) {
+
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    *out++ = digits[--n];
+  }
+  return out;
+
+}
+
+
+/*
+ * Auxilliary function to format an inventory the way printf("%d") does and
+ * return the end of the formatted number.
+ */
+char* _tsv_format_int(char* out, int value) {
+
+  uint32_t magnitude = (uint32_t)value;
+  if (value < 0) {
+    *out++ = '-';
+    magnitude = 0u - magnitude;
+  }
+  return _tsv_format_digits(out, magnitude);
+
+}
+
+
+/*
+ * Auxilliary function to format a price the way printf("%f") does and return
+ * the end of the formatted number.  room is the number of bytes available at
+ * out.
+ *
+ * A float has a 24-bit significand and 1e6 is 2^6 * 15625, so the price
+ * times 1e6 needs at most 38 significant bits and is computed exactly in a
+ * double.  Rounding it to an integer, with ties going to the even integer,
+ * therefore gives exactly the millionths printf() prints.
+ */
+char* _tsv_format_price(char* out, float price, size_t room) {
+
+  double x = price;
+  if (!(x > -TSV_MAX_FAST_PRICE && x < TSV_MAX_FAST_PRICE)) {
+    return out + snprintf(out, room, "%f", x);
+  }
+
+  double scaled = x * 1e6;
+  if (signbit(x)) {
+    *out++ = '-';
+    scaled = -scaled;
+  }
+  uint64_t units = (uint64_t)scaled;
+  double frac = scaled - (double)units;
+  if (frac > 0.5 || (frac == 0.5 && (units & 1))) {
+    units++;
+  }
+
+  out = _tsv_format_digits(out, units / 1000000);
+  *out++ = '.';
+  uint32_t millionths = (uint32_t)(units % 1000000);
+  for (int i = 5; i >= 0; i--) {
+    out[i] = (char)('0' + millionths % 10);
+    millionths /= 10;
+  }
+  return out + 6;
+
+}
+
+
+/*
+ * Auxilliary function to write the products in an array in TSV format to a
+ * stream or, if stream is NULL, to a file descriptor.
+ */
+int _write_products_tsv(struct dynarray* products, int fd, FILE* stream) {
+
+  struct tsv_writer w;
+  w.buf = malloc(TSV_WRITE_BUFFER_SIZE);
+  assert(w.buf);
+  w.used = 0;
+  w.fd = fd;
+  w.stream = stream;
+  w.failed = 0;
+
+  size_t n = dynarray_length(products);
+  for (size_t i = 0; i < n && !w.failed; i++) {
+    struct product* p = dynarray_get(products, i);
+    _tsv_writer_append(&w, p->name, strlen(p->name));
+    if (TSV_WRITE_BUFFER_SIZE - w.used < TSV_MAX_NUMBERS_CHARS) {
+      _tsv_writer_flush(&w);
+    }
+    char* out = w.buf + w.used;
+    char* end = w.buf + TSV_WRITE_BUFFER_SIZE;
+    *out++ = '\t';
+    out = _tsv_format_int(out, p->inventory);
+    *out++ = '\t';
+    out = _tsv_format_price(out, p->price, (size_t)(end - out) - 1);
+    *out++ = '\n';
+    w.used = (size_t)(out - w.buf);
+  }
+  _tsv_writer_flush(&w);
+
+  free(w.buf);
+  return w.failed ? -1 : 0;
+
+}
+
+
+int write_products_tsv(struct dynarray* products, FILE* stream) {
+
+  assert(products && stream);
+  return _write_products_tsv(products, -1, stream);
+
+}
+
+
+int write_products_tsv_fd(struct dynarray* products, int fd) {
+
+  assert(products && fd >= 0);
+  return _write_products_tsv(products, fd, NULL);
+
+}
+
+
+/*
+ * Auxilliary function to compute the checksum stored in snapshot headers.
+ * This consumes 8 bytes at a time, mixing each word in with a multiply and a
+ * shift, which is fast enough to check a snapshot at close to memory speed.
+ */
+uint64_t _snapshot_checksum(const char* data, size_t size) {
+
+  uint64_t hash = size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+  }
+  return hash;
+
+}
+
+
+int save_products_binary(struct dynarray* products, const char* path) {
+
+  assert(products && path);
+
+  size_t count = dynarray_length(products);
+  size_t names_size = 0;
+  for (size_t i = 0; i < count; i++) {
+    struct product* p = dynarray_get(products, i);
+    names_size += strlen(p->name) + 1;
+  }
+
+  struct snapshot_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.record_size = sizeof(struct snapshot_record);
+  header.count = count;
+  header.names_offset = sizeof(header) +
+    count * sizeof(struct snapshot_record);
+  header.names_size = names_size;
+  size_t size = header.names_offset + names_size;
+
+  /*
+   * The snapshot is written to a temporary file next to the target and only
+   * renamed over it once it's complete and on disk, so a reader that has the
+   * old snapshot mapped keeps seeing it whole, and a failed or interrupted
+   * save leaves the old snapshot in place.  The temporary file's blocks are
+   * allocated up front, so a full disk is reported here rather than by a
+   * SIGBUS while the records are being written through the mapping.
+   */
+  size_t path_len = strlen(path);
+  char* tmp_path = malloc(path_len + sizeof(".tmp"));
+  assert(tmp_path);
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+  int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free(tmp_path);
+    return -1;
+  }
+  char* data = MAP_FAILED;
+  if (posix_fallocate(fd, 0, (off_t)size) == 0) {
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (data == MAP_FAILED) {
+    close(fd);
+    unlink(tmp_path);
+    free(tmp_path);
+    return -1;
+  }
+
+  struct snapshot_record* records =
+    (struct snapshot_record*)(data + sizeof(header));
+  char* names = data + header.names_offset;
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    struct product* p = dynarray_get(products, i);
+    size_t len = strlen(p->name) + 1;
+    records[i].name_offset = offset;
+    records[i].inventory = p->inventory;
+    records[i].price = p->price;
+    memcpy(names + offset, p->name, len);
+    offset += len;
+  }
+
+  header.checksum = _snapshot_checksum(data + sizeof(header),
+    size - sizeof(header));
+  memcpy(data, &header, sizeof(header));
+
+  int status = msync(data, size, MS_SYNC) == 0 ? 0 : -1;
+  munmap(data, size);
+  if (fsync(fd) != 0) {
+    status = -1;
+  }
+  if (close(fd) != 0) {
+    status = -1;
+  }
+  if (status == 0 && rename(tmp_path, path) != 0) {
+    status = -1;
+  }
+  if (status != 0) {
+    unlink(tmp_path);
+  }
+  free(tmp_path);
+  return status;
+
+}
+
+
+struct product_snapshot* load_products_binary(const char* path, int verify) {
+
+  assert(path);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct snapshot_header)) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+
+  /*
+   * Make sure the sections the header describes are laid out the way
+   * save_products_binary() writes them and fill the file exactly, and that
+   * the names section ends with a NUL, so no name can run off the end of it.
+   */
+  struct snapshot_header header;
+  memcpy(&header, data, sizeof(header));
+  size_t body_size = size - sizeof(header);
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SNAPSHOT_VERSION ||
+      header.record_size != sizeof(struct snapshot_record) ||
+      header.count > body_size / sizeof(struct snapshot_record) ||
+      header.names_offset != sizeof(header) +
+        header.count * sizeof(struct snapshot_record) ||
+      header.names_size != size - header.names_offset ||
+      (header.names_size > 0 && data[size - 1] != '\0') ||
+      (verify && header.checksum !=
+        _snapshot_checksum(data + sizeof(header), body_size))) {
+    munmap(data, size);
+    return NULL;
+  }
+
+  struct product_snapshot* ps = malloc(sizeof(struct product_snapshot));
+  assert(ps);
+  ps->data = data;
+  ps->size = size;
+  ps->records = (struct snapshot_record*)(data + sizeof(header));
+  ps->count = header.count;
+  ps->names = data + header.names_offset;
+  ps->names_size = header.names_size;
+  return ps;
+
+}
+
+
+void product_snapshot_close(struct product_snapshot* ps) {
+
+  assert(ps);
+  munmap(ps->data, ps->size);
+  free(ps);
+
+}
+
+
+size_t product_snapshot_length(struct product_snapshot* ps) {
+
+  assert(ps);
+  return ps->count;
+
+}
+
+
+const char* product_snapshot_name(struct product_snapshot* ps, size_t idx) {
+
+  assert(ps && idx < ps->count);
+  uint64_t offset = ps->records[idx].name_offset;
+  return offset < ps->names_size ? ps->names + offset : NULL;
+
+}
+
+
+int product_snapshot_inventory(struct product_snapshot* ps, size_t idx) {
+
+  assert(ps && idx < ps->count);
+  return ps->records[idx].inventory;
+
+}
+
+
+float product_snapshot_price(struct product_snapshot* ps, size_t idx) {
+
+  assert(ps && idx < ps->count);
+  return ps->records[idx].price;
+
+}
+
+
+struct dynarray* product_snapshot_array(struct product_snapshot* ps) {
+
+  assert(ps);
+
+  struct dynarray* products = dynarray_create_sized(sizeof(struct product));
+  dynarray_reserve(products, ps->count);
+  for (size_t i = 0; i < ps->count; i++) {
+    const char* name = product_snapshot_name(ps, i);
+    struct product p;
+    p.name = (char*)(name ? name : "");
+    p.inventory = ps->records[i].inventory;
+    p.price = ps->records[i].price;
+    dynarray_insert(products, DYNARRAY_END, &p);
+  }
+  return products;
+
+}
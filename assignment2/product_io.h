@@ -0,0 +1,172 @@
+/*
+ * This file contains the definition of an interface for loading and saving
+ * product catalogs.
+ */
+
+#ifndef __PRODUCT_IO_H
+#define __PRODUCT_IO_H
+
+#include <stdio.h>
+
+#include "dynarray.h"
+#include "string_arena.h"
+
+/*
+ * Loads a product array from a tab-separated file with one product per line,
+ * in the same name<TAB>inventory<TAB>price format print_products() writes.
+ * Empty lines are skipped, and a carriage return before a line's newline is
+ * ignored.  Names may not contain tabs or newlines.
+ *
+ * The file is mapped into memory instead of being read through a buffer, and
+ * split into one chunk per thread at line boundaries.  Each thread parses its
+ * chunk straight out of the mapping without allocating anything per line,
+ * interning names into an arena of its own.  Those arenas are then merged
+ * into the given one with string_arena_merge(), which copies no names, and
+ * the threads fill in their parts of the array.
+ *
+ * A line is malformed if it doesn't have three fields, if either number is
+ * empty, starts with whitespace or is followed by anything else, or if the
+ * inventory doesn't fit in an int or the price overflows a float.
+ *
+ * Params:
+ *   path - the path of the file to be loaded
+ *   names_arena - the string arena in which to intern the products' names.
+ *     May not be NULL.
+ *   num_threads - the maximum number of threads to parse with, including the
+ *     calling thread.  May be 0 to use one thread per online CPU, in which
+ *     case small files are parsed with fewer threads.
+ *
+ * Return:
+ *   Returns a pointer to a newly allocated dynamic array of product records,
+ *   in file order, like those made by create_product_array_interned().  It
+ *   should be freed with free_product_array_interned().  Returns NULL if the
+ *   file couldn't be opened or mapped, or if any line is malformed.
+ */
+struct dynarray* load_product_array_tsv(const char* path,
+  struct string_arena* names_arena, int num_threads);
+
+/*
+ * Writes the products in an array to a stream, one per line, in exactly the
+ * format print_products() uses, which is also the format
+ * load_product_array_tsv() reads.  Rows are formatted into a large buffer by
+ * hand instead of through printf(), and the buffer is handed to fwrite() only
+ * when it fills up, so each call to fwrite() carries many rows.  Prices too
+ * large or too unusual to format by hand fall back to snprintf().
+ *
+ * Params:
+ *   products - the array of products to be written.  May be an array of
+ *     pointers or of records.  May not be NULL.
+ *   stream - the stream to which the products are to be written.  It isn't
+ *     flushed.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success or -1 if a write failed.
+ */
+int write_products_tsv(struct dynarray* products, FILE* stream);
+
+/*
+ * Writes the products in an array to a file descriptor, like
+ * write_products_tsv() does to a stream, but with write() instead of stdio.
+ * Anything buffered in a stream open on the same file should be flushed
+ * first.
+ *
+ * Params:
+ *   products - the array of products to be written.  May not be NULL.
+ *   fd - the file descriptor to which the products are to be written
+ *
+ * Return:
+ *   Returns 0 on success or -1 if a write failed.
+ */
+int write_products_tsv_fd(struct dynarray* products, int fd);
+
+/*
+ * Structure used to represent a product snapshot file that has been mapped
+ * into memory by load_products_binary().
+ */
+struct product_snapshot;
+
+/*
+ * Saves the products in an array to a binary snapshot file, overwriting the
+ * file if it already exists.  The file starts with a versioned header, which
+ * is followed by one fixed-width record per product holding its inventory,
+ * its price and the offset of its name, and finally by a section holding all
+ * of the names, each with its terminating NUL.  The header holds a checksum
+ * of the records and names.  The records are written in the machine's native
+ * byte order, so snapshots should only be loaded on machines of the same
+ * kind.
+ *
+ * The snapshot is first written to a temporary file named after path with
+ * ".tmp" appended, which is flushed to disk and then renamed over path.  A
+ * failed or interrupted save therefore leaves any existing snapshot intact,
+ * and snapshots already loaded from path keep their contents.  Two saves to
+ * the same path shouldn't run at once.
+ *
+ * Params:
+ *   products - the array of products to be saved.  May be an array of
+ *     pointers or of records.  May not be NULL.
+ *   path - the path of the file to be written
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the file couldn't be written.
+ */
+int save_products_binary(struct dynarray* products, const char* path);
+
+/*
+ * Loads a snapshot file written by save_products_binary() by mapping it into
+ * memory.  Nothing is parsed or copied: the accessors below read products
+ * straight out of the mapping, so loading costs little more than the page
+ * faults taken as the products are used.  The header is always checked, but
+ * checking the checksum means reading the whole file, so it's optional.
+ *
+ * Params:
+ *   path - the path of the file to be loaded
+ *   verify - whether to check the file's checksum
+ *
+ * Return:
+ *   Returns a pointer to the mapped snapshot, which should be closed with
+ *   product_snapshot_close().  Returns NULL if the file couldn't be opened or
+ *   mapped, if its header is invalid or was written by a different version,
+ *   or if verify is set and the checksum doesn't match.
+ */
+struct product_snapshot* load_products_binary(const char* path, int verify);
+
+/*
+ * Unmaps a snapshot and frees the memory associated with it.  Any names
+ * returned from the snapshot, and any array made by product_snapshot_array(),
+ * become invalid.
+ *
+ * Params:
+ *   ps - the snapshot to be closed.  May not be NULL.
+ */
+void product_snapshot_close(struct product_snapshot* ps);
+
+/*
+ * Accessors for the number of products in a snapshot and for the fields of
+ * the product at index idx, which must be less than the number of products.
+ * The name returned by product_snapshot_name() points into the mapping and
+ * must not be modified.  It is NULL if the snapshot wasn't verified and the
+ * product's name offset is out of range.
+ */
+size_t product_snapshot_length(struct product_snapshot* ps);
+const char* product_snapshot_name(struct product_snapshot* ps, size_t idx);
+int product_snapshot_inventory(struct product_snapshot* ps, size_t idx);
+float product_snapshot_price(struct product_snapshot* ps, size_t idx);
+
+/*
+ * Builds a product array from a snapshot, so that it can be used with the
+ * functions in products.h.  The array holds product records, like those made
+ * by create_product_array_interned(), whose names point into the snapshot's
+ * mapping instead of being copied.  Products whose names are out of range
+ * get an empty name.
+ *
+ * Params:
+ *   ps - the snapshot whose products are to be copied.  May not be NULL.
+ *
+ * Return:
+ *   Returns a pointer to a newly allocated dynamic array of product records,
+ *   which should be freed with free_product_array_interned() before the
+ *   snapshot is closed.
+ */
+struct dynarray* product_snapshot_array(struct product_snapshot* ps);
+
+#endif
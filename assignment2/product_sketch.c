@@ -0,0 +1,519 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the quantile sketches and histograms declared in product_sketch.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "product_sketch.h"
+#include "products.h"
+#include "dynarray_sort.h"
+
+/*
+ * No level of a quantile sketch is given room for fewer than this many
+ * values, however far below the top it is.
+ */
+#define QUANTILE_SKETCH_MIN_CAPACITY 8
+
+/*
+ * Levels holding at most this many values are sorted by insertion sort, since
+ * most compactions are of small levels near the bottom of a sketch, and a
+ * radix sort's fixed costs outweigh its gains on them.
+ */
+#define QUANTILE_SKETCH_INSERTION_SORT_MAX 64
+
+/*
+ * This is the definition of the quantile sketch structure.  levels is an
+ * array of pointers to record arrays of floats, where levels[h] holds the
+ * values that each stand in for 2^h of the values added.  size is the number
+ * of values held across all the levels, and capacity is the total room the
+ * levels are allowed, which changes whenever a level is added.  rng is the
+ * state of the generator choosing which values compactions keep.
+ */
+struct quantile_sketch {
+  size_t k;
+  struct dynarray* levels;
+  size_t size;
+  size_t capacity;
+  uint64_t count;
+  float min;
+  float max;
+  uint64_t rng;
+};
+
+/*
+ * This structure represents a value sampled by a quantile sketch along with
+ * the number of values it stands in for, and is used to answer queries.
+ */
+struct quantile_sketch_sample {
+  float value;
+  uint64_t weight;
+};
+
+/*
+ * This is the definition of the histogram structure.  counts holds the
+ * count of each bucket.
+ */
+struct histogram {
+  double lo;
+  double hi;
+  size_t num_buckets;
+  uint64_t* counts;
+  uint64_t underflow;
+  uint64_t overflow;
+  uint64_t count;
+};
+
+
+/*
+ * Auxilliary function to map a float to a 32-bit key that sorts in the same
+ * order as the float, so that quantile sketches can sort their values with
+ * dynarray_radix_sort().
+ */
+uint32_t _quantile_sketch_float_key(float value) {
+
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+
+}
+
+
+/*
+ * Key functions used to sort a level's values and a query's samples.
+ */
+uint32_t _quantile_sketch_value_key(void* elem) {
+
+  return _quantile_sketch_float_key(*(float*)elem);
+
+}
+
+
+uint32_t _quantile_sketch_sample_key(void* elem) {
+
+  return _quantile_sketch_float_key(
+    ((struct quantile_sketch_sample*)elem)->value);
+
+}
+
+
+/*
+ * Auxilliary function to return the next 64 random bits from a sketch's
+ * xorshift generator.
+ */
+uint64_t _quantile_sketch_random(struct quantile_sketch* qs) {
+
+  qs->rng ^= qs->rng << 13;
+  qs->rng ^= qs->rng >> 7;
+  qs->rng ^= qs->rng << 17;
+  return qs->rng;
+
+}
+
+
+/*
+ * Auxilliary function to return the number of levels in a sketch and the
+ * array holding level h.
+ */
+size_t _quantile_sketch_num_levels(struct quantile_sketch* qs) {
+
+  return dynarray_length(qs->levels);
+
+}
+
+
+struct dynarray* _quantile_sketch_level(struct quantile_sketch* qs, size_t h) {
+
+  return dynarray_get_unchecked(qs->levels, h);
+
+}
+
+
+/*
+ * Auxilliary function to return how many values level h of a sketch has room
+ * for.  The top level has room for k values, and each level below it for 2/3
+ * as many as the one above.
+ */
+size_t _quantile_sketch_level_capacity(struct quantile_sketch* qs, size_t h) {
+
+  size_t capacity = qs->k;
+  for (size_t d = h + 1; d < _quantile_sketch_num_levels(qs); d++) {
+    capacity = capacity * 2 / 3;
+  }
+  return capacity > QUANTILE_SKETCH_MIN_CAPACITY ? capacity :
+    QUANTILE_SKETCH_MIN_CAPACITY;
+
+}
+
+
+/*
+ * Auxilliary function to add an empty level to the top of a sketch.
+ */
+void _quantile_sketch_add_level(struct quantile_sketch* qs) {
+
+  dynarray_insert(qs->levels, DYNARRAY_END,
+    dynarray_create_sized(sizeof(float)));
+  qs->capacity = 0;
+  for (size_t h = 0; h < _quantile_sketch_num_levels(qs); h++) {
+    qs->capacity += _quantile_sketch_level_capacity(qs, h);
+  }
+
+}
+
+
+/*
+ * Auxilliary function to compact the lowest level of a sketch that's at or
+ * over its capacity.  The level is sorted, and either the values at even or
+ * at odd positions in it, chosen at random, are promoted to the level above,
+ * which replaces each pair of values with one that's worth twice as much.  If
+ * the level holds an odd number of values, its smallest or largest value,
+ * again chosen at random, stays behind.
+ */
+void _quantile_sketch_compact(struct quantile_sketch* qs) {
+
+  size_t h = 0;
+  while (dynarray_length(_quantile_sketch_level(qs, h)) <
+      _quantile_sketch_level_capacity(qs, h)) {
+    h++;
+  }
+  if (h + 1 == _quantile_sketch_num_levels(qs)) {
+    _quantile_sketch_add_level(qs);
+  }
+  struct dynarray* level = _quantile_sketch_level(qs, h);
+  struct dynarray* above = _quantile_sketch_level(qs, h + 1);
+
+  size_t n = dynarray_length(level);
+  float* values = dynarray_data(level);
+  if (n <= QUANTILE_SKETCH_INSERTION_SORT_MAX) {
+    for (size_t i = 1; i < n; i++) {
+      float value = values[i];
+      size_t j = i;
+      for (; j > 0 && values[j - 1] > value; j--) {
+        values[j] = values[j - 1];
+      }
+      values[j] = value;
+    }
+  } else {
+    dynarray_radix_sort(level, _quantile_sketch_value_key);
+    values = dynarray_data(level);
+  }
+  uint64_t bits = _quantile_sketch_random(qs);
+  size_t first = n % 2 && (bits & 2) ? 1 : 0;
+  float leftover = first ? values[0] : values[n - 1];
+  size_t half = n / 2;
+  size_t offset = first + (bits & 1);
+  for (size_t i = 0; i < half; i++) {
+    values[i] = values[offset + 2 * i];
+  }
+  dynarray_append_array(above, values, half);
+  values[n - 1] = leftover;
+  dynarray_remove_range(level, 0, n - n % 2);
+  qs->size -= half;
+
+}
+
+
+/*
+ * Auxilliary function to compact a sketch until it's under its capacity.
+ */
+void _quantile_sketch_settle(struct quantile_sketch* qs) {
+
+  while (qs->size >= qs->capacity) {
+    _quantile_sketch_compact(qs);
+  }
+
+}
+
+
+struct quantile_sketch* quantile_sketch_create(size_t k) {
+
+  assert(k >= QUANTILE_SKETCH_MIN_CAPACITY);
+  struct quantile_sketch* qs = malloc(sizeof(struct quantile_sketch));
+  assert(qs);
+  qs->k = k;
+  qs->levels = dynarray_create();
+  qs->size = 0;
+  qs->count = 0;
+  qs->min = NAN;
+  qs->max = NAN;
+  qs->rng = 0x9e3779b97f4a7c15ULL;
+  _quantile_sketch_add_level(qs);
+  return qs;
+
+}
+
+
+void quantile_sketch_free(struct quantile_sketch* qs) {
+
+  assert(qs);
+  for (size_t h = 0; h < _quantile_sketch_num_levels(qs); h++) {
+    dynarray_free(_quantile_sketch_level(qs, h));
+  }
+  dynarray_free(qs->levels);
+  free(qs);
+
+}
+
+
+void quantile_sketch_add(struct quantile_sketch* qs, float value) {
+
+  assert(qs);
+  if (isnan(value)) {
+    return;
+  }
+  if (qs->count == 0 || value < qs->min) {
+    qs->min = value;
+  }
+  if (qs->count == 0 || value > qs->max) {
+    qs->max = value;
+  }
+  dynarray_insert(_quantile_sketch_level(qs, 0), DYNARRAY_END, &value);
+  qs->size++;
+  qs->count++;
+  _quantile_sketch_settle(qs);
+
+}
+
+
+void quantile_sketch_add_prices(struct quantile_sketch* qs,
+    struct dynarray* products) {
+
+  assert(qs && products);
+  size_t length = dynarray_length(products);
+  for (size_t i = 0; i < length; i++) {
+    struct product* p = dynarray_get_unchecked(products, i);
+    quantile_sketch_add(qs, p->price);
+  }
+
+}
+
+
+void quantile_sketch_merge(struct quantile_sketch* qs,
+    struct quantile_sketch* other) {
+
+  assert(qs && other && qs != other && qs->k == other->k);
+  if (other->count == 0) {
+    return;
+  }
+  while (_quantile_sketch_num_levels(qs) < _quantile_sketch_num_levels(other)) {
+    _quantile_sketch_add_level(qs);
+  }
+  for (size_t h = 0; h < _quantile_sketch_num_levels(other); h++) {
+    struct dynarray* from = _quantile_sketch_level(other, h);
+    dynarray_append_array(_quantile_sketch_level(qs, h), dynarray_data(from),
+      dynarray_length(from));
+  }
+  qs->size += other->size;
+  if (qs->count == 0 || other->min < qs->min) {
+    qs->min = other->min;
+  }
+  if (qs->count == 0 || other->max > qs->max) {
+    qs->max = other->max;
+  }
+  qs->count += other->count;
+  _quantile_sketch_settle(qs);
+
+}
+
+
+uint64_t quantile_sketch_count(struct quantile_sketch* qs) {
+
+  assert(qs);
+  return qs->count;
+
+}
+
+
+float quantile_sketch_quantile(struct quantile_sketch* qs, double q) {
+
+  assert(qs && q >= 0.0 && q <= 1.0);
+  if (qs->count == 0) {
+    return NAN;
+  }
+  if (q == 0.0) {
+    return qs->min;
+  }
+  if (q == 1.0) {
+    return qs->max;
+  }
+
+  /*
+   * Sort every sampled value along with its weight, then walk them in order
+   * until they account for a fraction q of all the values added.
+   */
+  struct dynarray* samples =
+    dynarray_create_sized(sizeof(struct quantile_sketch_sample));
+  dynarray_reserve(samples, qs->size);
+  for (size_t h = 0; h < _quantile_sketch_num_levels(qs); h++) {
+    struct dynarray* level = _quantile_sketch_level(qs, h);
+    float* values = dynarray_data(level);
+    struct quantile_sketch_sample sample;
+    sample.weight = (uint64_t)1 << h;
+    for (size_t i = 0; i < dynarray_length(level); i++) {
+      sample.value = values[i];
+      dynarray_insert(samples, DYNARRAY_END, &sample);
+    }
+  }
+  dynarray_radix_sort(samples, _quantile_sketch_sample_key);
+
+  struct quantile_sketch_sample* sorted = dynarray_data(samples);
+  double target = q * qs->count;
+  uint64_t seen = 0;
+  float result = qs->max;
+  for (size_t i = 0; i < qs->size; i++) {
+    seen += sorted[i].weight;
+    if (seen >= target) {
+      result = sorted[i].value;
+      break;
+    }
+  }
+  dynarray_free(samples);
+  return result;
+
+}
+
+
+/*
+ * Auxilliary function to return the counter a histogram keeps for a value,
+ * or NULL if the value is NaN.
+ */
+uint64_t* _histogram_counter(struct histogram* h, double value) {
+
+  if (isnan(value)) {
+    return NULL;
+  }
+  if (value < h->lo) {
+    return &h->underflow;
+  }
+  if (value >= h->hi) {
+    return &h->overflow;
+  }
+  size_t idx = (size_t)((value - h->lo) / (h->hi - h->lo) * h->num_buckets);
+  return &h->counts[idx < h->num_buckets ? idx : h->num_buckets - 1];
+
+}
+
+
+struct histogram* histogram_create(double lo, double hi, size_t num_buckets) {
+
+  assert(lo < hi && num_buckets > 0);
+  struct histogram* h = malloc(sizeof(struct histogram));
+  assert(h);
+  h->lo = lo;
+  h->hi = hi;
+  h->num_buckets = num_buckets;
+  h->counts = calloc(num_buckets, sizeof(uint64_t));
+  assert(h->counts);
+  h->underflow = 0;
+  h->overflow = 0;
+  h->count = 0;
+  return h;
+
+}
+
+
+void histogram_free(struct histogram* h) {
+
+  assert(h);
+  free(h->counts);
+  free(h);
+
+}
+
+
+void histogram_add(struct histogram* h, double value) {
+
+  assert(h);
+  uint64_t* counter = _histogram_counter(h, value);
+  if (counter) {
+    (*counter)++;
+    h->count++;
+  }
+
+}
+
+
+void histogram_remove(struct histogram* h, double value) {
+
+  assert(h);
+  uint64_t* counter = _histogram_counter(h, value);
+  if (counter) {
+    assert(*counter > 0);
+    (*counter)--;
+    h->count--;
+  }
+
+}
+
+
+void histogram_add_inventories(struct histogram* h, struct dynarray* products) {
+
+  assert(h && products);
+  size_t length = dynarray_length(products);
+  for (size_t i = 0; i < length; i++) {
+    struct product* p = dynarray_get_unchecked(products, i);
+    histogram_add(h, p->inventory);
+  }
+
+}
+
+
+void histogram_add_prices(struct histogram* h, struct dynarray* products) {
+
+  assert(h && products);
+  size_t length = dynarray_length(products);
+  for (size_t i = 0; i < length; i++) {
+    struct product* p = dynarray_get_unchecked(products, i);
+    histogram_add(h, p->price);
+  }
+
+}
+
+
+void histogram_merge(struct histogram* h, struct histogram* other) {
+
+  assert(h && other && h->lo == other->lo && h->hi == other->hi &&
+    h->num_buckets == other->num_buckets);
+  for (size_t i = 0; i < h->num_buckets; i++) {
+    h->counts[i] += other->counts[i];
+  }
+  h->underflow += other->underflow;
+  h->overflow += other->overflow;
+  h->count += other->count;
+
+}
+
+
+uint64_t histogram_bucket(struct histogram* h, size_t idx) {
+
+  assert(h && idx < h->num_buckets);
+  return h->counts[idx];
+
+}
+
+
+uint64_t histogram_underflow(struct histogram* h) {
+
+  assert(h);
+  return h->underflow;
+
+}
+
+
+uint64_t histogram_overflow(struct histogram* h) {
+
+  assert(h);
+  return h->overflow;
+
+}
+
+
+uint64_t histogram_count(struct histogram* h) {
+
+  assert(h);
+  return h->count;
+
+}
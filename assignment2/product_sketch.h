@@ -0,0 +1,194 @@
+/*
+ * This file contains the definition of an interface for quantile sketches and
+ * histograms that summarize the prices and inventories of products in one
+ * pass, without sorting them.
+ */
+
+#ifndef __PRODUCT_SKETCH_H
+#define __PRODUCT_SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dynarray.h"
+
+/*
+ * The accuracy parameter quantile_sketch_create() is usually given.  With it,
+ * a quantile's rank is typically off by well under 1% of the number of values
+ * added.
+ */
+#define QUANTILE_SKETCH_DEFAULT_K 200
+
+/*
+ * Structure used to represent a KLL quantile sketch, which estimates the
+ * quantiles of a stream of values, such as the median or 99th percentile of
+ * products' prices, while keeping only a small sample of them.
+ *
+ * The sample is kept in a stack of levels.  Every value is added to level 0,
+ * and each value in level h stands in for 2^h of the values added.  When the
+ * sample outgrows its capacity, the lowest full level is sorted and every
+ * other value in it, starting from a randomly chosen one, is promoted to the
+ * next level up, while the rest are discarded.  Lower levels are given less
+ * room than higher ones, so the sketch holds O(k) values no matter how many
+ * are added, while the rank of any value it reports is off by roughly O(1/k)
+ * of the number added.
+ *
+ * Sketches built separately, say over the shards of a catalog or by several
+ * threads, can be merged into one that's about as accurate as if all their
+ * values had been added to it directly.  Values can't be removed.
+ */
+struct quantile_sketch;
+
+/*
+ * Structure used to represent a histogram, which counts how many values fall
+ * into each of a number of equal-width buckets covering a fixed range.  Unlike
+ * a quantile sketch, a histogram's counts are exact, values can be removed as
+ * well as added, and merging two histograms just adds their counts, but the
+ * range and number of buckets must be chosen up front.
+ */
+struct histogram;
+
+/*
+ * Creates a new, empty quantile sketch and returns a pointer to it.
+ *
+ * Params:
+ *   k - the sketch's accuracy parameter.  Larger values of k make the sketch
+ *     more accurate but bigger and slower.  Must be at least 8.
+ */
+struct quantile_sketch* quantile_sketch_create(size_t k);
+
+/*
+ * Frees a quantile sketch.
+ *
+ * Params:
+ *   qs - the sketch to be freed.  May not be NULL.
+ */
+void quantile_sketch_free(struct quantile_sketch* qs);
+
+/*
+ * Adds a value to a quantile sketch.  NaN values are ignored.
+ *
+ * Params:
+ *   qs - the sketch to which to add the value.  May not be NULL.
+ *   value - the value to be added
+ */
+void quantile_sketch_add(struct quantile_sketch* qs, float value);
+
+/*
+ * Adds the prices of all the products in an array to a quantile sketch.
+ *
+ * Params:
+ *   qs - the sketch to which to add the prices.  May not be NULL.
+ *   products - the products whose prices are to be added.  May be an array of
+ *     pointers or of records.  May not be NULL.
+ */
+void quantile_sketch_add_prices(struct quantile_sketch* qs,
+  struct dynarray* products);
+
+/*
+ * Merges one quantile sketch into another, so that it summarizes the values
+ * added to either of them.
+ *
+ * Params:
+ *   qs - the sketch into which to merge.  May not be NULL.
+ *   other - the sketch to be merged into qs, which is left unchanged.  Must
+ *     have been created with the same k as qs.  May not be NULL, and may not
+ *     be qs.
+ */
+void quantile_sketch_merge(struct quantile_sketch* qs,
+  struct quantile_sketch* other);
+
+/*
+ * Returns the number of values that have been added to a quantile sketch,
+ * including those added to sketches merged into it.
+ *
+ * Params:
+ *   qs - the sketch whose values are to be counted.  May not be NULL.
+ */
+uint64_t quantile_sketch_count(struct quantile_sketch* qs);
+
+/*
+ * Estimates a quantile of the values added to a quantile sketch.  This sorts
+ * the sketch's sample, so it takes O(k log k) time rather than depending on
+ * the number of values added.
+ *
+ * Params:
+ *   qs - the sketch to be queried.  May not be NULL.
+ *   q - the quantile to be estimated, between 0 and 1, so that 0.5 asks for
+ *     the median and 0.99 for the 99th percentile.  0 and 1 return the exact
+ *     minimum and maximum.
+ *
+ * Return:
+ *   Returns a value added to the sketch whose rank among all the values added
+ *   is close to q, or NaN if the sketch is empty.
+ */
+float quantile_sketch_quantile(struct quantile_sketch* qs, double q);
+
+/*
+ * Creates a new histogram with all its counts set to 0 and returns a pointer
+ * to it.
+ *
+ * Params:
+ *   lo, hi - the range covered by the histogram's buckets.  Bucket i counts
+ *     values in [lo + i * w, lo + (i + 1) * w), where w is
+ *     (hi - lo) / num_buckets.  hi must be greater than lo.
+ *   num_buckets - the number of buckets.  Must be at least 1.
+ */
+struct histogram* histogram_create(double lo, double hi, size_t num_buckets);
+
+/*
+ * Frees a histogram.
+ *
+ * Params:
+ *   h - the histogram to be freed.  May not be NULL.
+ */
+void histogram_free(struct histogram* h);
+
+/*
+ * Adds a value to a histogram, or removes one that was added before.  Values
+ * below the histogram's range are counted as underflow, and values at or
+ * above the end of its range as overflow.  NaN values are ignored.
+ *
+ * Params:
+ *   h - the histogram to be updated.  May not be NULL.
+ *   value - the value to be added or removed
+ */
+void histogram_add(struct histogram* h, double value);
+void histogram_remove(struct histogram* h, double value);
+
+/*
+ * Adds the inventories or prices of all the products in an array to a
+ * histogram.
+ *
+ * Params:
+ *   h - the histogram to which to add the values.  May not be NULL.
+ *   products - the products whose values are to be added.  May be an array of
+ *     pointers or of records.  May not be NULL.
+ */
+void histogram_add_inventories(struct histogram* h, struct dynarray* products);
+void histogram_add_prices(struct histogram* h, struct dynarray* products);
+
+/*
+ * Merges one histogram into another by adding its counts to the other's.
+ *
+ * Params:
+ *   h - the histogram into which to merge.  May not be NULL.
+ *   other - the histogram to be merged into h, which is left unchanged.  Must
+ *     have the same range and number of buckets as h.  May not be NULL.
+ */
+void histogram_merge(struct histogram* h, struct histogram* other);
+
+/*
+ * Return the number of values a histogram holds in a given bucket, below its
+ * range, above its range, or altogether.
+ *
+ * Params:
+ *   h - the histogram to be queried.  May not be NULL.
+ *   idx - the index of the bucket.  Must be less than the number of buckets.
+ */
+uint64_t histogram_bucket(struct histogram* h, size_t idx);
+uint64_t histogram_underflow(struct histogram* h);
+uint64_t histogram_overflow(struct histogram* h);
+uint64_t histogram_count(struct histogram* h);
+
+#endif
@@ -7,15 +7,82 @@
  * Email: benjamal@oregonstate.edu
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "products.h"
+#include "product_io.h"
 #include "dynarray.h"
+#include "dynarray_sort.h"
+
+/*
+ * The parallel top-k queries give each thread at least this many products,
+ * since smaller scans finish faster than a thread can be started.
+ */
+#define TOP_K_PARALLEL_CUTOFF 65536
+
+/*
+ * This structure represents a product kept in a top-k heap along with its
+ * score and its index in the array, which breaks ties between equal scores.
+ */
+struct top_k_entry {
+  float score;
+  size_t index;
+  struct product* product;
+};
+
+/*
+ * This structure holds one thread's share of a parallel top-k query.  The
+ * thread scans products [begin, end) into heap, which has room for capacity
+ * entries, and leaves the number of entries it holds in size.
+ */
+struct top_k_task {
+  struct dynarray* products;
+  size_t begin;
+  size_t end;
+  float (*score)(struct product*);
+  struct top_k_entry* heap;
+  size_t capacity;
+  size_t size;
+};
+
+/*
+ * create_product_array_parallel() gives each thread at least this many
+ * products, since smaller arrays are built faster than a thread can be
+ * started.
+ */
+#define PRODUCT_ARRAY_PARALLEL_CUTOFF 16384
 
-void quicksort(struct dynarray*, int, int);
-int partition(struct dynarray*, int, int);
+/*
+ * This structure holds one thread's share of create_product_array_parallel().
+ * The thread builds products [begin, end) of the array directly in their
+ * final places in products, interning their names in names_arena.
+ */
+struct product_array_task {
+  struct product* products;
+  char** names;
+  int* inventories;
+  float* prices;
+  size_t begin;
+  size_t end;
+  struct string_arena* names_arena;
+};
+
+int compare_inventory(void*, void*);
+uint32_t inventory_key(void*);
+void inventory_price_name_key(void*, uint64_t[2]);
+int compare_name(void*, void*);
+float price_score(struct product*);
+float investment_score(struct product*);
 
 /*
  * This function should allocate and initialize a single product struct with
@@ -88,12 +155,192 @@ void free_product(struct product* product) {
  *   the i'th name, the i'th ID, and the i'th GPA from the arrays provided as
  *   arguments.
  */
-struct dynarray* create_product_array(int num_products, char** names, int* inventory, float* prices) {
+struct dynarray* create_product_array(size_t num_products, char** names, int* inventory, float* prices) {
   struct dynarray* arr = dynarray_create();
-  for (int i = 0; i < num_products; ++i) {
+  dynarray_reserve(arr, num_products);
+  for (size_t i = 0; i < num_products; ++i) {
     struct product* p = create_product(names[i], inventory[i], prices[i]);
-    dynarray_insert(arr, -1, p);
+    dynarray_insert(arr, DYNARRAY_END, p);
+  }
+  return arr;
+}
+
+
+/*
+ * This function works like create_product_array(), except that the product
+ * structs are stored inline in the dynamic array itself (see
+ * dynarray_create_sized()) instead of each being allocated separately.  This
+ * saves one allocation per product and lets scans over the array read product
+ * fields directly out of contiguous memory.  Values returned by dynarray_get()
+ * on the resulting array are still struct product*, but they point into the
+ * array and are only valid until the array is next modified.
+ *
+ * Params:
+ *   num_products, names, inventory, prices - see create_product_array()
+ *
+ * Return:
+ *   Returns a pointer to a newly allocated dynamic array of product records,
+ *   which should be freed with free_product_array().
+ */
+struct dynarray* create_product_array_inline(size_t num_products, char** names, int* inventory, float* prices) {
+  struct dynarray* arr = dynarray_create_sized(sizeof(struct product));
+  dynarray_reserve(arr, num_products);
+  for (size_t i = 0; i < num_products; ++i) {
+    struct product p;
+    p.name = malloc(strlen(names[i]) + 1);
+    strcpy(p.name, names[i]);
+    p.inventory = inventory[i];
+    p.price = prices[i];
+    dynarray_insert(arr, DYNARRAY_END, &p);
+  }
+  return arr;
+}
+
+
+/*
+ * This function works like create_product_array_inline(), except that the
+ * products' names are interned in a string arena instead of each being
+ * allocated separately.  Products with the same name share a single copy of
+ * it, and freeing the array never touches the names one at a time.  The names
+ * belong to the arena, so they must not be modified, and they stay valid
+ * until the arena is freed.  Several arrays can share one arena.
+ *
+ * Params:
+ *   num_products, names, inventory, prices - see create_product_array()
+ *   names_arena - the string arena in which to intern the names
+ *
+ * Return:
+ *   Returns a pointer to a newly allocated dynamic array of product records,
+ *   which should be freed with free_product_array_interned().
+ */
+struct dynarray* create_product_array_interned(size_t num_products, char** names, int* inventory, float* prices, struct string_arena* names_arena) {
+  struct dynarray* arr = dynarray_create_sized(sizeof(struct product));
+  dynarray_reserve(arr, num_products);
+  for (size_t i = 0; i < num_products; ++i) {
+    struct product p;
+    p.name = (char*)string_arena_intern(names_arena, names[i]);
+    p.inventory = inventory[i];
+    p.price = prices[i];
+    dynarray_insert(arr, DYNARRAY_END, &p);
+  }
+  return arr;
+}
+
+
+/*
+ * Auxilliary function run by each thread taking part in
+ * create_product_array_parallel() to build its products, interning their
+ * names in an arena of its own.
+ */
+void* _product_array_thread(void* arg) {
+  struct product_array_task* task = arg;
+  task->names_arena = string_arena_create();
+  for (size_t i = task->begin; i < task->end; ++i) {
+    struct product* p = &task->products[i];
+    p->name = (char*)string_arena_intern(task->names_arena, task->names[i]);
+    p->inventory = task->inventories[i];
+    p->price = task->prices[i];
+  }
+  return NULL;
+}
+
+/*
+ * Auxilliary function run by each thread taking part in
+ * create_product_array_parallel() to point its products' names at the copies
+ * interned in the shared arena, once every thread's arena has been merged into
+ * it.
+ */
+void* _product_array_canonicalize_thread(void* arg) {
+  struct product_array_task* task = arg;
+  for (size_t i = task->begin; i < task->end; ++i) {
+    struct product* p = &task->products[i];
+    p->name = (char*)string_arena_find(task->names_arena, p->name);
+  }
+  return NULL;
+}
+
+
+/*
+ * This function works like create_product_array_interned(), but splits the
+ * products between several threads.  The array is sized for every product up
+ * front, and each thread builds its range of products directly in their final
+ * places, so the threads never need to lock anything.  String arenas aren't
+ * thread-safe, so each thread interns its names in a private arena, and the
+ * private arenas are then merged into names_arena without copying any names.
+ * Only if the same name was interned by more than one arena does a second
+ * parallel pass point products at names_arena's copy of it.
+ *
+ * Params:
+ *   num_products, names, inventory, prices, names_arena - see
+ *     create_product_array_interned()
+ *   num_threads - the maximum number of threads to use, including the calling
+ *     thread, or 0 to use one per online CPU.  Each thread is given at least
+ *     PRODUCT_ARRAY_PARALLEL_CUTOFF products, so small arrays are built on
+ *     the calling thread alone.
+ *
+ * Return:
+ *   Returns a pointer to a newly allocated dynamic array of product records,
+ *   which should be freed with free_product_array_interned().
+ */
+struct dynarray* create_product_array_parallel(size_t num_products, char** names, int* inventory, float* prices, struct string_arena* names_arena, int num_threads) {
+  assert(names_arena && num_threads >= 0);
+  if (num_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  if ((size_t)num_threads > num_products / PRODUCT_ARRAY_PARALLEL_CUTOFF) {
+    num_threads = (int)(num_products / PRODUCT_ARRAY_PARALLEL_CUTOFF);
+  }
+  if (num_threads <= 1) {
+    return create_product_array_interned(num_products, names, inventory,
+      prices, names_arena);
+  }
+
+  struct dynarray* arr = dynarray_create_sized(sizeof(struct product));
+  dynarray_insert_range(arr, DYNARRAY_END, NULL, num_products);
+  struct product_array_task* tasks =
+    malloc(num_threads * sizeof(struct product_array_task));
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  assert(tasks && threads);
+  size_t n = num_products;
+  for (int t = 0; t < num_threads; t++) {
+    tasks[t].products = dynarray_data(arr);
+    tasks[t].names = names;
+    tasks[t].inventories = inventory;
+    tasks[t].prices = prices;
+    tasks[t].begin = n / num_threads * t + n % num_threads * t / num_threads;
+    tasks[t].end = n / num_threads * (t + 1) +
+      n % num_threads * (t + 1) / num_threads;
   }
+  for (int t = 1; t < num_threads; t++) {
+    int err = pthread_create(&threads[t], NULL, _product_array_thread,
+      &tasks[t]);
+    assert(err == 0);
+  }
+  _product_array_thread(&tasks[0]);
+  for (int t = 1; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  size_t duplicates = 0;
+  for (int t = 0; t < num_threads; t++) {
+    duplicates += string_arena_merge(names_arena, tasks[t].names_arena);
+    tasks[t].names_arena = names_arena;
+  }
+  if (duplicates > 0) {
+    for (int t = 1; t < num_threads; t++) {
+      int err = pthread_create(&threads[t], NULL,
+        _product_array_canonicalize_thread, &tasks[t]);
+      assert(err == 0);
+    }
+    _product_array_canonicalize_thread(&tasks[0]);
+    for (int t = 1; t < num_threads; t++) {
+      pthread_join(threads[t], NULL);
+    }
+  }
+
+  free(threads);
+  free(tasks);
   return arr;
 }
 
@@ -108,18 +355,42 @@ struct dynarray* create_product_array(int num_products, char** names, int* inven
  * memory associated with a dynamic array of products and must not result in
  * any memory leaks.
  *
+ * Arrays made by create_product_array_inline() hold their product structs
+ * inline, so for those only each product's name is freed individually.
+ *
  * Params:
  *   products - a pointer to the dynamic array of product structs whose memory
  *     is to be freed
  */
 void free_product_array(struct dynarray* products) {
-  for (int i = 0; i < dynarray_length(products); ++i) {
-    free_product(dynarray_get(products, i));
+  int inline_products = dynarray_elem_size(products) != 0;
+  for (size_t i = 0; i < dynarray_length(products); ++i) {
+    struct product* p = dynarray_get(products, i);
+    if (inline_products) {
+      free(p->name); // the struct itself lives in the array
+    } else {
+      free_product(p);
+    }
   }
   dynarray_free(products);
 }
 
 
+/*
+ * This function frees a dynamic array made by create_product_array_interned().
+ * The products and their names live in the array and the string arena, so
+ * this takes time proportional to the array's storage rather than its number
+ * of products.  The string arena is left alone, since other arrays may still
+ * be using its names.
+ *
+ * Params:
+ *   products - a pointer to the dynamic array of product records to be freed
+ */
+void free_product_array_interned(struct dynarray* products) {
+  dynarray_free(products);
+}
+
+
 /*
  * This function should print the name, inventory, and price of products in an
  * array, one product per line.  You must use provided dynamic array functions
@@ -129,9 +400,12 @@ void free_product_array(struct dynarray* products) {
  *   products - the dynamic array of products to be printed
  */
 void print_products(struct dynarray* products) {
-  for (int i = 0; i < dynarray_length(products); ++i) {
-    printf("%s\t%d\t%f\n", ((struct product*)dynarray_get(products, i))->name, ((struct product*)dynarray_get(products, i))->inventory, ((struct product*)dynarray_get(products, i))->price);
-  }
+  /*
+   * write_products_tsv() formats rows into a large buffer without printf()
+   * and writes them through stdout itself, so this output stays in order with
+   * anything else printed to stdout.
+   */
+  write_products_tsv(products, stdout);
 }
 
 
@@ -158,8 +432,9 @@ struct product* find_max_price(struct dynarray* products) {
   }
   struct product* current = dynarray_get(products, 0);
   struct product* max = current;
-  for (int i = 1; i < dynarray_length(products); ++i) {
-    current = dynarray_get(products, i);
+  size_t length = dynarray_length(products);
+  for (size_t i = 1; i < length; ++i) {
+    current = dynarray_get_unchecked(products, i);
     if (current->price > max->price) {
       max = current;
     }
@@ -195,8 +470,9 @@ struct product* find_max_investment(struct dynarray* products) {
   }
   struct product* current = dynarray_get(products, 0);
   struct product* max = current;
-  for (int i = 1; i < dynarray_length(products); ++i) {
-    current = dynarray_get(products, i);
+  size_t length = dynarray_length(products);
+  for (size_t i = 1; i < length; ++i) {
+    current = dynarray_get_unchecked(products, i);
     if (current->inventory * current->price > max->inventory * max->price) {
       max = current;
     }
@@ -205,6 +481,259 @@ struct product* find_max_investment(struct dynarray* products) {
 }
 
 
+/*
+ * Auxilliary function to return whether a top-k entry ranks above another,
+ * i.e. whether it has the higher score or, for equal scores, comes earlier in
+ * the array.
+ */
+int _top_k_better(struct top_k_entry* a, struct top_k_entry* b) {
+  return a->score > b->score || (a->score == b->score && a->index < b->index);
+}
+
+/*
+ * Auxilliary function to restore the heap property below entry i of a top-k
+ * heap.  The heap keeps its lowest ranked entry at the root, so a new entry
+ * only has to beat the root to get in.
+ */
+void _top_k_sift_down(struct top_k_entry* heap, size_t size, size_t i) {
+  struct top_k_entry e = heap[i];
+  for (size_t child = 2 * i + 1; child < size; child = 2 * i + 1) {
+    if (child + 1 < size && _top_k_better(&heap[child], &heap[child + 1])) {
+      child++;
+    }
+    if (!_top_k_better(&e, &heap[child])) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = e;
+}
+
+/*
+ * Auxilliary function to offer an entry to a top-k heap holding *size of at
+ * most capacity entries.  The entry is added if the heap isn't full, replaces
+ * the root if it ranks above it, and is dropped otherwise.
+ */
+void _top_k_offer(struct top_k_entry* heap, size_t* size, size_t capacity,
+    struct top_k_entry* e) {
+  if (*size < capacity) {
+    size_t i = (*size)++;
+    while (i > 0 && _top_k_better(&heap[(i - 1) / 2], e)) {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    heap[i] = *e;
+  } else if (capacity > 0 && _top_k_better(e, &heap[0])) {
+    heap[0] = *e;
+    _top_k_sift_down(heap, *size, 0);
+  }
+}
+
+/*
+ * Auxilliary function to offer products [begin, end) of an array to a top-k
+ * heap.  NaN scores rank below every other score.
+ */
+void _top_k_scan(struct dynarray* products, size_t begin, size_t end,
+    float (*score)(struct product*), struct top_k_entry* heap, size_t* size,
+    size_t capacity) {
+  for (size_t i = begin; i < end; ++i) {
+    struct top_k_entry e;
+    e.product = dynarray_get_unchecked(products, i);
+    e.score = score(e.product);
+    if (isnan(e.score)) {
+      e.score = -INFINITY;
+    }
+    e.index = i;
+    _top_k_offer(heap, size, capacity, &e);
+  }
+}
+
+/*
+ * Auxilliary function to empty a top-k heap into out, highest ranked entry
+ * first, and return the number of entries written.
+ */
+size_t _top_k_finish(struct top_k_entry* heap, size_t size,
+    struct product** out) {
+  size_t count = size;
+  while (size > 0) {
+    out[--size] = heap[0].product;
+    heap[0] = heap[size];
+    _top_k_sift_down(heap, size, 0);
+  }
+  return count;
+}
+
+/*
+ * Auxilliary function run by each thread taking part in a parallel top-k
+ * query.
+ */
+void* _top_k_thread(void* arg) {
+  struct top_k_task* task = arg;
+  task->size = 0;
+  _top_k_scan(task->products, task->begin, task->end, task->score,
+    task->heap, &task->size, task->capacity);
+  return NULL;
+}
+
+/*
+ * Auxilliary function to find the k highest scoring products in an array on
+ * a single thread.
+ */
+size_t _find_top_k(struct dynarray* products, size_t k, struct product** out,
+    float (*score)(struct product*)) {
+  assert(products && (out || k == 0));
+  size_t n = dynarray_length(products);
+  size_t capacity = k < n ? k : n;
+  if (capacity == 0) {
+    return 0;
+  }
+  struct top_k_entry* heap = malloc(capacity * sizeof(struct top_k_entry));
+  assert(heap);
+  size_t size = 0;
+  _top_k_scan(products, 0, n, score, heap, &size, capacity);
+  size_t count = _top_k_finish(heap, size, out);
+  free(heap);
+  return count;
+}
+
+/*
+ * Auxilliary function to find the k highest scoring products in an array by
+ * splitting it between threads, each of which keeps its own heap of the k
+ * best products in its part of the array.  The calling thread then merges
+ * those heaps.  Since ties are broken by index, the result is the same as
+ * _find_top_k()'s.
+ */
+size_t _find_top_k_parallel(struct dynarray* products, size_t k,
+    struct product** out, int num_threads, float (*score)(struct product*)) {
+  assert(products && (out || k == 0) && num_threads >= 0);
+  size_t n = dynarray_length(products);
+  if (num_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  if ((size_t)num_threads > n / TOP_K_PARALLEL_CUTOFF) {
+    num_threads = (int)(n / TOP_K_PARALLEL_CUTOFF);
+  }
+  if (num_threads <= 1 || k == 0) {
+    return _find_top_k(products, k, out, score);
+  }
+
+  struct top_k_task* tasks = malloc(num_threads * sizeof(struct top_k_task));
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  assert(tasks && threads);
+  for (int t = 0; t < num_threads; t++) {
+    tasks[t].products = products;
+    tasks[t].begin = n / num_threads * t + n % num_threads * t / num_threads;
+    tasks[t].end = n / num_threads * (t + 1) +
+      n % num_threads * (t + 1) / num_threads;
+    tasks[t].score = score;
+    tasks[t].capacity = k < tasks[t].end - tasks[t].begin ? k :
+      tasks[t].end - tasks[t].begin;
+    tasks[t].heap = malloc(tasks[t].capacity * sizeof(struct top_k_entry));
+    assert(tasks[t].heap);
+  }
+  for (int t = 1; t < num_threads; t++) {
+    int err = pthread_create(&threads[t], NULL, _top_k_thread, &tasks[t]);
+    assert(err == 0);
+  }
+  _top_k_thread(&tasks[0]);
+  for (int t = 1; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  size_t capacity = k < n ? k : n;
+  struct top_k_entry* heap = malloc(capacity * sizeof(struct top_k_entry));
+  assert(heap);
+  size_t size = 0;
+  for (int t = 0; t < num_threads; t++) {
+    for (size_t i = 0; i < tasks[t].size; i++) {
+      _top_k_offer(heap, &size, capacity, &tasks[t].heap[i]);
+    }
+    free(tasks[t].heap);
+  }
+  size_t count = _top_k_finish(heap, size, out);
+  free(heap);
+  free(threads);
+  free(tasks);
+  return count;
+}
+
+
+/*
+ * This function finds the k products in an array with the highest prices,
+ * without sorting the array.  It keeps the best k products seen so far in a
+ * heap whose root is the worst of them, so each product costs at most one
+ * comparison plus O(log k) work, and the whole scan costs O(n log k).
+ *
+ * Params:
+ *   products - the array in which to find the products
+ *   k - the number of products to find
+ *   out - an array with room for k pointers, in which to store the products
+ *     found.  May be NULL if k is 0.
+ *
+ * Return:
+ *   Returns the number of products stored in out, which is the smaller of k
+ *   and the length of the array.  They're stored by descending price, with
+ *   products of equal price in the order they have in the array.  Like
+ *   find_max_price(), the pointers point to the products stored in the array.
+ *   Products whose price is NaN rank last, so the first product is the one
+ *   find_max_price() returns unless the array's first product has a NaN
+ *   price, in which case find_max_price() returns that product instead.
+ */
+size_t find_top_k_by_price(struct dynarray* products, size_t k,
+    struct product** out) {
+  return _find_top_k(products, k, out, price_score);
+}
+
+
+/*
+ * This function finds the k products in an array with the largest
+ * investments, like find_top_k_by_price() does for prices.  The first
+ * product found is the one find_max_investment() returns, unless the array's
+ * first product has a NaN investment.
+ *
+ * Params:
+ *   products, k, out - see find_top_k_by_price()
+ *
+ * Return:
+ *   Returns the number of products stored in out.
+ */
+size_t find_top_k_by_investment(struct dynarray* products, size_t k,
+    struct product** out) {
+  return _find_top_k(products, k, out, investment_score);
+}
+
+
+/*
+ * These functions work like find_top_k_by_price() and
+ * find_top_k_by_investment(), but split the array between several threads.
+ * Each thread finds the top k products in its part of the array, and the
+ * calling thread merges their results, so the products found are exactly
+ * the ones the single-threaded functions find.
+ *
+ * Params:
+ *   products, k, out - see find_top_k_by_price()
+ *   num_threads - the maximum number of threads to use, including the calling
+ *     thread, or 0 to use one per online CPU.  Each thread is given at least
+ *     TOP_K_PARALLEL_CUTOFF products, so small arrays are scanned on the
+ *     calling thread alone.
+ *
+ * Return:
+ *   Returns the number of products stored in out.
+ */
+size_t find_top_k_by_price_parallel(struct dynarray* products, size_t k,
+    struct product** out, int num_threads) {
+  return _find_top_k_parallel(products, k, out, num_threads, price_score);
+}
+
+size_t find_top_k_by_investment_parallel(struct dynarray* products, size_t k,
+    struct product** out, int num_threads) {
+  return _find_top_k_parallel(products, k, out, num_threads,
+    investment_score);
+}
+
+
 /*
  * This function should sort the products stored in a dynamic array by
  * ascending inventory (i.e. lowest inventory at the beginning of the array).
@@ -225,30 +754,133 @@ struct product* find_max_investment(struct dynarray* products) {
  *   highest).
  */
 void sort_by_inventory(struct dynarray* products) {
-  quicksort(products, 0, dynarray_length(products) - 1);
+  dynarray_sort(products, compare_inventory);
 }
 
-void quicksort(struct dynarray* products, int start, int end) {
-  if (start < end) {
-    int pi = partition(products, start, end);
-    quicksort(products, start, pi - 1);
-    quicksort(products, pi + 1, end);
+/*
+ * This function sorts the products stored in a dynamic array by ascending
+ * inventory, like sort_by_inventory(), but spreads the work across several
+ * threads.  This is meant for very large catalogs, where a single core would
+ * spend several seconds on the sort.
+ *
+ * Params:
+ *   products - the dynamic array of products to be sorted
+ *   num_threads - the maximum number of threads to use, or 0 to use one per
+ *     online CPU
+ *   cutoff - the minimum number of products to give each thread, or 0 to use
+ *     DYNARRAY_PARALLEL_SORT_CUTOFF.  Arrays too small to give two threads
+ *     this many products each are sorted on the calling thread.
+ */
+void sort_by_inventory_parallel(struct dynarray* products, int num_threads,
+    size_t cutoff) {
+  dynarray_parallel_sort(products, compare_inventory, num_threads, cutoff);
+}
+
+/*
+ * This function sorts the products stored in a dynamic array by ascending
+ * inventory using a chosen algorithm.  Radix sort makes a fixed number of
+ * passes over the inventories no matter how they're ordered, so it tends to
+ * beat quicksort on large catalogs, while quicksort wins on small ones and on
+ * input that's already nearly sorted.
+ *
+ * Params:
+ *   products - the dynamic array of products to be sorted
+ *   backend - the algorithm to sort with
+ */
+void sort_by_inventory_with(struct dynarray* products,
+    enum sort_backend backend) {
+  switch (backend) {
+    case SORT_BACKEND_RADIX:
+      dynarray_radix_sort(products, inventory_key);
+      break;
+    case SORT_BACKEND_PARALLEL:
+      dynarray_parallel_sort(products, compare_inventory, 0, 0);
+      break;
+    default:
+      dynarray_sort(products, compare_inventory);
+      break;
   }
 }
 
-int partition(struct dynarray* products, int start, int end) {
-  struct product* pivot = dynarray_get(products, end);
-  int i = start - 1;
-  for (int j = start; j < end; ++j) {
-    if (((struct product*)dynarray_get(products, j))->inventory < pivot->inventory) {
-      ++i;
-      struct product* tmp = dynarray_get(products, j);
-      dynarray_set(products, j, dynarray_get(products, i));
-      dynarray_set(products, i, tmp);
-    }
+/*
+ * This function sorts the products stored in a dynamic array by ascending
+ * inventory, then by descending price, and then by name, using a decorated
+ * sort: each product's inventory, price and the first 8 bytes of its name are
+ * packed once into a 128-bit key that orders correctly as an unsigned integer,
+ * and the sort then compares those keys instead of the products themselves.
+ * Names are only compared in full for products whose keys are equal.  Names
+ * are compared with strcmp(), and NaN prices come before all other prices.
+ *
+ * Params:
+ *   products - the dynamic array of products to be sorted
+ */
+void sort_by_inventory_price_name(struct dynarray* products) {
+  dynarray_keyed_sort(products, inventory_price_name_key, compare_name);
+}
+
+/*
+ * Comparison function used by sort_by_inventory() and
+ * sort_by_inventory_parallel() to order products by ascending inventory.
+ * Works for both pointer and record product arrays, since the dynarray sorts
+ * pass a struct product* either way.
+ */
+int compare_inventory(void* a, void* b) {
+  int ia = ((struct product*)a)->inventory;
+  int ib = ((struct product*)b)->inventory;
+  return (ia > ib) - (ia < ib);
+}
+
+/*
+ * Key extraction function used to radix sort products by inventory.  Flipping
+ * the sign bit makes negative inventories sort before positive ones when the
+ * keys are compared as unsigned integers.
+ */
+uint32_t inventory_key(void* p) {
+  return (uint32_t)((struct product*)p)->inventory ^ 0x80000000u;
+}
+
+/*
+ * Score functions used by the top-k queries to rank products by price and
+ * by investment.  Investment is computed the same way find_max_investment()
+ * computes it.
+ */
+float price_score(struct product* p) {
+  return p->price;
+}
+
+float investment_score(struct product* p) {
+  return p->inventory * p->price;
+}
+
+/*
+ * Key extraction function used by sort_by_inventory_price_name().  The high
+ * half of the key holds the inventory with its sign bit flipped, above the
+ * price mapped to an unsigned integer that orders like the float itself and
+ * then inverted, so higher prices sort first.  Zero and negative zero get the
+ * same key, and all NaNs get the key of a positive NaN.  The low half holds
+ * the first 8 bytes of the name, padded with NULs, with the first byte most
+ * significant, so it orders like strcmp() as far as it goes.
+ */
+void inventory_price_name_key(void* p, uint64_t key[2]) {
+  struct product* product = p;
+  float price = product->price == 0 ? 0 : product->price;
+  uint32_t bits;
+  if (isnan(price)) {
+    price = NAN;
   }
-  struct product* tmp = dynarray_get(products, i+1);
-  dynarray_set(products, i+1, dynarray_get(products, end));
-  dynarray_set(products, end, tmp);
-  return i + 1;
-}
\ No newline at end of file
+  memcpy(&bits, &price, sizeof(bits));
+  bits = bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+  key[0] = (uint64_t)((uint32_t)product->inventory ^ 0x80000000u) << 32 |
+    (uint32_t)~bits;
+  key[1] = 0;
+  for (int i = 0; i < 8 && product->name[i]; ++i) {
+    key[1] |= (uint64_t)(unsigned char)product->name[i] << (56 - 8 * i);
+  }
+}
+
+/*
+ * Comparison function used to order products by name.
+ */
+int compare_name(void* a, void* b) {
+  return strcmp(((struct product*)a)->name, ((struct product*)b)->name);
+}
@@ -5,6 +5,7 @@
  */
 
 #include "dynarray.h"
+#include "string_arena.h"
 
 /*
  * This structure represents information about a single product from the store.
@@ -16,6 +17,19 @@ struct product {
 };
 
 
+/*
+ * These are the algorithms sort_by_inventory_with() can use.
+ *   SORT_BACKEND_QUICKSORT - dynarray_sort(), used by sort_by_inventory()
+ *   SORT_BACKEND_RADIX - dynarray_radix_sort() on the inventory
+ *   SORT_BACKEND_PARALLEL - dynarray_parallel_sort() on all online CPUs
+ */
+enum sort_backend {
+  SORT_BACKEND_QUICKSORT,
+  SORT_BACKEND_RADIX,
+  SORT_BACKEND_PARALLEL
+};
+
+
 /*
  * These are the prototypes of the functions you will write in products.c.
  * See the documentation in products.c for more information about each
@@ -23,9 +37,20 @@ struct product {
  */
 struct product* create_product(char* name, int inventory, float price);
 void free_product(struct product* product);
-struct dynarray* create_product_array(int num_products, char** names, int* inventories, float* prices);
+struct dynarray* create_product_array(size_t num_products, char** names, int* inventories, float* prices);
+struct dynarray* create_product_array_inline(size_t num_products, char** names, int* inventories, float* prices);
+struct dynarray* create_product_array_interned(size_t num_products, char** names, int* inventories, float* prices, struct string_arena* names_arena);
+struct dynarray* create_product_array_parallel(size_t num_products, char** names, int* inventories, float* prices, struct string_arena* names_arena, int num_threads);
 void free_product_array(struct dynarray* products);
+void free_product_array_interned(struct dynarray* products);
 void print_products(struct dynarray* products);
 struct product* find_max_price(struct dynarray* products);
 struct product* find_max_investment(struct dynarray* products);
+size_t find_top_k_by_price(struct dynarray* products, size_t k, struct product** out);
+size_t find_top_k_by_investment(struct dynarray* products, size_t k, struct product** out);
+size_t find_top_k_by_price_parallel(struct dynarray* products, size_t k, struct product** out, int num_threads);
+size_t find_top_k_by_investment_parallel(struct dynarray* products, size_t k, struct product** out, int num_threads);
 void sort_by_inventory(struct dynarray* products);
+void sort_by_inventory_parallel(struct dynarray* products, int num_threads, size_t cutoff);
+void sort_by_inventory_with(struct dynarray* products, enum sort_backend backend);
+void sort_by_inventory_price_name(struct dynarray* products);
@@ -0,0 +1,860 @@
+/*
+ * This file contains the definitions of the functions declared in
+ * simd_kernels.h.  The SSE2 and AVX2 versions of each kernel are only built
+ * on x86-64, where SSE2 is always available.  The AVX2 versions are compiled
+ * for AVX2 with GCC's target attribute, so the rest of the program doesn't
+ * need to be, and they're only called once __builtin_cpu_supports() says the
+ * CPU can run them.  Other architectures get the scalar versions alone.
+ *
+ * Each argmax makes two passes: the first finds the largest value, and the
+ * second finds the first element equal to it.  Both passes vectorize cleanly,
+ * unlike a single pass that would have to track an index per lane, and the
+ * second pass usually stops well before the end.
+ *
+ * Each filter works through its bitmap a word at a time, comparing the 64
+ * elements behind each nonzero word and ANDing the results into it.  The
+ * partial word at the end, if any, is always handled by the scalar code.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+
+#include "simd_kernels.h"
+
+#if defined(__x86_64__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * This structure holds the versions of the building blocks of each kernel for
+ * one level, along with the level itself.  Each max function returns the
+ * largest non-NaN value, starting from the first value, which must not be
+ * NaN.  Each find function returns the index of the first value equal to v,
+ * which must be present.
+ */
+struct simd_kernels {
+  enum simd_level level;
+  float (*max_f32)(const float* x, size_t n);
+  size_t (*find_f32)(const float* x, size_t n, float v);
+  float (*max_mul)(const int32_t* a, const float* b, size_t n);
+  size_t (*find_mul)(const int32_t* a, const float* b, size_t n, float v);
+  double (*sum_mul)(const int32_t* a, const float* b, size_t n);
+  void (*filter_f32)(const float* x, size_t n, enum simd_cmp op, float v,
+    uint64_t* bits);
+  void (*filter_i32)(const int32_t* x, size_t n, enum simd_cmp op, int32_t v,
+    uint64_t* bits);
+};
+
+/*
+ * The kernels currently in use, or NULL if none have been picked yet.  This
+ * is only accessed with __atomic builtins, and the best level the CPU
+ * supports is picked once, under _simd_once.
+ */
+const struct simd_kernels* _simd_kernels = NULL;
+pthread_once_t _simd_once = PTHREAD_ONCE_INIT;
+
+
+/*****************************************************************************
+ *
+ * Scalar kernels
+ *
+ *****************************************************************************/
+
+float _simd_max_f32_scalar(const float* x, size_t n) {
+
+  float m = x[0];
+  for (size_t i = 1; i < n; i++) {
+    if (x[i] > m) {
+      m = x[i];
+    }
+  }
+  return m;
+
+}
+
+
+size_t _simd_find_f32_scalar(const float* x, size_t n, float v) {
+
+  for (size_t i = 0; i < n; i++) {
+    if (x[i] == v) {
+      return i;
+    }
+  }
+  return SIMD_NONE;
+
+}
+
+
+float _simd_max_mul_scalar(const int32_t* a, const float* b, size_t n) {
+
+  float m = a[0] * b[0];
+  for (size_t i = 1; i < n; i++) {
+    float p = a[i] * b[i];
+    if (p > m) {
+      m = p;
+    }
+  }
+  return m;
+
+}
+
+
+size_t _simd_find_mul_scalar(const int32_t* a, const float* b, size_t n,
+    float v) {
+
+  for (size_t i = 0; i < n; i++) {
+    float p = a[i] * b[i];
+    if (p == v) {
+      return i;
+    }
+  }
+  return SIMD_NONE;
+
+}
+
+
+double _simd_sum_mul_scalar(const int32_t* a, const float* b, size_t n) {
+
+  double sum = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)a[i] * b[i];
+  }
+  return sum;
+
+}
+
+
+/*
+ * Auxilliary function to compare n floats, where n is at most 64, with v and
+ * return a mask with bit i set if x[i] passes the comparison.
+ */
+uint64_t _simd_cmp_f32_scalar(const float* x, size_t n, enum simd_cmp op,
+    float v) {
+
+  uint64_t mask = 0;
+  for (size_t i = 0; i < n; i++) {
+    int pass;
+    switch (op) {
+      case SIMD_CMP_LT:
+        pass = x[i] < v;
+        break;
+      case SIMD_CMP_LE:
+        pass = x[i] <= v;
+        break;
+      case SIMD_CMP_GT:
+        pass = x[i] > v;
+        break;
+      case SIMD_CMP_GE:
+        pass = x[i] >= v;
+        break;
+      case SIMD_CMP_EQ:
+        pass = x[i] == v;
+        break;
+      default:
+        pass = x[i] != v;
+        break;
+    }
+    mask |= (uint64_t)pass << i;
+  }
+  return mask;
+
+}
+
+
+/*
+ * Auxilliary function to compare n integers, where n is at most 64, with v
+ * and return a mask with bit i set if x[i] passes the comparison.
+ */
+uint64_t _simd_cmp_i32_scalar(const int32_t* x, size_t n, enum simd_cmp op,
+    int32_t v) {
+
+  uint64_t mask = 0;
+  for (size_t i = 0; i < n; i++) {
+    int pass;
+    switch (op) {
+      case SIMD_CMP_LT:
+        pass = x[i] < v;
+        break;
+      case SIMD_CMP_LE:
+        pass = x[i] <= v;
+        break;
+      case SIMD_CMP_GT:
+        pass = x[i] > v;
+        break;
+      case SIMD_CMP_GE:
+        pass = x[i] >= v;
+        break;
+      case SIMD_CMP_EQ:
+        pass = x[i] == v;
+        break;
+      default:
+        pass = x[i] != v;
+        break;
+    }
+    mask |= (uint64_t)pass << i;
+  }
+  return mask;
+
+}
+
+
+void _simd_filter_f32_scalar(const float* x, size_t n, enum simd_cmp op,
+    float v, uint64_t* bits) {
+
+  for (size_t w = 0; w * 64 < n; w++) {
+    if (bits[w]) {
+      size_t count = n - w * 64 < 64 ? n - w * 64 : 64;
+      bits[w] &= _simd_cmp_f32_scalar(x + w * 64, count, op, v);
+    }
+  }
+
+}
+
+
+void _simd_filter_i32_scalar(const int32_t* x, size_t n, enum simd_cmp op,
+    int32_t v, uint64_t* bits) {
+
+  for (size_t w = 0; w * 64 < n; w++) {
+    if (bits[w]) {
+      size_t count = n - w * 64 < 64 ? n - w * 64 : 64;
+      bits[w] &= _simd_cmp_i32_scalar(x + w * 64, count, op, v);
+    }
+  }
+
+}
+
+
+const struct simd_kernels _simd_scalar_kernels = {
+  SIMD_SCALAR,
+  _simd_max_f32_scalar,
+  _simd_find_f32_scalar,
+  _simd_max_mul_scalar,
+  _simd_find_mul_scalar,
+  _simd_sum_mul_scalar,
+  _simd_filter_f32_scalar,
+  _simd_filter_i32_scalar
+};
+
+
+#ifdef SIMD_X86
+
+/*****************************************************************************
+ *
+ * SSE2 kernels
+ *
+ *****************************************************************************/
+
+/*
+ * Auxilliary function to return the largest of the four lanes of a vector.
+ */
+float _simd_hmax_sse2(__m128 v) {
+
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(v);
+
+}
+
+
+/*
+ * Auxilliary function to return the products of four integers and four
+ * floats, rounded exactly as the scalar products would be.
+ */
+__m128 _simd_mul_sse2(const int32_t* a, const float* b) {
+
+  __m128 fa = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)a));
+  return _mm_mul_ps(fa, _mm_loadu_ps(b));
+
+}
+
+
+/*
+ * The max loops below keep two accumulators so consecutive maxes don't wait
+ * on each other.  _mm_max_ps(x, m) returns m wherever x is NaN, which skips
+ * NaN values the same way the scalar comparisons do.
+ */
+float _simd_max_f32_sse2(const float* x, size_t n) {
+
+  __m128 m0 = _mm_set1_ps(x[0]);
+  __m128 m1 = m0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    m0 = _mm_max_ps(_mm_loadu_ps(x + i), m0);
+    m1 = _mm_max_ps(_mm_loadu_ps(x + i + 4), m1);
+  }
+  float m = _simd_hmax_sse2(_mm_max_ps(m0, m1));
+  for (; i < n; i++) {
+    if (x[i] > m) {
+      m = x[i];
+    }
+  }
+  return m;
+
+}
+
+
+size_t _simd_find_f32_sse2(const float* x, size_t n, float v) {
+
+  __m128 vv = _mm_set1_ps(v);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(x + i), vv));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  size_t tail = _simd_find_f32_scalar(x + i, n - i, v);
+  return tail == SIMD_NONE ? SIMD_NONE : i + tail;
+
+}
+
+
+float _simd_max_mul_sse2(const int32_t* a, const float* b, size_t n) {
+
+  __m128 m0 = _mm_set1_ps(a[0] * b[0]);
+  __m128 m1 = m0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    m0 = _mm_max_ps(_simd_mul_sse2(a + i, b + i), m0);
+    m1 = _mm_max_ps(_simd_mul_sse2(a + i + 4, b + i + 4), m1);
+  }
+  float m = _simd_hmax_sse2(_mm_max_ps(m0, m1));
+  for (; i < n; i++) {
+    float p = a[i] * b[i];
+    if (p > m) {
+      m = p;
+    }
+  }
+  return m;
+
+}
+
+
+size_t _simd_find_mul_sse2(const int32_t* a, const float* b, size_t n,
+    float v) {
+
+  __m128 vv = _mm_set1_ps(v);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 eq = _mm_cmpeq_ps(_simd_mul_sse2(a + i, b + i), vv);
+    int mask = _mm_movemask_ps(eq);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  size_t tail = _simd_find_mul_scalar(a + i, b + i, n - i, v);
+  return tail == SIMD_NONE ? SIMD_NONE : i + tail;
+
+}
+
+
+double _simd_sum_mul_sse2(const int32_t* a, const float* b, size_t n) {
+
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128 vb = _mm_loadu_ps(b + i);
+    __m128d a_lo = _mm_cvtepi32_pd(va);
+    __m128i va_hi = _mm_shuffle_epi32(va, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128d a_hi = _mm_cvtepi32_pd(va_hi);
+    __m128d b_lo = _mm_cvtps_pd(vb);
+    __m128d b_hi = _mm_cvtps_pd(_mm_movehl_ps(vb, vb));
+    s0 = _mm_add_pd(s0, _mm_mul_pd(a_lo, b_lo));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(a_hi, b_hi));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(s0, s1));
+  return lanes[0] + lanes[1] + _simd_sum_mul_scalar(a + i, b + i, n - i);
+
+}
+
+
+/*
+ * Auxilliary function to compare four floats with four copies of a constant.
+ * _mm_cmpneq_ps() is true for NaN lanes, and the other comparisons are false,
+ * just like the C operators.
+ */
+__m128 _simd_cmp_ps_sse2(__m128 x, __m128 v, enum simd_cmp op) {
+
+  switch (op) {
+    case SIMD_CMP_LT:
+      return _mm_cmplt_ps(x, v);
+    case SIMD_CMP_LE:
+      return _mm_cmple_ps(x, v);
+    case SIMD_CMP_GT:
+      return _mm_cmpgt_ps(x, v);
+    case SIMD_CMP_GE:
+      return _mm_cmpge_ps(x, v);
+    case SIMD_CMP_EQ:
+      return _mm_cmpeq_ps(x, v);
+    default:
+      return _mm_cmpneq_ps(x, v);
+  }
+
+}
+
+
+void _simd_filter_f32_sse2(const float* x, size_t n, enum simd_cmp op,
+    float v, uint64_t* bits) {
+
+  __m128 vv = _mm_set1_ps(v);
+  size_t w = 0;
+  for (; (w + 1) * 64 <= n; w++) {
+    if (bits[w]) {
+      const float* xw = x + w * 64;
+      uint64_t mask = 0;
+      for (int j = 0; j < 64; j += 4) {
+        __m128 c = _simd_cmp_ps_sse2(_mm_loadu_ps(xw + j), vv, op);
+        mask |= (uint64_t)_mm_movemask_ps(c) << j;
+      }
+      bits[w] &= mask;
+    }
+  }
+  if (w * 64 < n && bits[w]) {
+    bits[w] &= _simd_cmp_f32_scalar(x + w * 64, n - w * 64, op, v);
+  }
+
+}
+
+
+/*
+ * SSE2 can only compare integers with <, > and ==, so <=, >= and != are
+ * computed as the complements of >, < and ==.
+ */
+void _simd_filter_i32_sse2(const int32_t* x, size_t n, enum simd_cmp op,
+    int32_t v, uint64_t* bits) {
+
+  __m128i vv = _mm_set1_epi32(v);
+  int negate = op == SIMD_CMP_LE || op == SIMD_CMP_GE || op == SIMD_CMP_NE;
+  size_t w = 0;
+  for (; (w + 1) * 64 <= n; w++) {
+    if (bits[w]) {
+      const int32_t* xw = x + w * 64;
+      uint64_t mask = 0;
+      for (int j = 0; j < 64; j += 4) {
+        __m128i xi = _mm_loadu_si128((const __m128i*)(xw + j));
+        __m128i c;
+        if (op == SIMD_CMP_LT || op == SIMD_CMP_GE) {
+          c = _mm_cmplt_epi32(xi, vv);
+        } else if (op == SIMD_CMP_GT || op == SIMD_CMP_LE) {
+          c = _mm_cmpgt_epi32(xi, vv);
+        } else {
+          c = _mm_cmpeq_epi32(xi, vv);
+        }
+        mask |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(c)) << j;
+      }
+      bits[w] &= negate ? ~mask : mask;
+    }
+  }
+  if (w * 64 < n && bits[w]) {
+    bits[w] &= _simd_cmp_i32_scalar(x + w * 64, n - w * 64, op, v);
+  }
+
+}
+
+
+const struct simd_kernels _simd_sse2_kernels = {
+  SIMD_SSE2,
+  _simd_max_f32_sse2,
+  _simd_find_f32_sse2,
+  _simd_max_mul_sse2,
+  _simd_find_mul_sse2,
+  _simd_sum_mul_sse2,
+  _simd_filter_f32_sse2,
+  _simd_filter_i32_sse2
+};
+
+
+/*****************************************************************************
+ *
+ * AVX2 kernels
+ *
+ *****************************************************************************/
+
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+
+SIMD_TARGET_AVX2 float _simd_hmax_avx2(__m256 v) {
+
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v),
+    _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(m);
+
+}
+
+
+SIMD_TARGET_AVX2 __m256 _simd_mul_avx2(const int32_t* a, const float* b) {
+
+  __m256 fa = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)a));
+  return _mm256_mul_ps(fa, _mm256_loadu_ps(b));
+
+}
+
+
+SIMD_TARGET_AVX2 float _simd_max_f32_avx2(const float* x, size_t n) {
+
+  __m256 m0 = _mm256_set1_ps(x[0]);
+  __m256 m1 = m0;
+  __m256 m2 = m0;
+  __m256 m3 = m0;
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    m0 = _mm256_max_ps(_mm256_loadu_ps(x + i), m0);
+    m1 = _mm256_max_ps(_mm256_loadu_ps(x + i + 8), m1);
+    m2 = _mm256_max_ps(_mm256_loadu_ps(x + i + 16), m2);
+    m3 = _mm256_max_ps(_mm256_loadu_ps(x + i + 24), m3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    m0 = _mm256_max_ps(_mm256_loadu_ps(x + i), m0);
+  }
+  float m = _simd_hmax_avx2(_mm256_max_ps(_mm256_max_ps(m0, m1),
+    _mm256_max_ps(m2, m3)));
+  for (; i < n; i++) {
+    if (x[i] > m) {
+      m = x[i];
+    }
+  }
+  return m;
+
+}
+
+
+SIMD_TARGET_AVX2 size_t _simd_find_f32_avx2(const float* x, size_t n, float v) {
+
+  __m256 vv = _mm256_set1_ps(v);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 eq = _mm256_cmp_ps(_mm256_loadu_ps(x + i), vv, _CMP_EQ_OQ);
+    int mask = _mm256_movemask_ps(eq);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  size_t tail = _simd_find_f32_scalar(x + i, n - i, v);
+  return tail == SIMD_NONE ? SIMD_NONE : i + tail;
+
+}
+
+
+SIMD_TARGET_AVX2 float _simd_max_mul_avx2(const int32_t* a, const float* b,
+    size_t n) {
+
+  __m256 m0 = _mm256_set1_ps(a[0] * b[0]);
+  __m256 m1 = m0;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    m0 = _mm256_max_ps(_simd_mul_avx2(a + i, b + i), m0);
+    m1 = _mm256_max_ps(_simd_mul_avx2(a + i + 8, b + i + 8), m1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    m0 = _mm256_max_ps(_simd_mul_avx2(a + i, b + i), m0);
+  }
+  float m = _simd_hmax_avx2(_mm256_max_ps(m0, m1));
+  for (; i < n; i++) {
+    float p = a[i] * b[i];
+    if (p > m) {
+      m = p;
+    }
+  }
+  return m;
+
+}
+
+
+SIMD_TARGET_AVX2 size_t _simd_find_mul_avx2(const int32_t* a, const float* b,
+    size_t n, float v) {
+
+  __m256 vv = _mm256_set1_ps(v);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 eq = _mm256_cmp_ps(_simd_mul_avx2(a + i, b + i), vv, _CMP_EQ_OQ);
+    int mask = _mm256_movemask_ps(eq);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  size_t tail = _simd_find_mul_scalar(a + i, b + i, n - i, v);
+  return tail == SIMD_NONE ? SIMD_NONE : i + tail;
+
+}
+
+
+SIMD_TARGET_AVX2 double _simd_sum_mul_avx2(const int32_t* a, const float* b,
+    size_t n) {
+
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i va_lo = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i va_hi = _mm_loadu_si128((const __m128i*)(a + i + 4));
+    __m256d a_lo = _mm256_cvtepi32_pd(va_lo);
+    __m256d a_hi = _mm256_cvtepi32_pd(va_hi);
+    __m256d b_lo = _mm256_cvtps_pd(_mm_loadu_ps(b + i));
+    __m256d b_hi = _mm256_cvtps_pd(_mm_loadu_ps(b + i + 4));
+    s0 = _mm256_add_pd(s0, _mm256_mul_pd(a_lo, b_lo));
+    s1 = _mm256_add_pd(s1, _mm256_mul_pd(a_hi, b_hi));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+    _simd_sum_mul_scalar(a + i, b + i, n - i);
+
+}
+
+
+/*
+ * Auxilliary function to compare eight floats with eight copies of a
+ * constant.  The ordered predicates are false for NaN lanes and _CMP_NEQ_UQ
+ * is true for them, just like the C operators.
+ */
+SIMD_TARGET_AVX2 __m256 _simd_cmp_ps_avx2(__m256 x, __m256 v,
+    enum simd_cmp op) {
+
+  switch (op) {
+    case SIMD_CMP_LT:
+      return _mm256_cmp_ps(x, v, _CMP_LT_OQ);
+    case SIMD_CMP_LE:
+      return _mm256_cmp_ps(x, v, _CMP_LE_OQ);
+    case SIMD_CMP_GT:
+      return _mm256_cmp_ps(x, v, _CMP_GT_OQ);
+    case SIMD_CMP_GE:
+      return _mm256_cmp_ps(x, v, _CMP_GE_OQ);
+    case SIMD_CMP_EQ:
+      return _mm256_cmp_ps(x, v, _CMP_EQ_OQ);
+    default:
+      return _mm256_cmp_ps(x, v, _CMP_NEQ_UQ);
+  }
+
+}
+
+
+SIMD_TARGET_AVX2 void _simd_filter_f32_avx2(const float* x, size_t n,
+    enum simd_cmp op, float v, uint64_t* bits) {
+
+  __m256 vv = _mm256_set1_ps(v);
+  size_t w = 0;
+  for (; (w + 1) * 64 <= n; w++) {
+    if (bits[w]) {
+      const float* xw = x + w * 64;
+      uint64_t mask = 0;
+      for (int j = 0; j < 64; j += 8) {
+        __m256 c = _simd_cmp_ps_avx2(_mm256_loadu_ps(xw + j), vv, op);
+        mask |= (uint64_t)_mm256_movemask_ps(c) << j;
+      }
+      bits[w] &= mask;
+    }
+  }
+  if (w * 64 < n && bits[w]) {
+    bits[w] &= _simd_cmp_f32_scalar(x + w * 64, n - w * 64, op, v);
+  }
+
+}
+
+
+/*
+ * AVX2 can only compare integers with > and ==, so < is computed as > with
+ * the operands swapped, and <=, >= and != as the complements of >, < and ==.
+ */
+SIMD_TARGET_AVX2 void _simd_filter_i32_avx2(const int32_t* x, size_t n,
+    enum simd_cmp op, int32_t v, uint64_t* bits) {
+
+  __m256i vv = _mm256_set1_epi32(v);
+  int negate = op == SIMD_CMP_LE || op == SIMD_CMP_GE || op == SIMD_CMP_NE;
+  size_t w = 0;
+  for (; (w + 1) * 64 <= n; w++) {
+    if (bits[w]) {
+      const int32_t* xw = x + w * 64;
+      uint64_t mask = 0;
+      for (int j = 0; j < 64; j += 8) {
+        __m256i xi = _mm256_loadu_si256((const __m256i*)(xw + j));
+        __m256i c;
+        if (op == SIMD_CMP_LT || op == SIMD_CMP_GE) {
+          c = _mm256_cmpgt_epi32(vv, xi);
+        } else if (op == SIMD_CMP_GT || op == SIMD_CMP_LE) {
+          c = _mm256_cmpgt_epi32(xi, vv);
+        } else {
+          c = _mm256_cmpeq_epi32(xi, vv);
+        }
+        mask |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(c)) << j;
+      }
+      bits[w] &= negate ? ~mask : mask;
+    }
+  }
+  if (w * 64 < n && bits[w]) {
+    bits[w] &= _simd_cmp_i32_scalar(x + w * 64, n - w * 64, op, v);
+  }
+
+}
+
+
+const struct simd_kernels _simd_avx2_kernels = {
+  SIMD_AVX2,
+  _simd_max_f32_avx2,
+  _simd_find_f32_avx2,
+  _simd_max_mul_avx2,
+  _simd_find_mul_avx2,
+  _simd_sum_mul_avx2,
+  _simd_filter_f32_avx2,
+  _simd_filter_i32_avx2
+};
+
+#endif
+
+
+/*****************************************************************************
+ *
+ * Dispatch
+ *
+ *****************************************************************************/
+
+int simd_level_supported(enum simd_level level) {
+
+  switch (level) {
+    case SIMD_SCALAR:
+      return 1;
+#ifdef SIMD_X86
+    case SIMD_SSE2:
+      return 1;
+    case SIMD_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return 0;
+  }
+
+}
+
+
+/*
+ * Auxilliary function to return the kernels for a given level.
+ */
+const struct simd_kernels* _simd_kernels_for(enum simd_level level) {
+
+  switch (level) {
+#ifdef SIMD_X86
+    case SIMD_AVX2:
+      return &_simd_avx2_kernels;
+    case SIMD_SSE2:
+      return &_simd_sse2_kernels;
+#endif
+    default:
+      return &_simd_scalar_kernels;
+  }
+
+}
+
+
+/*
+ * Auxilliary function run through pthread_once() to start the kernels off at
+ * the best level the CPU supports.
+ */
+void _simd_pick_default() {
+
+  enum simd_level level = SIMD_SCALAR;
+  if (simd_level_supported(SIMD_AVX2)) {
+    level = SIMD_AVX2;
+  } else if (simd_level_supported(SIMD_SSE2)) {
+    level = SIMD_SSE2;
+  }
+  __atomic_store_n(&_simd_kernels, _simd_kernels_for(level),
+    __ATOMIC_RELEASE);
+
+}
+
+
+void simd_set_level(enum simd_level level) {
+
+  assert(simd_level_supported(level));
+
+  /*
+   * Make sure the default has already been picked, so it can't overwrite
+   * this level later.
+   */
+  pthread_once(&_simd_once, _simd_pick_default);
+  __atomic_store_n(&_simd_kernels, _simd_kernels_for(level),
+    __ATOMIC_RELEASE);
+
+}
+
+
+/*
+ * Auxilliary function to return the kernels in use, picking the best level
+ * the CPU supports on the first call.  Once they've been picked, this is a
+ * single atomic load.
+ */
+const struct simd_kernels* _simd_get_kernels() {
+
+  const struct simd_kernels* k = __atomic_load_n(&_simd_kernels,
+    __ATOMIC_ACQUIRE);
+  if (!k) {
+    pthread_once(&_simd_once, _simd_pick_default);
+    k = __atomic_load_n(&_simd_kernels, __ATOMIC_ACQUIRE);
+  }
+  return k;
+
+}
+
+
+enum simd_level simd_get_level() {
+
+  return _simd_get_kernels()->level;
+
+}
+
+
+size_t simd_argmax_f32(const float* x, size_t n) {
+
+  if (n == 0) {
+    return SIMD_NONE;
+  }
+  if (x[0] != x[0]) {
+    return 0;
+  }
+  const struct simd_kernels* k = _simd_get_kernels();
+  return k->find_f32(x, n, k->max_f32(x, n));
+
+}
+
+
+size_t simd_argmax_mul_i32_f32(const int32_t* a, const float* b, size_t n) {
+
+  if (n == 0) {
+    return SIMD_NONE;
+  }
+  float first = a[0] * b[0];
+  if (first != first) {
+    return 0;
+  }
+  const struct simd_kernels* k = _simd_get_kernels();
+  return k->find_mul(a, b, n, k->max_mul(a, b, n));
+
+}
+
+
+double simd_sum_mul_i32_f32(const int32_t* a, const float* b, size_t n) {
+
+  return _simd_get_kernels()->sum_mul(a, b, n);
+
+}
+
+
+void simd_filter_f32(const float* x, size_t n, enum simd_cmp op, float v,
+    uint64_t* bits) {
+
+  _simd_get_kernels()->filter_f32(x, n, op, v, bits);
+
+}
+
+
+void simd_filter_i32(const int32_t* x, size_t n, enum simd_cmp op, int32_t v,
+    uint64_t* bits) {
+
+  _simd_get_kernels()->filter_i32(x, n, op, v, bits);
+
+}
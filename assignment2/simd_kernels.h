@@ -0,0 +1,134 @@
+/*
+ * This file contains the definition of an interface for vectorized
+ * reductions and filters over the contiguous columns of a columnar product
+ * catalog.  Each kernel has a scalar version, an SSE2 version and an AVX2
+ * version.  The best version the CPU supports is picked at runtime the first
+ * time any kernel is called, so the same binary runs everywhere and still uses
+ * the widest vectors available.
+ */
+
+#ifndef __SIMD_KERNELS_H
+#define __SIMD_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Value returned by the argmax kernels below when given no elements.
+ */
+#define SIMD_NONE ((size_t)-1)
+
+/*
+ * The instruction set levels the kernels are implemented for, from narrowest
+ * to widest.
+ */
+enum simd_level {
+  SIMD_SCALAR,
+  SIMD_SSE2,
+  SIMD_AVX2
+};
+
+/*
+ * The comparisons the filter kernels below can make between each element and
+ * a constant.  They behave like the C operators <, <=, >, >=, == and !=, so
+ * for floats a NaN element satisfies SIMD_CMP_NE and nothing else.
+ */
+enum simd_cmp {
+  SIMD_CMP_LT,
+  SIMD_CMP_LE,
+  SIMD_CMP_GT,
+  SIMD_CMP_GE,
+  SIMD_CMP_EQ,
+  SIMD_CMP_NE
+};
+
+/*
+ * Returns whether the CPU running the program supports a given level.
+ * SIMD_SCALAR is always supported.
+ */
+int simd_level_supported(enum simd_level level);
+
+/*
+ * Returns the level the kernels are currently using.
+ */
+enum simd_level simd_get_level();
+
+/*
+ * Makes the kernels use a given level instead of the best one the CPU
+ * supports.  This is meant for testing and benchmarking the narrower levels.
+ * It's safe to call while other threads are running kernels, though each
+ * call they've already started finishes at the level it started with.
+ *
+ * Params:
+ *   level - the level to use.  Must be supported by the CPU.
+ */
+void simd_set_level(enum simd_level level);
+
+/*
+ * Returns the index of the largest of n floats.  Ties go to the earliest
+ * element, and NaN values are skipped unless the first element is NaN, in
+ * which case 0 is returned.  This matches a scalar loop that keeps the first
+ * element and replaces it only with strictly greater ones.
+ *
+ * Params:
+ *   x - the values to be scanned
+ *   n - the number of values
+ *
+ * Return:
+ *   Returns the index of the largest value, or SIMD_NONE if n is 0.
+ */
+size_t simd_argmax_f32(const float* x, size_t n);
+
+/*
+ * Returns the index of the largest of the n products a[i] * b[i], where each
+ * product is computed in single precision exactly as a scalar (float)a[i] *
+ * b[i] would be.  Ties and NaN values are handled as in simd_argmax_f32().
+ *
+ * Params:
+ *   a - the integer factors
+ *   b - the floating point factors
+ *   n - the number of factor pairs
+ *
+ * Return:
+ *   Returns the index of the largest product, or SIMD_NONE if n is 0.
+ */
+size_t simd_argmax_mul_i32_f32(const int32_t* a, const float* b, size_t n);
+
+/*
+ * Returns the sum of the n products a[i] * b[i], computed in double
+ * precision.  The vectorized levels add the products in a different order
+ * than a scalar loop would, so their results may differ from the scalar
+ * level's in the last few bits.
+ *
+ * Params:
+ *   a - the integer factors
+ *   b - the floating point factors
+ *   n - the number of factor pairs
+ */
+double simd_sum_mul_i32_f32(const int32_t* a, const float* b, size_t n);
+
+/*
+ * Compares each of n floats with a constant and clears the bits of a bitmap
+ * for the elements that fail the comparison, so that calling this once per
+ * predicate leaves set only the bits of elements satisfying all of them.
+ * Element i corresponds to bit i % 64 of word i / 64.  Words that are already
+ * 0 are skipped without reading their elements, and bits past the last
+ * element are cleared.
+ *
+ * Params:
+ *   x - the values to be compared
+ *   n - the number of values
+ *   op - the comparison to make, as in x[i] op v
+ *   v - the constant to compare with
+ *   bits - the bitmap to be updated, which has (n + 63) / 64 words
+ */
+void simd_filter_f32(const float* x, size_t n, enum simd_cmp op, float v,
+  uint64_t* bits);
+
+/*
+ * Works like simd_filter_f32(), but on integers.
+ */
+void simd_filter_i32(const int32_t* x, size_t n, enum simd_cmp op, int32_t v,
+  uint64_t* bits);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the string arena declared in string_arena.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "string_arena.h"
+
+/*
+ * Strings are copied into blocks of this many bytes.  Strings too long to
+ * fit in a block get a block of their own.
+ */
+#define STRING_ARENA_BLOCK_SIZE (64 * 1024)
+
+#define STRING_ARENA_INIT_SLOTS 64
+
+/*
+ * This structure represents a single block of string data.  The block's
+ * characters immediately follow this header.
+ */
+struct string_block {
+  struct string_block* next;
+  size_t size;
+};
+
+/*
+ * This structure represents a slot in the arena's hash set.  str is NULL for
+ * empty slots.  Each slot caches part of its string's hash and its length, so
+ * most mismatches are rejected without touching the string itself.
+ */
+struct string_slot {
+  const char* str;
+  uint32_t hash;
+  uint32_t len;
+};
+
+/*
+ * This is the definition of the string arena structure.  Blocks are kept in a
+ * list with the current block at the head, and used counts how many bytes of
+ * the current block are full.  The hash set uses open addressing with linear
+ * probing, and its number of slots is always a power of 2.
+ */
+struct string_arena {
+  struct string_block* blocks;
+  size_t used;
+  struct string_slot* slots;
+  size_t num_slots;
+  size_t count;
+  size_t bytes;
+};
+
+
+/*
+ * Auxilliary function to hash a string with 64-bit FNV-1a.
+ */
+uint64_t _string_arena_hash(const char* str, size_t len) {
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+
+}
+
+
+/*
+ * Auxilliary function to return the first character of a string block.
+ */
+char* _string_block_mem(struct string_block* block) {
+
+  return (char*)(block + 1);
+
+}
+
+
+/*
+ * Auxilliary function to push a new block of at least size bytes onto the
+ * front of an arena's block list.
+ */
+void _string_arena_push_block(struct string_arena* sa, size_t size) {
+
+  if (size < STRING_ARENA_BLOCK_SIZE) {
+    size = STRING_ARENA_BLOCK_SIZE;
+  }
+  assert(size <= SIZE_MAX - sizeof(struct string_block));
+  struct string_block* block = malloc(sizeof(struct string_block) + size);
+  assert(block);
+  block->size = size;
+  block->next = sa->blocks;
+  sa->blocks = block;
+  sa->used = 0;
+
+}
+
+
+/*
+ * Auxilliary function to copy a string into an arena's blocks, adding a
+ * terminating NUL, and return the copy.
+ */
+const char* _string_arena_store(struct string_arena* sa, const char* str,
+    size_t len) {
+
+  size_t size = len + 1;
+  if (!sa->blocks || size > sa->blocks->size - sa->used) {
+    _string_arena_push_block(sa, size);
+  }
+  char* copy = _string_block_mem(sa->blocks) + sa->used;
+  if (len > 0) {
+    memcpy(copy, str, len);
+  }
+  copy[len] = '\0';
+  sa->used += size;
+  sa->bytes += size;
+  return copy;
+
+}
+
+
+/*
+ * Auxilliary function to double the number of slots in an arena's hash set
+ * and reinsert every string into the new slots.
+ */
+void _string_arena_grow_slots(struct string_arena* sa) {
+
+  size_t num_slots = 2 * sa->num_slots;
+  struct string_slot* slots = calloc(num_slots, sizeof(struct string_slot));
+  assert(slots);
+
+  for (size_t i = 0; i < sa->num_slots; i++) {
+    struct string_slot* old = &sa->slots[i];
+    if (old->str) {
+      size_t j = old->hash & (num_slots - 1);
+      while (slots[j].str) {
+        j = (j + 1) & (num_slots - 1);
+      }
+      slots[j] = *old;
+    }
+  }
+
+  free(sa->slots);
+  sa->slots = slots;
+  sa->num_slots = num_slots;
+
+}
+
+
+/*
+ * Auxilliary function to return the slot of an arena's hash set holding the
+ * string str of length len, whose hash is given, or the empty slot where it
+ * belongs if it isn't in the arena.
+ */
+size_t _string_arena_probe(struct string_arena* sa, const char* str,
+    size_t len, uint32_t hash) {
+
+  size_t i = hash & (sa->num_slots - 1);
+  while (sa->slots[i].str) {
+    struct string_slot* slot = &sa->slots[i];
+    if (slot->hash == hash && slot->len == len &&
+        (len == 0 || memcmp(slot->str, str, len) == 0)) {
+      return i;
+    }
+    i = (i + 1) & (sa->num_slots - 1);
+  }
+  return i;
+
+}
+
+
+struct string_arena* string_arena_create() {
+
+  struct string_arena* sa = malloc(sizeof(struct string_arena));
+  assert(sa);
+  sa->blocks = NULL;
+  sa->used = 0;
+  sa->num_slots = STRING_ARENA_INIT_SLOTS;
+  sa->slots = calloc(sa->num_slots, sizeof(struct string_slot));
+  assert(sa->slots);
+  sa->count = 0;
+  sa->bytes = 0;
+  return sa;
+
+}
+
+
+void string_arena_free(struct string_arena* sa) {
+
+  assert(sa);
+  while (sa->blocks) {
+    struct string_block* next = sa->blocks->next;
+    free(sa->blocks);
+    sa->blocks = next;
+  }
+  free(sa->slots);
+  free(sa);
+
+}
+
+
+const char* string_arena_intern(struct string_arena* sa, const char* str) {
+
+  assert(str);
+  return string_arena_intern_n(sa, str, strlen(str));
+
+}
+
+
+const char* string_arena_intern_n(struct string_arena* sa, const char* str,
+    size_t len) {
+
+  assert(sa && (str || len == 0));
+  assert(len < UINT32_MAX);
+
+  /*
+   * Keep the hash set at most 3/4 full so probe sequences stay short.
+   */
+  if (4 * (sa->count + 1) > 3 * sa->num_slots) {
+    _string_arena_grow_slots(sa);
+  }
+
+  uint32_t hash = (uint32_t)_string_arena_hash(str, len);
+  size_t i = _string_arena_probe(sa, str, len, hash);
+  if (sa->slots[i].str) {
+    return sa->slots[i].str;
+  }
+
+  sa->slots[i].str = _string_arena_store(sa, str, len);
+  sa->slots[i].hash = hash;
+  sa->slots[i].len = (uint32_t)len;
+  sa->count++;
+  return sa->slots[i].str;
+
+}
+
+
+const char* string_arena_find(struct string_arena* sa, const char* str) {
+
+  assert(sa && str);
+  size_t len = strlen(str);
+  uint32_t hash = (uint32_t)_string_arena_hash(str, len);
+  return sa->slots[_string_arena_probe(sa, str, len, hash)].str;
+
+}
+
+
+size_t string_arena_merge(struct string_arena* sa,
+    struct string_arena* other) {
+
+  assert(sa && other && sa != other);
+
+  /*
+   * Adopt other's copy of every string sa doesn't have yet.  The slots
+   * already know each string's hash and length, so nothing is rehashed.
+   */
+  size_t duplicates = 0;
+  for (size_t j = 0; j < other->num_slots; j++) {
+    struct string_slot* slot = &other->slots[j];
+    if (!slot->str) {
+      continue;
+    }
+    if (4 * (sa->count + 1) > 3 * sa->num_slots) {
+      _string_arena_grow_slots(sa);
+    }
+    size_t i = _string_arena_probe(sa, slot->str, slot->len, slot->hash);
+    if (sa->slots[i].str) {
+      duplicates++;
+    } else {
+      sa->slots[i] = *slot;
+      sa->count++;
+    }
+  }
+
+  /*
+   * Hand other's blocks over to sa behind its current block, so sa carries
+   * on filling that block.
+   */
+  if (other->blocks) {
+    if (!sa->blocks) {
+      sa->blocks = other->blocks;
+      sa->used = other->used;
+    } else {
+      struct string_block* tail = other->blocks;
+      while (tail->next) {
+        tail = tail->next;
+      }
+      tail->next = sa->blocks->next;
+      sa->blocks->next = other->blocks;
+    }
+  }
+  sa->bytes += other->bytes;
+
+  free(other->slots);
+  free(other);
+  return duplicates;
+
+}
+
+
+size_t string_arena_count(struct string_arena* sa) {
+
+  assert(sa);
+  return sa->count;
+
+}
+
+
+size_t string_arena_bytes(struct string_arena* sa) {
+
+  assert(sa);
+  return sa->bytes;
+
+}
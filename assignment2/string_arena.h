@@ -0,0 +1,123 @@
+/*
+ * This file contains the definition of an interface for an arena that stores
+ * interned strings.
+ */
+
+#ifndef __STRING_ARENA_H
+#define __STRING_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Structure used to represent a string arena.  Strings added to the arena are
+ * copied into large append-only blocks, one after another, so storing a
+ * string costs no allocation of its own and freeing the arena frees every
+ * string in it at once, in time proportional to the number of blocks.
+ *
+ * Strings are interned: a hash set remembers every string in the arena, and
+ * adding a string equal to one already there returns the existing copy
+ * instead of storing another one.  That means repeated strings take no extra
+ * memory, and two strings from the same arena are equal exactly when their
+ * pointers are.  Strings returned by the arena never move, so the pointers
+ * stay valid until the arena is freed.
+ */
+struct string_arena;
+
+/*
+ * Creates a new, empty string arena and returns a pointer to it.
+ */
+struct string_arena* string_arena_create();
+
+/*
+ * Frees a string arena along with every string stored in it.
+ *
+ * Params:
+ *   sa - the arena to be destroyed.  May not be NULL.
+ */
+void string_arena_free(struct string_arena* sa);
+
+/*
+ * Interns a NUL-terminated string in a string arena.
+ *
+ * Params:
+ *   sa - the arena in which to intern the string.  May not be NULL.
+ *   str - the string to be interned.  May not be NULL.
+ *
+ * Return:
+ *   Returns the arena's copy of str, which is stored in the arena the first
+ *   time an equal string is interned.  The copy must not be modified.
+ */
+const char* string_arena_intern(struct string_arena* sa, const char* str);
+
+/*
+ * Interns a string given by its length in a string arena.  This works like
+ * string_arena_intern(), except that str doesn't need to be NUL-terminated,
+ * which lets callers intern pieces of a larger buffer without copying them
+ * first.  The arena's copy is NUL-terminated.
+ *
+ * Params:
+ *   sa - the arena in which to intern the string.  May not be NULL.
+ *   str - the first character of the string to be interned.  May not be NULL
+ *     unless len is 0.
+ *   len - the number of characters in the string
+ */
+const char* string_arena_intern_n(struct string_arena* sa, const char* str,
+  size_t len);
+
+/*
+ * Looks a string up in a string arena without interning it.  This doesn't
+ * modify the arena, so any number of threads may look strings up at once, as
+ * long as no thread is changing the arena meanwhile.
+ *
+ * Params:
+ *   sa - the arena in which to look the string up.  May not be NULL.
+ *   str - the NUL-terminated string to be found.  May not be NULL.
+ *
+ * Return:
+ *   Returns the arena's copy of str, or NULL if no equal string has been
+ *   interned in the arena.
+ */
+const char* string_arena_find(struct string_arena* sa, const char* str);
+
+/*
+ * Moves every string in one string arena into another and frees the first
+ * arena.  No string is copied: other's blocks are handed over to sa, so
+ * pointers to other's strings stay valid until sa is freed.  This lets
+ * several threads intern strings into arenas of their own and combine them
+ * afterwards.
+ *
+ * Strings that were in both arenas remain interned as sa's copies.  Other's
+ * copies of them still take up space in sa, and pointers to them must be
+ * replaced with string_arena_find() for pointers to equal strings to compare
+ * equal again.
+ *
+ * Params:
+ *   sa - the arena into which to move the strings.  May not be NULL.
+ *   other - the arena to be merged into sa and freed.  May not be NULL, and
+ *     may not be sa.
+ *
+ * Return:
+ *   Returns the number of strings that were in both arenas, so that callers
+ *   can skip replacing pointers when it's 0.
+ */
+size_t string_arena_merge(struct string_arena* sa, struct string_arena* other);
+
+/*
+ * Returns the number of distinct strings stored in a string arena.
+ *
+ * Params:
+ *   sa - the arena whose strings are to be counted.  May not be NULL.
+ */
+size_t string_arena_count(struct string_arena* sa);
+
+/*
+ * Returns the number of bytes of string data stored in a string arena,
+ * including each string's terminating NUL.  This doesn't include unused space
+ * at the ends of blocks or the memory used by the hash set.
+ *
+ * Params:
+ *   sa - the arena whose size is to be returned.  May not be NULL.
+ */
+size_t string_arena_bytes(struct string_arena* sa);
+
+#endif
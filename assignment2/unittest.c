@@ -0,0 +1,1453 @@
+/*
+ * This file uses the Acutest unit testing framework to test the data
+ * structures in this directory.  You can find more about the Acutest
+ * framework here: https://github.com/mity/acutest.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "acutest.h"
+
+#include "products.h"
+#include "product_io.h"
+#include "product_index.h"
+#include "product_filter.h"
+#include "product_catalog.h"
+#include "product_sketch.h"
+#include "dynarray.h"
+#include "dynarray_sort.h"
+#include "string_arena.h"
+#include "cdynarray.h"
+#include "product_columns.h"
+#include "simd_kernels.h"
+
+#define CDYNARRAY_TEST_THREADS 4
+#define CDYNARRAY_TEST_PER_THREAD 10000
+
+/*
+ * The size of the buffers _make_product_inputs() formats names into.
+ */
+#define TEST_NAME_SIZE 16
+
+/*
+ * Arguments passed to each thread appending to a shared concurrent dynamic
+ * array.  Each thread appends pointers to its own slice of vals.
+ */
+struct cdynarray_test_args {
+  struct cdynarray* ca;
+  int* vals;
+};
+
+void* cdynarray_test_append(void* arg) {
+  struct cdynarray_test_args* args = arg;
+  int i;
+  for (i = 0; i < CDYNARRAY_TEST_PER_THREAD; i++) {
+    cdynarray_push_back(args->ca, &args->vals[i]);
+  }
+  return NULL;
+}
+
+/*
+ * Comparison functions for sorting arrays of int pointers and arrays of
+ * {key, seq} int records by key.
+ */
+int int_ptr_cmp(void* a, void* b) {
+  int ia = *(int*)a, ib = *(int*)b;
+  return (ia > ib) - (ia < ib);
+}
+
+int int_rec_cmp(void* a, void* b) {
+  int ia = ((int*)a)[0], ib = ((int*)b)[0];
+  return (ia > ib) - (ia < ib);
+}
+
+/*
+ * Key extraction function for radix sorting arrays of {key, seq} int records
+ * by key, with the sign bit flipped so negative keys sort first.
+ */
+uint32_t int_rec_key(void* a) {
+  return (uint32_t)((int*)a)[0] ^ 0x80000000u;
+}
+
+/*
+ * Auxilliary function to allocate the name, inventory and price arrays for n
+ * products.  Product i's name is name_format formatted with i % num_names as
+ * an int, and the inventories and prices are left for the caller to fill.
+ * The arrays are freed with _free_product_inputs().
+ */
+void _make_product_inputs(size_t n, const char* name_format, int num_names,
+    char*** names, int** inventories, float** prices) {
+  size_t i;
+  *names = malloc(n * sizeof(char*));
+  *inventories = malloc(n * sizeof(int));
+  *prices = malloc(n * sizeof(float));
+  for (i = 0; i < n; i++) {
+    (*names)[i] = malloc(TEST_NAME_SIZE);
+    snprintf((*names)[i], TEST_NAME_SIZE, name_format, (int)(i % num_names));
+  }
+}
+
+/*
+ * Auxilliary function to free the arrays for n products allocated by
+ * _make_product_inputs().
+ */
+void _free_product_inputs(size_t n, char** names, int* inventories,
+    float* prices) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    free(names[i]);
+  }
+  free(prices);
+  free(inventories);
+  free(names);
+}
+
+/****************************************************************************
+ **
+ ** Tests
+ **
+ ****************************************************************************/
+
+
+/*
+ * This function specifies a unit test for the concurrent dynamic array.  It
+ * specifically has several threads append to the same array at once, then
+ * makes sure every value was stored exactly once and that the values survive
+ * being copied into a regular dynamic array.
+ */
+void test_cdynarray_concurrent_push_back() {
+  size_t n = CDYNARRAY_TEST_THREADS * CDYNARRAY_TEST_PER_THREAD;
+  struct cdynarray* ca = cdynarray_create();
+  struct cdynarray_test_args args[CDYNARRAY_TEST_THREADS];
+  pthread_t threads[CDYNARRAY_TEST_THREADS];
+  struct dynarray* da;
+  int* vals = malloc(n * sizeof(int));
+  char* seen = calloc(n, sizeof(char));
+  size_t i;
+  int t, missing = 0, duplicates = 0;
+
+  for (i = 0; i < n; i++) {
+    vals[i] = (int)i;
+  }
+
+  for (t = 0; t < CDYNARRAY_TEST_THREADS; t++) {
+    args[t].ca = ca;
+    args[t].vals = vals + t * CDYNARRAY_TEST_PER_THREAD;
+    pthread_create(&threads[t], NULL, cdynarray_test_append, &args[t]);
+  }
+  for (t = 0; t < CDYNARRAY_TEST_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  TEST_CHECK_(cdynarray_length(ca) == n, "length is correct (%d == %d)",
+    (int)cdynarray_length(ca), (int)n);
+
+  for (i = 0; i < n; i++) {
+    int* val = cdynarray_get(ca, i);
+    if (!val) {
+      missing++;
+    } else if (seen[*val]++) {
+      duplicates++;
+    }
+  }
+  TEST_CHECK_(missing == 0, "no slots are empty (%d == 0)", missing);
+  TEST_CHECK_(duplicates == 0, "no values are duplicated (%d == 0)",
+    duplicates);
+
+  da = dynarray_create();
+  cdynarray_append_to(ca, da);
+  TEST_CHECK_(dynarray_length(da) == n, "copied length is correct "
+    "(%d == %d)", (int)dynarray_length(da), (int)n);
+  for (i = 0; i < n; i++) {
+    TEST_CHECK_(dynarray_get(da, i) == cdynarray_get(ca, i),
+      "%d'th copied value is correct", (int)i);
+  }
+
+  dynarray_free(da);
+  cdynarray_free(ca);
+  free(seen);
+  free(vals);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_sort().  It specifically
+ * sorts arrays in several orders that are known to trip up naive quicksorts,
+ * including sorted, reversed, organ-pipe and all-equal inputs, and makes sure
+ * each comes out sorted.
+ */
+void test_dynarray_sort() {
+  size_t n = 10000, i;
+  int* vals = malloc(n * sizeof(int));
+  int pattern;
+  const char* names[] = { "sorted", "reversed", "organ pipe", "equal",
+    "random" };
+
+  srand(0);
+  for (pattern = 0; pattern < 5; pattern++) {
+    struct dynarray* da = dynarray_create();
+    int sorted = 1;
+    for (i = 0; i < n; i++) {
+      switch (pattern) {
+        case 0: vals[i] = (int)i; break;
+        case 1: vals[i] = (int)(n - i); break;
+        case 2: vals[i] = (int)(i < n / 2 ? i : n - i); break;
+        case 3: vals[i] = 7; break;
+        default: vals[i] = rand() % 1000; break;
+      }
+      dynarray_insert(da, DYNARRAY_END, &vals[i]);
+    }
+    dynarray_sort(da, int_ptr_cmp);
+    TEST_CHECK_(dynarray_length(da) == n, "%s length is correct",
+      names[pattern]);
+    for (i = 1; i < n; i++) {
+      if (*(int*)dynarray_get(da, i - 1) > *(int*)dynarray_get(da, i)) {
+        sorted = 0;
+      }
+    }
+    TEST_CHECK_(sorted, "%s input is sorted", names[pattern]);
+    dynarray_free(da);
+  }
+
+  free(vals);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_stable_sort().  It
+ * specifically sorts a record array with many duplicate keys and makes sure
+ * records with equal keys keep their original relative order.
+ */
+void test_dynarray_stable_sort() {
+  struct dynarray* da = dynarray_create_sized(2 * sizeof(int));
+  int rec[2];
+  int i, n = 5000, stable = 1;
+
+  srand(1);
+  for (i = 0; i < n; i++) {
+    rec[0] = rand() % 50;
+    rec[1] = i;
+    dynarray_insert(da, DYNARRAY_END, rec);
+  }
+  dynarray_stable_sort(da, int_rec_cmp);
+
+  for (i = 1; i < n; i++) {
+    int* prev = dynarray_get(da, i - 1);
+    int* cur = dynarray_get(da, i);
+    if (prev[0] > cur[0] || (prev[0] == cur[0] && prev[1] > cur[1])) {
+      stable = 0;
+    }
+  }
+  TEST_CHECK_(stable, "records are sorted and equal keys keep their order");
+
+  dynarray_free(da);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_parallel_sort().  It
+ * specifically sorts pointer and record arrays with a small cutoff, so that
+ * several threads take part, using a thread count that isn't a power of two
+ * to exercise the uneven final merge rounds.
+ */
+void test_dynarray_parallel_sort() {
+  int n = 100000;
+  int* vals = malloc(n * sizeof(int));
+  struct dynarray* ptrs = dynarray_create();
+  struct dynarray* recs = dynarray_create_sized(2 * sizeof(int));
+  int rec[2];
+  int i, sorted = 1;
+  long sum = 0;
+
+  srand(2);
+  for (i = 0; i < n; i++) {
+    vals[i] = rand() % 10000;
+    rec[0] = vals[i];
+    rec[1] = i;
+    dynarray_insert(ptrs, DYNARRAY_END, &vals[i]);
+    dynarray_insert(recs, DYNARRAY_END, rec);
+  }
+  dynarray_parallel_sort(ptrs, int_ptr_cmp, 5, 1000);
+  dynarray_parallel_sort(recs, int_rec_cmp, 3, 1000);
+
+  for (i = 0; i < n; i++) {
+    int* r = dynarray_get(recs, i);
+    sum += r[1];
+    if (i > 0 && (*(int*)dynarray_get(ptrs, i - 1) >
+        *(int*)dynarray_get(ptrs, i) || ((int*)dynarray_get(recs, i - 1))[0] >
+        r[0])) {
+      sorted = 0;
+    }
+  }
+  TEST_CHECK_(sorted, "pointer and record arrays are sorted");
+  TEST_CHECK_(sum == (long)n * (n - 1) / 2, "no records were lost or "
+    "duplicated");
+
+  dynarray_free(ptrs);
+  dynarray_free(recs);
+  free(vals);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_radix_sort().  It
+ * specifically sorts a record array with negative, positive and duplicate
+ * keys and makes sure the result is in order and stable.
+ */
+void test_dynarray_radix_sort() {
+  struct dynarray* da = dynarray_create_sized(2 * sizeof(int));
+  int rec[2];
+  int i, n = 20000, stable = 1;
+
+  srand(3);
+  for (i = 0; i < n; i++) {
+    rec[0] = rand() % 2000 - 1000;
+    if (i % 7 == 0) {
+      rec[0] *= 1000000;
+    }
+    rec[1] = i;
+    dynarray_insert(da, DYNARRAY_END, rec);
+  }
+  dynarray_radix_sort(da, int_rec_key);
+
+  for (i = 1; i < n; i++) {
+    int* prev = dynarray_get(da, i - 1);
+    int* cur = dynarray_get(da, i);
+    if (prev[0] > cur[0] || (prev[0] == cur[0] && prev[1] > cur[1])) {
+      stable = 0;
+    }
+  }
+  TEST_CHECK_(stable, "records are sorted and equal keys keep their order");
+
+  dynarray_free(da);
+}
+
+
+/*
+ * Comparison function ordering products by ascending inventory, descending
+ * price and name, used to check sort_by_inventory_price_name().
+ */
+int compare_inventory_price_name(void* a, void* b) {
+  struct product* pa = a;
+  struct product* pb = b;
+  if (pa->inventory != pb->inventory) {
+    return pa->inventory < pb->inventory ? -1 : 1;
+  }
+  if (pa->price != pb->price) {
+    return pa->price > pb->price ? -1 : 1;
+  }
+  return strcmp(pa->name, pb->name);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_keyed_sort(), through
+ * sort_by_inventory_price_name().  It specifically sorts arrays of pointers
+ * and of records whose products tie on inventory, on price (including zero
+ * and negative zero) and on the first 8 bytes of their names, and makes sure
+ * the result is exactly what a stable sort with the equivalent comparison
+ * function produces.
+ */
+void test_sort_by_inventory_price_name() {
+  int n = 20000, i, inline_array, same;
+  char** names = malloc(n * sizeof(char*));
+  int* inventories = malloc(n * sizeof(int));
+  float* prices = malloc(n * sizeof(float));
+  float special[] = {0.0, -0.0, 2.5, -2.5};
+
+  srand(8);
+  for (i = 0; i < n; i++) {
+    names[i] = malloc(16);
+    sprintf(names[i], i % 5 ? "product %d" : "p%d", rand() % 300);
+    inventories[i] = rand() % 20 - 10;
+    prices[i] = i % 3 ? special[rand() % 4] : (rand() % 10) / 2.0;
+  }
+
+  for (inline_array = 0; inline_array < 2; inline_array++) {
+    struct dynarray* a = inline_array ?
+      create_product_array_inline(n, names, inventories, prices) :
+      create_product_array(n, names, inventories, prices);
+    struct dynarray* ref = create_product_array(n, names, inventories, prices);
+    dynarray_stable_sort(ref, compare_inventory_price_name);
+    sort_by_inventory_price_name(a);
+
+    /*
+     * Records are copies, so compare products by their fields.  Prices are
+     * compared bit for bit, which tells zero from negative zero.
+     */
+    same = 1;
+    for (i = 0; i < n && same; i++) {
+      struct product* pa = dynarray_get(a, i);
+      struct product* pr = dynarray_get(ref, i);
+      same = strcmp(pa->name, pr->name) == 0 &&
+        pa->inventory == pr->inventory &&
+        memcmp(&pa->price, &pr->price, sizeof(float)) == 0;
+    }
+    TEST_CHECK_(same, "%s array matches a stable sort",
+      inline_array ? "record" : "pointer");
+    free_product_array(ref);
+    free_product_array(a);
+  }
+
+  for (i = 0; i < n; i++) {
+    free(names[i]);
+  }
+  free(prices);
+  free(inventories);
+  free(names);
+}
+
+
+/*
+ * This function specifies a unit test for the columnar product catalog.  It
+ * specifically builds a catalog from arrays of product fields, checks that
+ * each product's fields come back unchanged, and checks the max price and
+ * max investment scans, including the empty catalog case.
+ */
+void test_product_columns() {
+  char* names[] = { "apples", "soup", "milk", "", "lightbulbs" };
+  int inventories[] = { 7, 6, 3, 1, 4 };
+  float prices[] = { 3.99, 1.99, 2.50, 8.05, 8.05 };
+  struct product_columns* pc = create_product_columns(5, names, inventories,
+    prices);
+  int i;
+
+  TEST_CHECK_(product_columns_length(pc) == 5, "length is correct (%d == 5)",
+    (int)product_columns_length(pc));
+  for (i = 0; i < 5; i++) {
+    TEST_CHECK_(strcmp(product_columns_name(pc, i), names[i]) == 0,
+      "%d'th name is correct (%s == %s)", i, product_columns_name(pc, i),
+      names[i]);
+    TEST_CHECK_(product_columns_inventory(pc, i) == inventories[i] &&
+      product_columns_price(pc, i) == prices[i],
+      "%d'th inventory and price are correct", i);
+  }
+
+  /*
+   * Products 3 and 4 tie on price, and the first one should win.
+   */
+  TEST_CHECK_(product_columns_find_max_price(pc) == 3,
+    "max price index is correct (%d == 3)",
+    (int)product_columns_find_max_price(pc));
+  TEST_CHECK_(product_columns_find_max_investment(pc) == 4,
+    "max investment index is correct (%d == 4)",
+    (int)product_columns_find_max_investment(pc));
+  free_product_columns(pc);
+
+  pc = product_columns_create(0);
+  TEST_CHECK_(product_columns_find_max_price(pc) == PRODUCT_COLUMNS_NONE,
+    "empty catalog has no max price");
+  for (i = 0; i < 1000; i++) {
+    product_columns_append(pc, "a fairly long product name", i, i);
+  }
+  TEST_CHECK_(product_columns_find_max_price(pc) == 999,
+    "max price index after growing is correct (%d == 999)",
+    (int)product_columns_find_max_price(pc));
+  TEST_CHECK_(strcmp(product_columns_name(pc, 999),
+    "a fairly long product name") == 0, "last name is correct");
+  free_product_columns(pc);
+}
+
+
+/*
+ * This function specifies a unit test for the vectorized kernels.  It
+ * specifically runs each kernel at every level the CPU supports, on inputs of
+ * many lengths that include ties and NaN values, and makes sure the argmax
+ * kernels agree exactly with the scalar level and the sum kernel agrees to
+ * within rounding.
+ */
+void test_simd_kernels() {
+  enum simd_level best = simd_get_level();
+  int n = 1000;
+  float* prices = malloc(n * sizeof(float));
+  int32_t* inventories = malloc(n * sizeof(int32_t));
+  int i, len, level;
+
+  srand(4);
+  for (i = 0; i < n; i++) {
+    prices[i] = (rand() % 50) / 4.0;
+    inventories[i] = rand() % 100 - 10;
+    if (i % 97 == 5) {
+      prices[i] = 0.0 / 0.0;
+    }
+  }
+
+  for (len = 0; len < n; len += 1 + len / 8) {
+    size_t max_price, max_investment;
+    double total;
+
+    simd_set_level(SIMD_SCALAR);
+    max_price = simd_argmax_f32(prices, len);
+    max_investment = simd_argmax_mul_i32_f32(inventories, prices, len);
+    total = simd_sum_mul_i32_f32(inventories, prices + 6, len > 6 ?
+      len - 6 : 0);
+
+    for (level = SIMD_SSE2; level <= SIMD_AVX2; level++) {
+      double t;
+      if (!simd_level_supported(level)) {
+        continue;
+      }
+      simd_set_level(level);
+      TEST_CHECK_(simd_argmax_f32(prices, len) == max_price,
+        "level %d max price index for %d prices is correct", level, len);
+      TEST_CHECK_(simd_argmax_mul_i32_f32(inventories, prices, len) ==
+        max_investment, "level %d max investment index for %d products is "
+        "correct", level, len);
+      t = simd_sum_mul_i32_f32(inventories, prices + 6, len > 6 ? len - 6 : 0);
+      TEST_CHECK_((t != t && total != total) ||
+        (t - total < 1e-6 && total - t < 1e-6),
+        "level %d total for %d products is correct (%f == %f)", level, len, t,
+        total);
+    }
+  }
+
+  simd_set_level(best);
+  free(inventories);
+  free(prices);
+}
+
+
+/*
+ * This function specifies a unit test for the string arena.  It specifically
+ * interns enough strings to fill several blocks and grow the hash set, makes
+ * sure equal strings come back as the same pointer and different strings as
+ * different pointers, and checks that earlier strings are left intact.
+ */
+void test_string_arena() {
+  struct string_arena* sa = string_arena_create();
+  const char* first[1000];
+  char buf[64];
+  char* big = malloc(100000);
+  const char* big_copy;
+  int i, ok = 1;
+
+  for (i = 0; i < 1000; i++) {
+    sprintf(buf, "product name number %d", i);
+    first[i] = string_arena_intern(sa, buf);
+  }
+  memset(big, 'x', 99999);
+  big[99999] = '\0';
+  big_copy = string_arena_intern(sa, big);
+
+  for (i = 0; i < 1000; i++) {
+    sprintf(buf, "product name number %d", i);
+    if (string_arena_intern(sa, buf) != first[i] || strcmp(first[i], buf)) {
+      ok = 0;
+    }
+  }
+  TEST_CHECK_(ok, "repeated strings return the original copies");
+  TEST_CHECK_(string_arena_intern(sa, big) == big_copy &&
+    strcmp(big_copy, big) == 0, "long string was interned");
+  TEST_CHECK_(string_arena_intern_n(sa, "product name number 12x", 22) ==
+    first[12], "length-delimited string matches NUL-terminated one");
+  TEST_CHECK_(string_arena_intern(sa, "") != NULL &&
+    string_arena_intern_n(sa, NULL, 0) == string_arena_intern(sa, ""),
+    "empty string was interned");
+  TEST_CHECK_(string_arena_count(sa) == 1002, "count is correct (%d == 1002)",
+    (int)string_arena_count(sa));
+
+  string_arena_free(sa);
+  free(big);
+}
+
+
+/*
+ * This function specifies a unit test for create_product_array_interned().
+ * It specifically builds two product arrays sharing one string arena and
+ * makes sure products with the same name share the same name pointer.
+ */
+void test_product_array_interned() {
+  char* names[] = { "apples", "soup", "apples", "milk" };
+  int inventories[] = { 7, 6, 3, 1 };
+  float prices[] = { 3.99, 1.99, 2.50, 4.50 };
+  struct string_arena* sa = string_arena_create();
+  struct dynarray* a = create_product_array_interned(4, names, inventories,
+    prices, sa);
+  struct dynarray* b = create_product_array_interned(4, names, inventories,
+    prices, sa);
+  struct product* p0 = dynarray_get(a, 0);
+  struct product* p2 = dynarray_get(a, 2);
+  struct product* q0 = dynarray_get(b, 0);
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    struct product* p = dynarray_get(a, i);
+    TEST_CHECK_(strcmp(p->name, names[i]) == 0 &&
+      p->inventory == inventories[i] && p->price == prices[i],
+      "%d'th product is correct", i);
+  }
+  TEST_CHECK_(p0->name == p2->name && p0->name == q0->name,
+    "equal names share storage");
+  TEST_CHECK_(string_arena_count(sa) == 3, "arena holds 3 names (%d == 3)",
+    (int)string_arena_count(sa));
+
+  free_product_array_interned(a);
+  free_product_array_interned(b);
+  string_arena_free(sa);
+}
+
+
+/*
+ * This function specifies a unit test for create_product_array_parallel().
+ * It specifically builds an array large enough to be split between several
+ * threads, with names repeated across the threads' ranges and one already in
+ * the arena, and makes sure every product is in place and equal names still
+ * share the arena's copy.
+ */
+void test_product_array_parallel() {
+  int n = 70000, i, ok = 1;
+  char** names;
+  int* inventories;
+  float* prices;
+  struct string_arena* sa = string_arena_create();
+  const char* existing = string_arena_intern(sa, "product 7");
+  struct dynarray* products;
+
+  _make_product_inputs(n, "product %d", 5000, &names, &inventories, &prices);
+  for (i = 0; i < n; i++) {
+    inventories[i] = i;
+    prices[i] = i / 4.0;
+  }
+  products = create_product_array_parallel(n, names, inventories, prices, sa,
+    4);
+
+  TEST_CHECK_(dynarray_length(products) == (size_t)n, "array holds %d products",
+    n);
+  for (i = 0; i < n && ok; i++) {
+    struct product* p = dynarray_get(products, i);
+    ok = strcmp(p->name, names[i]) == 0 && p->inventory == inventories[i] &&
+      p->price == prices[i] && p->name == string_arena_find(sa, names[i]);
+  }
+  TEST_CHECK_(ok, "every product is correct and interned");
+  TEST_CHECK_(((struct product*)dynarray_get(products, 7))->name == existing,
+    "name already in the arena was reused");
+  TEST_CHECK_(string_arena_count(sa) == 5000, "arena holds 5000 names (%d)",
+    (int)string_arena_count(sa));
+  TEST_CHECK_(string_arena_find(sa, "product 5000") == NULL,
+    "missing name isn't found");
+
+  free_product_array_interned(products);
+  string_arena_free(sa);
+  _free_product_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * This function specifies a unit test for load_product_array_tsv().  It
+ * specifically writes a file in print_products() format, including an empty
+ * line, a CRLF line ending and a last line without a newline, loads it with
+ * several threads so that chunk boundaries fall in the middle of lines, and
+ * makes sure every product comes back in order, with equal names sharing one
+ * interned copy even when they were parsed by different threads or already
+ * in the arena.  It also makes sure missing files and files with malformed
+ * numbers are rejected.
+ */
+void test_load_product_array_tsv() {
+  const char* path = "products_test.tsv";
+  struct string_arena* sa = string_arena_create();
+  struct dynarray* products;
+  FILE* f;
+  char name[32];
+  const char* malformed[] = {"apples\t7\t3.99\nsoup\tsix\t1.99\n",
+    "soup\t6x\t1.99\n", "soup\t6\t1.99x\n", "soup\t 6\t1.99\n",
+    "soup\t6\t 1.99\n", "soup\t6\t\n", "soup\t99999999999\t1.99\n",
+    "soup\t6\t1e39\n", "soup\t6\n"};
+  const char* first_names[37];
+  size_t i, j, n = 500;
+  int ok = 1;
+
+  f = fopen(path, "w");
+  for (i = 0; i < n; i++) {
+    sprintf(name, "product %d", (int)(i % 37));
+    fprintf(f, "%s\t%d\t%f%s", name, (int)i - 100, i / 8.0,
+      i == 10 ? "\r\n\n" : i == n - 1 ? "" : "\n");
+  }
+  fclose(f);
+
+  products = load_product_array_tsv(path, sa, 7);
+  TEST_CHECK_(products != NULL, "file was loaded");
+  if (products) {
+    TEST_CHECK_(dynarray_length(products) == n, "length is correct "
+      "(%d == %d)", (int)dynarray_length(products), (int)n);
+    for (i = 0; i < n && i < dynarray_length(products); i++) {
+      struct product* p = dynarray_get(products, i);
+      sprintf(name, "product %d", (int)(i % 37));
+      if (strcmp(p->name, name) || p->inventory != (int)i - 100 ||
+          p->price != (float)(i / 8.0)) {
+        ok = 0;
+      }
+    }
+    TEST_CHECK_(ok, "all products are correct");
+    TEST_CHECK_(string_arena_count(sa) == 37, "names were interned "
+      "(%d == 37)", (int)string_arena_count(sa));
+    for (i = 0; i < 37 && i < dynarray_length(products); i++) {
+      first_names[i] = ((struct product*)dynarray_get(products, i))->name;
+    }
+    for (i = 37, ok = 1; i < dynarray_length(products); i++) {
+      struct product* p = dynarray_get(products, i);
+      ok = ok && p->name == first_names[i % 37];
+    }
+    TEST_CHECK_(ok, "equal names share one copy");
+    free_product_array_interned(products);
+
+    /*
+     * Loading the file again should reuse the names already in the arena.
+     */
+    products = load_product_array_tsv(path, sa, 7);
+    TEST_CHECK_(products != NULL, "file was loaded again");
+    for (i = 0, ok = products != NULL; ok &&
+        i < dynarray_length(products); i++) {
+      struct product* p = dynarray_get(products, i);
+      ok = p->name == first_names[i % 37];
+    }
+    TEST_CHECK_(ok, "names already in the arena were reused");
+    TEST_CHECK_(string_arena_count(sa) == 37, "no names were added "
+      "(%d == 37)", (int)string_arena_count(sa));
+    if (products) {
+      free_product_array_interned(products);
+    }
+  }
+
+  for (j = 0; j < sizeof(malformed) / sizeof(malformed[0]); j++) {
+    f = fopen(path, "w");
+    fputs(malformed[j], f);
+    fclose(f);
+    TEST_CHECK_(load_product_array_tsv(path, sa, 2) == NULL,
+      "malformed file %d was rejected", (int)j);
+  }
+
+  remove(path);
+  TEST_CHECK_(load_product_array_tsv(path, sa, 2) == NULL,
+    "missing file was rejected");
+  string_arena_free(sa);
+}
+
+
+/*
+ * This function specifies a unit test for save_products_binary() and
+ * load_products_binary().  It specifically saves an array of pointers and an
+ * array of records, reloads each with verification and makes sure every
+ * product comes back unchanged, including through product_snapshot_array().
+ * It also makes sure saving over a snapshot leaves one that's already loaded
+ * intact, that a corrupted byte is caught only when verification is asked
+ * for, and that missing files are rejected.
+ */
+void test_products_binary_snapshot() {
+  const char* path = "products_test.snap";
+  char* names[] = {"apples", "", "soup", "apples"};
+  int inventories[] = {7, 0, -3, 12};
+  float prices[] = {3.99, 0.5, 1.25, 4.0};
+  struct string_arena* sa = string_arena_create();
+  struct dynarray* arrays[2];
+  struct product_snapshot* ps;
+  FILE* f;
+  int i, j, ok;
+
+  arrays[0] = create_product_array(4, names, inventories, prices);
+  arrays[1] = create_product_array_interned(4, names, inventories, prices, sa);
+  for (j = 0; j < 2; j++) {
+    TEST_CHECK_(save_products_binary(arrays[j], path) == 0,
+      "array %d was saved", j);
+    ps = load_products_binary(path, 1);
+    TEST_CHECK_(ps != NULL, "array %d was loaded", j);
+    if (!ps) {
+      continue;
+    }
+    TEST_CHECK_(product_snapshot_length(ps) == 4, "length is correct "
+      "(%d == 4)", (int)product_snapshot_length(ps));
+    struct dynarray* copy = product_snapshot_array(ps);
+    ok = dynarray_length(copy) == 4;
+    for (i = 0; i < 4 && ok; i++) {
+      struct product* p = dynarray_get(copy, i);
+      const char* name = product_snapshot_name(ps, i);
+      if (!name || strcmp(name, names[i]) || strcmp(p->name, names[i]) ||
+          product_snapshot_inventory(ps, i) != inventories[i] ||
+          p->inventory != inventories[i] ||
+          product_snapshot_price(ps, i) != prices[i] ||
+          p->price != prices[i]) {
+        ok = 0;
+      }
+    }
+    TEST_CHECK_(ok, "all products in array %d are correct", j);
+    free_product_array_interned(copy);
+    product_snapshot_close(ps);
+  }
+
+  /*
+   * The new snapshot replaces the old file rather than overwriting it, so the
+   * loaded one still sees all 4 products.
+   */
+  ps = load_products_binary(path, 1);
+  TEST_CHECK_(ps != NULL, "snapshot was loaded before being replaced");
+  if (ps) {
+    struct dynarray* fewer = create_product_array(2, names + 2,
+      inventories + 2, prices + 2);
+    TEST_CHECK_(save_products_binary(fewer, path) == 0,
+      "snapshot was replaced");
+    TEST_CHECK_(product_snapshot_length(ps) == 4 &&
+      strcmp(product_snapshot_name(ps, 3), "apples") == 0 &&
+      product_snapshot_inventory(ps, 3) == 12,
+      "replaced snapshot is still intact");
+    TEST_CHECK_(access("products_test.snap.tmp", F_OK) != 0,
+      "temporary file was renamed");
+    product_snapshot_close(ps);
+    free_product_array(fewer);
+    ps = load_products_binary(path, 1);
+    TEST_CHECK_(ps && product_snapshot_length(ps) == 2,
+      "replacement snapshot was loaded");
+    if (ps) {
+      product_snapshot_close(ps);
+    }
+  }
+
+  f = fopen(path, "r+b");
+  fseek(f, -3, SEEK_END);
+  fputc('x', f);
+  fclose(f);
+  TEST_CHECK_(load_products_binary(path, 1) == NULL,
+    "corrupted file was rejected");
+  ps = load_products_binary(path, 0);
+  TEST_CHECK_(ps != NULL, "corrupted file was loaded without verification");
+  if (ps) {
+    product_snapshot_close(ps);
+  }
+
+  remove(path);
+  TEST_CHECK_(load_products_binary(path, 0) == NULL,
+    "missing file was rejected");
+  free_product_array(arrays[0]);
+  free_product_array_interned(arrays[1]);
+  string_arena_free(sa);
+}
+
+
+/*
+ * Auxilliary function to read a whole file into a newly allocated,
+ * NUL-terminated string.
+ */
+char* _read_file(const char* path) {
+  FILE* f = fopen(path, "rb");
+  long size;
+  char* data;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc(size + 1);
+  data[fread(data, 1, size, f)] = '\0';
+  fclose(f);
+  return data;
+}
+
+
+/*
+ * This function specifies a unit test for write_products_tsv() and
+ * write_products_tsv_fd().  It specifically writes products whose prices
+ * are random bit patterns, along with tricky values like negative zero,
+ * halfway cases, huge prices and NaN, and makes sure both functions produce
+ * exactly what fprintf() with print_products()' format does.
+ */
+void test_write_products_tsv() {
+  const char* expected_path = "products_expected.tsv";
+  const char* path = "products_test.tsv";
+  float special[] = {0.0, -0.0, 0.5e-6, 2.5e-6, -1e-9, 0.1, 1e12, 9.99e11,
+    -123456.789, 3.4e38, INFINITY, -INFINITY, NAN};
+  int n = 20000, num_special = sizeof(special) / sizeof(special[0]);
+  char** names;
+  int* inventories;
+  float* prices;
+  size_t long_size = 100000;
+  char* long_name = malloc(long_size);
+  struct dynarray* products;
+  char *expected, *actual;
+  FILE* f;
+  int i, fd;
+
+  memset(long_name, 'x', long_size - 1);
+  long_name[long_size - 1] = '\0';
+  srand(3);
+  _make_product_inputs(n, "apples", 1, &names, &inventories, &prices);
+  for (i = 0; i < n; i++) {
+    uint32_t bits = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+    if (i == n / 2) {
+      free(names[i]);
+      names[i] = long_name;
+    } else if (i % 2 == 0) {
+      names[i][0] = '\0';
+    }
+    inventories[i] = i == 0 ? INT_MIN : i == 1 ? INT_MAX : rand() - rand();
+    if (i < num_special) {
+      prices[i] = special[i];
+    } else if (i % 2) {
+      memcpy(&prices[i], &bits, sizeof(float));
+    } else {
+      prices[i] = (rand() % 2000000 - 1000000) / 64.0;
+    }
+  }
+  products = create_product_array_inline(n, names, inventories, prices);
+
+  f = fopen(expected_path, "w");
+  for (i = 0; i < n; i++) {
+    fprintf(f, "%s\t%d\t%f\n", names[i], inventories[i], prices[i]);
+  }
+  fclose(f);
+  expected = _read_file(expected_path);
+
+  f = fopen(path, "w");
+  TEST_CHECK_(write_products_tsv(products, f) == 0, "stream write succeeded");
+  fclose(f);
+  actual = _read_file(path);
+  TEST_CHECK_(strcmp(actual, expected) == 0, "stream output matches printf");
+  free(actual);
+
+  fd = open(path, O_WRONLY | O_TRUNC);
+  TEST_CHECK_(write_products_tsv_fd(products, fd) == 0, "fd write succeeded");
+  close(fd);
+  actual = _read_file(path);
+  TEST_CHECK_(strcmp(actual, expected) == 0, "fd output matches printf");
+  free(actual);
+
+  remove(path);
+  remove(expected_path);
+  free(expected);
+  free_product_array(products);
+  _free_product_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Entry used to sort products into the reference order for top-k queries.
+ */
+struct top_k_ref {
+  float score;
+  size_t index;
+};
+
+int _compare_top_k_ref(const void* a, const void* b) {
+  const struct top_k_ref* ra = a;
+  const struct top_k_ref* rb = b;
+  if (ra->score != rb->score) {
+    return ra->score > rb->score ? -1 : 1;
+  }
+  return (ra->index > rb->index) - (ra->index < rb->index);
+}
+
+
+/*
+ * This function specifies a unit test for the top-k queries.  It
+ * specifically builds an array large enough to be split between several
+ * threads, with many tied prices and investments, and makes sure every query
+ * returns exactly the first k products of a full sort by descending score and
+ * ascending index, for k of 0, 1, 100 and more than the array's length.  It
+ * also checks how the top product relates to find_max_price(), including when
+ * the first price is NaN.
+ */
+void test_find_top_k() {
+  size_t n = 300000, ks[] = {0, 1, 100, 300010};
+  char** names;
+  int* inventories;
+  float* prices;
+  struct top_k_ref* ref = malloc(n * sizeof(struct top_k_ref));
+  struct product** out = malloc(ks[3] * sizeof(struct product*));
+  struct dynarray* products;
+  size_t i, j, count;
+  int investment, parallel, ok;
+
+  srand(4);
+  _make_product_inputs(n, "product", 1, &names, &inventories, &prices);
+  for (i = 0; i < n; i++) {
+    inventories[i] = rand() % 50 - 10;
+    prices[i] = (rand() % 1000) / 4.0;
+  }
+  products = create_product_array(n, names, inventories, prices);
+
+  for (investment = 0; investment < 2; investment++) {
+    for (i = 0; i < n; i++) {
+      ref[i].score = investment ? inventories[i] * prices[i] : prices[i];
+      ref[i].index = i;
+    }
+    qsort(ref, n, sizeof(struct top_k_ref), _compare_top_k_ref);
+    for (parallel = 0; parallel < 2; parallel++) {
+      for (j = 0; j < sizeof(ks) / sizeof(ks[0]); j++) {
+        if (investment) {
+          count = parallel ?
+            find_top_k_by_investment_parallel(products, ks[j], out, 4) :
+            find_top_k_by_investment(products, ks[j], out);
+        } else {
+          count = parallel ?
+            find_top_k_by_price_parallel(products, ks[j], out, 4) :
+            find_top_k_by_price(products, ks[j], out);
+        }
+        ok = count == (ks[j] < n ? ks[j] : n);
+        for (i = 0; i < count && ok; i++) {
+          ok = out[i] == dynarray_get(products, ref[i].index);
+        }
+        TEST_CHECK_(ok, "top %d by %s%s is correct", (int)ks[j],
+          investment ? "investment" : "price", parallel ? " in parallel" : "");
+      }
+    }
+  }
+  TEST_CHECK_(find_top_k_by_price(products, 1, out) == 1 &&
+    out[0] == find_max_price(products), "top 1 is find_max_price()");
+
+  /*
+   * A NaN price ranks last for the top-k queries, but find_max_price() never
+   * replaces a first product whose price is NaN.
+   */
+  ((struct product*)dynarray_get(products, 0))->price = NAN;
+  for (i = 2, j = 1; i < n; i++) {
+    j = prices[i] > prices[j] ? i : j;
+  }
+  TEST_CHECK_(find_top_k_by_price(products, 1, out) == 1 &&
+    out[0] == dynarray_get(products, j) &&
+    find_max_price(products) == dynarray_get(products, 0),
+    "top 1 skips a NaN first price that find_max_price() returns");
+
+  free_product_array(products);
+  free(out);
+  free(ref);
+  _free_product_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Auxilliary function to find a product by name by scanning an array.
+ */
+size_t _scan_for_name(struct dynarray* products, const char* name) {
+  size_t i;
+  for (i = 0; i < dynarray_length(products); i++) {
+    if (strcmp(((struct product*)dynarray_get(products, i))->name, name) == 0) {
+      return i;
+    }
+  }
+  return PRODUCT_INDEX_NONE;
+}
+
+
+/*
+ * This function specifies a unit test for the product index.  It
+ * specifically runs a long random sequence of inserts and removes on indexes
+ * over an array of pointers and an array of records, checking every lookup
+ * against a scan of the array, and makes sure duplicate names are rejected
+ * both when building an index and when inserting into one.
+ */
+void test_product_index() {
+  char* names[] = {"apples", "soup", "bread", "apples"};
+  int inventories[] = {1, 2, 3, 4};
+  float prices[] = {1.0, 2.0, 3.0, 4.0};
+  int n = 2000, steps = 20000, inline_array, i, ok;
+  char** keys = malloc(n * sizeof(char*));
+  struct dynarray* products;
+  struct product_index* pi;
+  struct product p;
+
+  products = create_product_array(4, names, inventories, prices);
+  TEST_CHECK_(product_index_build(products) == NULL,
+    "duplicate names were rejected");
+  free_product_array(products);
+
+  for (i = 0; i < n; i++) {
+    keys[i] = malloc(16);
+    sprintf(keys[i], "product %d", i);
+  }
+
+  for (inline_array = 0; inline_array < 2; inline_array++) {
+    products = inline_array ?
+      create_product_array_inline(3, names, inventories, prices) :
+      create_product_array(3, names, inventories, prices);
+    pi = product_index_build(products);
+    TEST_CHECK_(pi != NULL, "index was built");
+    TEST_CHECK_(product_index_find(pi, "soup") == dynarray_get(products, 1),
+      "built product was found");
+
+    p.name = "soup";
+    p.inventory = 7;
+    p.price = 7.0;
+    TEST_CHECK_(product_index_insert(pi, &p) == -1,
+      "duplicate insert was rejected");
+
+    srand(5);
+    ok = 1;
+    for (i = 0; i < steps && ok; i++) {
+      char* key = keys[rand() % n];
+      size_t expected = _scan_for_name(products, key);
+      if (product_index_lookup(pi, key) != expected) {
+        ok = 0;
+      } else if (expected == PRODUCT_INDEX_NONE) {
+        if (inline_array) {
+          p.name = malloc(strlen(key) + 1);
+          strcpy(p.name, key);
+          p.inventory = i;
+          p.price = i;
+          ok = product_index_insert(pi, &p) == 0;
+        } else {
+          ok = product_index_insert(pi, create_product(key, i, i)) == 0;
+        }
+      } else {
+        /*
+         * The removed product's memory is freed once it's out of the array,
+         * which for record arrays means just its name.
+         */
+        struct product* found = product_index_find(pi, key);
+        char* name = found->name;
+        ok = product_index_remove(pi, key) == 0;
+        if (inline_array) {
+          free(name);
+        } else {
+          free_product(found);
+        }
+      }
+      ok = ok && product_index_count(pi) == dynarray_length(products);
+    }
+    TEST_CHECK_(ok, "index stayed in sync with the %s array",
+      inline_array ? "record" : "pointer");
+    TEST_CHECK_(product_index_remove(pi, "no such product") == -1,
+      "removing a missing product failed");
+
+    product_index_free(pi);
+    free_product_array(products);
+  }
+
+  for (i = 0; i < n; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
+
+
+/*
+ * Auxilliary function to return whether a comparison holds, for checking the
+ * filter kernels.
+ */
+int _compare_with(double x, enum simd_cmp op, double v) {
+  switch (op) {
+    case SIMD_CMP_LT: return x < v;
+    case SIMD_CMP_LE: return x <= v;
+    case SIMD_CMP_GT: return x > v;
+    case SIMD_CMP_GE: return x >= v;
+    case SIMD_CMP_EQ: return x == v;
+    default: return x != v;
+  }
+}
+
+
+/*
+ * This function specifies a unit test for product filters.  It specifically
+ * runs filters with every comparison on both columns, alone and combined,
+ * over catalogs whose lengths aren't multiples of 64 and whose prices include
+ * NaN values, at every SIMD level the CPU supports and with several threads,
+ * and makes sure the bitmaps, counts and index lists agree with a scalar loop.
+ */
+void test_product_filter() {
+  size_t lengths[] = {0, 1, 200, 4096 + 37, 300001};
+  size_t max_n = 300001, i, l, count, expected;
+  char** names = malloc(max_n * sizeof(char*));
+  int* inventories = malloc(max_n * sizeof(int));
+  float* prices = malloc(max_n * sizeof(float));
+  uint64_t* bitmap = malloc(PRODUCT_FILTER_WORDS(max_n) * sizeof(uint64_t));
+  size_t* indices = malloc(max_n * sizeof(size_t));
+  enum simd_level best = simd_get_level();
+  int level, op, threads, ok = 1;
+
+  srand(6);
+  for (i = 0; i < max_n; i++) {
+    names[i] = "product";
+    inventories[i] = rand() % 40 - 20;
+    prices[i] = i % 97 == 0 ? NAN : (rand() % 200) / 2.0;
+  }
+
+  for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+    size_t n = lengths[l];
+    struct product_columns* pc =
+      create_product_columns(n, names, inventories, prices);
+    for (op = SIMD_CMP_LT; op <= SIMD_CMP_NE; op++) {
+      struct product_filter* pf = product_filter_create();
+      product_filter_add_inventory(pf, op, 3);
+      product_filter_add_price(pf, (op + 2) % 6, 50.0);
+      if (op == SIMD_CMP_EQ) {
+        product_filter_add_price(pf, SIMD_CMP_NE, 75.5);
+      }
+      expected = 0;
+      for (i = 0; i < n; i++) {
+        expected += _compare_with(inventories[i], op, 3) &&
+          _compare_with(prices[i], (op + 2) % 6, 50.0) &&
+          (op != SIMD_CMP_EQ || prices[i] != (float)75.5);
+      }
+      for (level = SIMD_SCALAR; level <= SIMD_AVX2; level++) {
+        if (!simd_level_supported(level)) {
+          continue;
+        }
+        simd_set_level(level);
+        for (threads = 1; threads <= 4; threads += 3) {
+          count = product_filter_run(pf, pc, bitmap, threads);
+          ok = ok && count == expected;
+          for (i = 0; i < PRODUCT_FILTER_WORDS(n) * 64 && ok; i++) {
+            int bit = bitmap[i / 64] >> (i % 64) & 1;
+            ok = bit == (i < n && _compare_with(inventories[i], op, 3) &&
+              _compare_with(prices[i], (op + 2) % 6, 50.0) &&
+              (op != SIMD_CMP_EQ || prices[i] != (float)75.5));
+          }
+          count = product_filter_select(pf, pc, indices, threads);
+          ok = ok && count == expected;
+          for (i = 0; i + 1 < count && ok; i++) {
+            ok = indices[i] < indices[i + 1];
+          }
+        }
+      }
+      simd_set_level(best);
+      TEST_CHECK_(ok, "filter %d over %d products is correct", op, (int)n);
+      product_filter_free(pf);
+    }
+
+    struct product_filter* all = product_filter_create();
+    TEST_CHECK_(product_filter_run(all, pc, bitmap, 1) == n,
+      "empty filter matches all %d products", (int)n);
+    product_filter_free(all);
+    free_product_columns(pc);
+  }
+
+  free(indices);
+  free(bitmap);
+  free(prices);
+  free(inventories);
+  free(names);
+}
+
+
+/*
+ * Auxilliary function to check that a catalog is sorted by inventory and
+ * then address, and that its maximums match find_max_price() and
+ * find_max_investment() over an array holding its products in order.
+ */
+int _check_catalog(struct product_catalog* catalog) {
+  struct dynarray* products = dynarray_create();
+  size_t i, n = product_catalog_length(catalog);
+  int ok = 1;
+  for (i = 0; i < n; i++) {
+    struct product* p = product_catalog_get(catalog, i);
+    if (i > 0) {
+      struct product* prev = product_catalog_get(catalog, i - 1);
+      ok = ok && (prev->inventory < p->inventory ||
+        (prev->inventory == p->inventory && prev < p));
+    }
+    dynarray_insert(products, DYNARRAY_END, p);
+  }
+  ok = ok && product_catalog_max_price(catalog) == find_max_price(products);
+  ok = ok && product_catalog_max_investment(catalog) ==
+    find_max_investment(products);
+  dynarray_free(products);
+  return ok;
+}
+
+
+/*
+ * This function specifies a unit test for the sorted product catalog.  It
+ * specifically makes a long random sequence of inventory updates, insertions
+ * and removals on products with many tied inventories, prices and
+ * investments, and after every step makes sure the catalog is still sorted
+ * and its maximums are the ones a full scan finds.  It also grows a catalog
+ * from empty and empties it again.
+ */
+void test_product_catalog() {
+  int n = 300, steps = 5000, i, ok = 1;
+  char** names;
+  int* inventories;
+  float* prices;
+  char* in_catalog = malloc(n);
+  struct dynarray *products, *empty;
+  struct product_catalog* catalog;
+  struct product outsider = {"outsider", 1, 1.0};
+
+  srand(7);
+  _make_product_inputs(n, "product", 1, &names, &inventories, &prices);
+  for (i = 0; i < n; i++) {
+    inventories[i] = rand() % 20;
+    prices[i] = rand() % 8;
+    in_catalog[i] = 1;
+  }
+  products = create_product_array(n, names, inventories, prices);
+  catalog = product_catalog_create(products);
+  TEST_CHECK_(_check_catalog(catalog), "new catalog is correct");
+
+  for (i = 0; i < steps && ok; i++) {
+    int j = rand() % n, action = rand() % 10;
+    struct product* p = dynarray_get(products, j);
+    if (action == 0 && in_catalog[j]) {
+      ok = product_catalog_remove(catalog, p) == 0;
+      in_catalog[j] = 0;
+    } else if (action == 0) {
+      p->inventory = rand() % 20;
+      product_catalog_insert(catalog, p);
+      in_catalog[j] = 1;
+    } else if (in_catalog[j]) {
+      ok = product_update_inventory(catalog, p, rand() % 20) == 0;
+    } else {
+      ok = product_update_inventory(catalog, p, 3) == -1;
+    }
+    ok = ok && _check_catalog(catalog);
+  }
+  TEST_CHECK_(ok, "catalog stayed sorted with correct maximums");
+  TEST_CHECK_(product_catalog_remove(catalog, &outsider) == -1,
+    "removing a missing product failed");
+  product_catalog_free(catalog);
+
+  /*
+   * Grow a catalog from empty, so its maximums have to keep up as it
+   * outgrows their trees, then empty it again.
+   */
+  empty = dynarray_create();
+  catalog = product_catalog_create(empty);
+  dynarray_free(empty);
+  TEST_CHECK_(product_catalog_max_price(catalog) == NULL &&
+    product_catalog_max_investment(catalog) == NULL,
+    "empty catalog has no maximums");
+  for (i = 0, ok = 1; i < n && ok; i++) {
+    product_catalog_insert(catalog, dynarray_get(products, i));
+    ok = _check_catalog(catalog);
+  }
+  for (i = 0; i < n && ok; i++) {
+    ok = product_catalog_remove(catalog, dynarray_get(products, i)) == 0 &&
+      _check_catalog(catalog);
+  }
+  TEST_CHECK_(ok, "growing and emptying catalog kept correct maximums");
+  TEST_CHECK_(product_catalog_max_price(catalog) == NULL,
+    "emptied catalog has no maximums");
+
+  product_catalog_free(catalog);
+  free_product_array(products);
+  free(in_catalog);
+  _free_product_inputs(n, names, inventories, prices);
+}
+
+
+/*
+ * Comparison function for qsort() to sort floats into ascending order.
+ */
+int _compare_floats(const void* a, const void* b) {
+  float fa = *(const float*)a, fb = *(const float*)b;
+  return fa < fb ? -1 : fa > fb;
+}
+
+
+void test_product_sketch() {
+  int n = 20000, half = n / 2, i, j, ok = 1;
+  char** names;
+  int* inventories;
+  float* prices;
+  float* sorted = malloc(n * sizeof(float));
+  uint64_t expected[12] = {0};
+  double qs[] = {0.01, 0.5, 0.9, 0.99};
+  struct dynarray *first, *second;
+  struct quantile_sketch *sketch, *shard;
+  struct histogram *hist, *other;
+
+  srand(11);
+  _make_product_inputs(n, "product", 1, &names, &inventories, &prices);
+  for (i = 0; i < n; i++) {
+    inventories[i] = rand() % 120 - 10;
+    prices[i] = (rand() % 4000) / 4.0;
+    sorted[i] = prices[i];
+    expected[inventories[i] < 0 ? 0 : inventories[i] >= 100 ? 11 :
+      1 + inventories[i] / 10]++;
+  }
+  qsort(sorted, n, sizeof(float), _compare_floats);
+  first = create_product_array(half, names, inventories, prices);
+  second = create_product_array(n - half, names + half, inventories + half,
+    prices + half);
+
+  /*
+   * Build a sketch over each half of the products, as two shards would, and
+   * check the merged sketch's quantiles against the exact ones.
+   */
+  sketch = quantile_sketch_create(QUANTILE_SKETCH_DEFAULT_K);
+  shard = quantile_sketch_create(QUANTILE_SKETCH_DEFAULT_K);
+  TEST_CHECK_(isnan(quantile_sketch_quantile(sketch, 0.5)),
+    "empty sketch has no median");
+  quantile_sketch_add_prices(sketch, first);
+  quantile_sketch_add_prices(shard, second);
+  quantile_sketch_add(shard, NAN);
+  quantile_sketch_merge(sketch, shard);
+  TEST_CHECK_(quantile_sketch_count(sketch) == (uint64_t)n,
+    "merged sketch counted %d prices", n);
+  TEST_CHECK_(quantile_sketch_quantile(sketch, 0.0) == sorted[0] &&
+    quantile_sketch_quantile(sketch, 1.0) == sorted[n - 1],
+    "merged sketch has exact minimum and maximum");
+  for (j = 0; j < 4; j++) {
+    float estimate = quantile_sketch_quantile(sketch, qs[j]);
+    int lo = 0, hi = 0;
+    while (lo < n && sorted[lo] < estimate) {
+      lo++;
+    }
+    for (hi = lo; hi < n && sorted[hi] <= estimate; hi++);
+    ok = ok && (double)lo / n <= qs[j] + 0.02 &&
+      (double)hi / n >= qs[j] - 0.02;
+  }
+  TEST_CHECK_(ok, "estimated quantiles within 2%% of their ranks");
+
+  /*
+   * Histograms are exact, so their counts must match a direct count.
+   */
+  hist = histogram_create(0, 100, 10);
+  other = histogram_create(0, 100, 10);
+  histogram_add_inventories(hist, first);
+  histogram_add_inventories(other, second);
+  histogram_merge(hist, other);
+  ok = histogram_underflow(hist) == expected[0] &&
+    histogram_overflow(hist) == expected[11] &&
+    histogram_count(hist) == (uint64_t)n;
+  for (j = 0; j < 10; j++) {
+    ok = ok && histogram_bucket(hist, j) == expected[j + 1];
+  }
+  TEST_CHECK_(ok, "merged histogram counts match");
+  histogram_remove(hist, 55);
+  histogram_add(hist, 99.5);
+  TEST_CHECK_(histogram_bucket(hist, 5) == expected[6] - 1 &&
+    histogram_bucket(hist, 9) == expected[10] + 1,
+    "histogram updated in place");
+
+  histogram_free(other);
+  histogram_free(hist);
+  quantile_sketch_free(shard);
+  quantile_sketch_free(sketch);
+  free_product_array(second);
+  free_product_array(first);
+  free(sorted);
+  _free_product_inputs(n, names, inventories, prices);
+}
+
+
+/****************************************************************************
+ **
+ ** Test listing
+ **
+ ****************************************************************************/
+
+TEST_LIST = {
+  { "cdynarray_concurrent_push_back", test_cdynarray_concurrent_push_back },
+  { "dynarray_sort", test_dynarray_sort },
+  { "dynarray_stable_sort", test_dynarray_stable_sort },
+  { "dynarray_parallel_sort", test_dynarray_parallel_sort },
+  { "dynarray_radix_sort", test_dynarray_radix_sort },
+  { "sort_by_inventory_price_name", test_sort_by_inventory_price_name },
+  { "product_columns", test_product_columns },
+  { "simd_kernels", test_simd_kernels },
+  { "string_arena", test_string_arena },
+  { "product_array_interned", test_product_array_interned },
+  { "product_array_parallel", test_product_array_parallel },
+  { "load_product_array_tsv", test_load_product_array_tsv },
+  { "products_binary_snapshot", test_products_binary_snapshot },
+  { "write_products_tsv", test_write_products_tsv },
+  { "find_top_k", test_find_top_k },
+  { "product_index", test_product_index },
+  { "product_filter", test_product_filter },
+  { "product_catalog", test_product_catalog },
+  { "product_sketch", test_product_sketch },
+  { NULL, NULL }
+};
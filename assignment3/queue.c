@@ -17,14 +17,22 @@
 struct queue {
   struct node* first;
   struct node* last;
+  struct allocator alloc;
 };
 
 
 struct queue* queue_create() {
-  struct queue* queue = malloc(sizeof(struct queue));
+  return queue_create_with_alloc(&system_allocator);
+}
+
+
+struct queue* queue_create_with_alloc(const struct allocator* alloc) {
+  assert(alloc);
+  struct queue* queue = alloc->alloc(alloc->ctx, sizeof(struct queue));
   assert(queue);
   queue->first = NULL;
   queue->last = NULL;
+  queue->alloc = *alloc;
   return queue;
 }
 
@@ -39,7 +47,7 @@ void queue_free(struct queue* queue) {
   while (!queue_isempty(queue)) {
     queue_dequeue(queue);
   }
-  free(queue);
+  queue->alloc.release(queue->alloc.ctx, queue, sizeof(struct queue));
 }
 
 
@@ -51,7 +59,8 @@ int queue_isempty(struct queue* queue) {
 
 void queue_enqueue(struct queue* queue, int value) {
   assert(queue);
-  struct node* new_node = malloc(sizeof(struct node));
+  struct node* new_node = queue->alloc.alloc(queue->alloc.ctx,
+    sizeof(struct node));
   assert(new_node);
 
   /*
@@ -96,6 +105,6 @@ int queue_dequeue(struct queue* queue) {
     queue->last = NULL;
   }
 
-  free(dequeued_first);
+  queue->alloc.release(queue->alloc.ctx, dequeued_first, sizeof(struct node));
   return value;
 }
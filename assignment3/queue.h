@@ -5,6 +5,8 @@
 #ifndef __QUEUE_H
 #define __QUEUE_H
 
+#include "allocator.h"
+
 /*
  * Structure used to represent a queue.
  */
@@ -15,6 +17,16 @@ struct queue;
  */
 struct queue* queue_create();
 
+/*
+ * Creates a new, empty queue whose memory, including the memory for each of its
+ * nodes, comes from a given allocator (see allocator.h), and returns a pointer
+ * to it.
+ *
+ * Params:
+ *   alloc - the allocator to be used by the new queue.  May not be NULL.
+ */
+struct queue* queue_create_with_alloc(const struct allocator* alloc);
+
 /*
  * Free all of the memory associated with a queue.
  *
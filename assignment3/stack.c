@@ -15,13 +15,21 @@
  */
 struct stack {
   struct node* top;
+  struct allocator alloc;
 };
 
 
 struct stack* stack_create() {
-  struct stack* stack = malloc(sizeof(struct stack));
+  return stack_create_with_alloc(&system_allocator);
+}
+
+
+struct stack* stack_create_with_alloc(const struct allocator* alloc) {
+  assert(alloc);
+  struct stack* stack = alloc->alloc(alloc->ctx, sizeof(struct stack));
   assert(stack);
   stack->top = NULL;
+  stack->alloc = *alloc;
   return stack;
 }
 
@@ -36,7 +44,7 @@ void stack_free(struct stack* stack) {
   while (!stack_isempty(stack)) {
     stack_pop(stack);
   }
-  free(stack);
+  stack->alloc.release(stack->alloc.ctx, stack, sizeof(struct stack));
 }
 
 
@@ -48,7 +56,8 @@ int stack_isempty(struct stack* stack) {
 
 void stack_push(struct stack* stack, int value) {
   assert(stack);
-  struct node* new_node = malloc(sizeof(struct node));
+  struct node* new_node = stack->alloc.alloc(stack->alloc.ctx,
+    sizeof(struct node));
   assert(new_node);
 
   /*
@@ -77,7 +86,7 @@ int stack_pop(struct stack* stack) {
   struct node* popped_top = stack->top;
   int value = popped_top->value;
   stack->top = popped_top->next;
-  free(popped_top);
+  stack->alloc.release(stack->alloc.ctx, popped_top, sizeof(struct node));
 
   return value;
 }
@@ -592,6 +592,141 @@ void test_stack_from_queues_push_multiple() {
 }
 
 
+/****************************************************************************
+ **
+ ** Allocator tests
+ **
+ ****************************************************************************/
+
+
+/*
+ * This function specifies a unit test for arenas.  It specifically makes sure
+ * that releasing the most recent allocation through arena_allocator() rolls
+ * it back so the next allocation reuses its memory, that releasing an older
+ * allocation doesn't, that the most recent allocation is resized in place,
+ * and that arena_reset() starts handing out the arena's first block again.
+ */
+void test_arena_rollback() {
+  struct arena* arena = arena_create(256);
+  struct allocator alloc = arena_allocator(arena);
+  char *first, *a, *b, *c;
+
+  first = alloc.alloc(alloc.ctx, 16);
+  a = alloc.alloc(alloc.ctx, 16);
+  alloc.release(alloc.ctx, a, 16);
+  b = alloc.alloc(alloc.ctx, 16);
+  TEST_CHECK_(b == a, "most recent allocation was rolled back");
+
+  alloc.alloc(alloc.ctx, 16);
+  alloc.release(alloc.ctx, b, 16);
+  TEST_CHECK_(alloc.alloc(alloc.ctx, 16) != b,
+    "older allocation was not rolled back");
+
+  c = alloc.alloc(alloc.ctx, 16);
+  c[0] = 'x';
+  TEST_CHECK_(alloc.resize(alloc.ctx, c, 16, 48) == c,
+    "most recent allocation was resized in place");
+  c = alloc.resize(alloc.ctx, c, 48, 1024);
+  TEST_CHECK_(c[0] == 'x', "contents survived resize into a new block");
+
+  arena_reset(arena);
+  TEST_CHECK_(arena_alloc(arena, 16) == first,
+    "reset arena reuses its first block");
+  arena_free(arena);
+}
+
+
+/*
+ * This function specifies a unit test for pools.  It specifically makes sure
+ * that a pool hands out distinct objects, that a released object is the next
+ * one handed out, and that the pool keeps working once it needs more than one
+ * block.
+ */
+void test_pool_free_list() {
+  struct pool* pool = pool_create(24, 4);
+  void* objs[10];
+  int i, j, distinct = 1;
+
+  for (i = 0; i < 10; i++) {
+    objs[i] = pool_alloc(pool);
+    for (j = 0; j < i; j++) {
+      distinct = distinct && objs[i] != objs[j];
+    }
+  }
+  TEST_CHECK_(distinct, "pool handed out distinct objects");
+
+  pool_release(pool, objs[3]);
+  pool_release(pool, objs[7]);
+  TEST_CHECK_(pool_alloc(pool) == objs[7], "last released object was reused");
+  TEST_CHECK_(pool_alloc(pool) == objs[3], "first released object was reused");
+  pool_free(pool);
+}
+
+
+/*
+ * Auxilliary function to push n values onto a stack, pop them all and return
+ * whether they came back in reverse order.
+ */
+int stack_round_trip(struct stack* stack, int n) {
+  int i, ok = 1;
+  for (i = 0; i < n; i++) {
+    stack_push(stack, i);
+  }
+  for (i = n - 1; i >= 0; i--) {
+    ok = ok && stack_pop(stack) == i;
+  }
+  return ok && stack_isempty(stack);
+}
+
+
+/*
+ * Auxilliary function to enqueue n values into a queue, dequeue them all and
+ * return whether they came back in order.
+ */
+int queue_round_trip(struct queue* queue, int n) {
+  int i, ok = 1;
+  for (i = 0; i < n; i++) {
+    queue_enqueue(queue, i);
+  }
+  for (i = 0; i < n; i++) {
+    ok = ok && queue_dequeue(queue) == i;
+  }
+  return ok && queue_isempty(queue);
+}
+
+
+/*
+ * This function specifies a unit test for stack_create_with_alloc() and
+ * queue_create_with_alloc().  It specifically builds a stack and a queue on
+ * an arena and on a pool, and makes sure each keeps its order.  The pool's
+ * objects are big enough for the structures themselves as well as their
+ * nodes.
+ */
+void test_create_with_alloc() {
+  struct arena* arena = arena_create(0);
+  struct pool* pool = pool_create(64, 16);
+  struct allocator allocs[2];
+  struct stack* stack;
+  struct queue* queue;
+  int i;
+
+  allocs[0] = arena_allocator(arena);
+  allocs[1] = pool_allocator(pool);
+  for (i = 0; i < 2; i++) {
+    stack = stack_create_with_alloc(&allocs[i]);
+    TEST_CHECK_(stack_round_trip(stack, 100), "stack %d kept its order", i);
+    stack_free(stack);
+
+    queue = queue_create_with_alloc(&allocs[i]);
+    TEST_CHECK_(queue_round_trip(queue, 100), "queue %d kept its order", i);
+    queue_free(queue);
+  }
+
+  arena_free(arena);
+  pool_free(pool);
+}
+
+
 TEST_LIST = {
   /* list_reverse() tests */
   { "regular_list_reverse", test_regular_list_reverse },
@@ -605,6 +740,10 @@ TEST_LIST = {
   { "stack_from_queues_create", test_stack_from_queues_create },
   { "stack_from_queues_push_single", test_stack_from_queues_push_single },
   { "stack_from_queues_push_multiple", test_stack_from_queues_push_multiple },
+  /* allocator tests */
+  { "arena_rollback", test_arena_rollback },
+  { "pool_free_list", test_pool_free_list },
+  { "create_with_alloc", test_create_with_alloc },
   { NULL, NULL }
 };
 
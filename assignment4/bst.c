@@ -31,13 +31,21 @@ struct bst_node {
  */
 struct bst {
   struct bst_node* root;
+  struct allocator alloc;
 };
 
 
 struct bst* bst_create() {
-  struct bst* bst = malloc(sizeof(struct bst));
+  return bst_create_with_alloc(&system_allocator);
+}
+
+
+struct bst* bst_create_with_alloc(const struct allocator* alloc) {
+  assert(alloc);
+  struct bst* bst = alloc->alloc(alloc->ctx, sizeof(struct bst));
   assert(bst);
   bst->root = NULL;
+  bst->alloc = *alloc;
   return bst;
 }
 
@@ -53,7 +61,7 @@ void bst_free(struct bst* bst) {
     bst_remove(bst->root->val, bst);
   }
 
-  free(bst);
+  bst->alloc.release(bst->alloc.ctx, bst, sizeof(struct bst));
 }
 
 
@@ -64,10 +72,11 @@ int bst_isempty(struct bst* bst) {
 
 
 /*
- * Helper function to generate a single BST node containing a given value.
+ * Helper function to generate a single BST node containing a given value,
+ * allocated from a given allocator.
  */
-struct bst_node* _bst_node_create(int val) {
-  struct bst_node* n = malloc(sizeof(struct bst_node));
+struct bst_node* _bst_node_create(int val, struct allocator* alloc) {
+  struct bst_node* n = alloc->alloc(alloc->ctx, sizeof(struct bst_node));
   assert(n);
   n->val = val;
   n->left = n->right = NULL;
@@ -84,7 +93,8 @@ struct bst_node* _bst_node_create(int val) {
  * Returns the root of the given subtree, modified to contain a new node with
  * the specified value.
  */
-struct bst_node* _bst_subtree_insert(int val, struct bst_node* n) {
+struct bst_node* _bst_subtree_insert(int val, struct bst_node* n,
+    struct allocator* alloc) {
 
   if (n == NULL) {
 
@@ -92,7 +102,7 @@ struct bst_node* _bst_subtree_insert(int val, struct bst_node* n) {
      * If n is NULL, we know we've reached a place to insert val, so we
      * create a new node holding val and return it.
      */
-    return _bst_node_create(val);
+    return _bst_node_create(val, alloc);
 
   } else if (val < n->val) {
 
@@ -101,7 +111,7 @@ struct bst_node* _bst_subtree_insert(int val, struct bst_node* n) {
      * (somewhere) and update n->left to point to the modified subtree (with
      * val inserted).
      */
-    n->left = _bst_subtree_insert(val, n->left);
+    n->left = _bst_subtree_insert(val, n->left, alloc);
 
   } else {
 
@@ -110,7 +120,7 @@ struct bst_node* _bst_subtree_insert(int val, struct bst_node* n) {
      * right subtree (somewhere) and update n->right to point to the modified
      * subtree (with val inserted).
      */
-    n->right = _bst_subtree_insert(val, n->right);
+    n->right = _bst_subtree_insert(val, n->right, alloc);
 
   }
 
@@ -132,7 +142,7 @@ void bst_insert(int val, struct bst* bst) {
    * We insert val by using our subtree insertion function starting with the
    * subtree rooted at bst->root (i.e. the whole tree).
    */
-  bst->root = _bst_subtree_insert(val, bst->root);
+  bst->root = _bst_subtree_insert(val, bst->root, &bst->alloc);
 
 }
 
@@ -161,7 +171,8 @@ int _bst_subtree_min_val(struct bst_node* n) {
  * Returns the potentially new root of the given subtree, modified to have
  * the specified value removed.
  */
-struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
+struct bst_node* _bst_subtree_remove(int val, struct bst_node* n,
+    struct allocator* alloc) {
 
   if (n == NULL) {
 
@@ -178,7 +189,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
      * n->left to point to the modified subtree (with val removed).  Return n,
      * whose subtree itself has now been modified.
      */
-    n->left = _bst_subtree_remove(val, n->left);
+    n->left = _bst_subtree_remove(val, n->left, alloc);
     return n;
 
   } else if (val > n->val) {
@@ -188,7 +199,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
      * n->right to point to the modified subtree (with val removed).  Return n,
      * whose subtree itself has now been modified.
      */
-    n->right = _bst_subtree_remove(val, n->right);
+    n->right = _bst_subtree_remove(val, n->right, alloc);
     return n;
 
   } else {
@@ -207,7 +218,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
        * the tree (specifically from n's right subtree).
        */
       n->val = _bst_subtree_min_val(n->right);
-      n->right = _bst_subtree_remove(n->val, n->right);
+      n->right = _bst_subtree_remove(n->val, n->right, alloc);
       return n;
 
     } else if (n->left != NULL) {
@@ -218,7 +229,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
        * n's parent via the recursion.
        */
       struct bst_node* left_child = n->left;
-      free(n);
+      alloc->release(alloc->ctx, n, sizeof(struct bst_node));
       return left_child;
 
     } else if (n->right != NULL) {
@@ -229,7 +240,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
        * n's parent via the recursion.
        */
       struct bst_node* right_child = n->right;
-      free(n);
+      alloc->release(alloc->ctx, n, sizeof(struct bst_node));
       return right_child;
 
     } else {
@@ -238,7 +249,7 @@ struct bst_node* _bst_subtree_remove(int val, struct bst_node* n) {
        * Otherwise, n has no children, and we can simply free it and return
        * NULL so that n's parent will lose n as a child via the recursion.
        */
-      free(n);
+      alloc->release(alloc->ctx, n, sizeof(struct bst_node));
       return NULL;
 
     }
@@ -256,7 +267,7 @@ void bst_remove(int val, struct bst* bst) {
    * We remove val by using our subtree removal function starting with the
    * subtree rooted at bst->root (i.e. the whole tree).
    */
-  bst->root = _bst_subtree_remove(val, bst->root);
+  bst->root = _bst_subtree_remove(val, bst->root, &bst->alloc);
 
 }
 
@@ -315,6 +326,7 @@ int bst_contains(int val, struct bst* bst) {
  */
 struct bst_iterator {
   struct stack *s; // Stores the 'call stack'
+  struct allocator alloc; // Comes from the BST being iterated over
 };
 
 /*
@@ -422,10 +434,11 @@ int bst_path_sum(int sum, struct bst* bst) {
  */
 struct bst_iterator* bst_iterator_create(struct bst* bst) {
   assert(bst);
-  // Allocate memory for iterator
-  struct bst_iterator *iter = (struct bst_iterator*)malloc(sizeof(struct bst_iterator));
+  // Allocate memory for iterator from the same place the BST's memory comes from
+  struct bst_iterator *iter = (struct bst_iterator*)bst->alloc.alloc(bst->alloc.ctx, sizeof(struct bst_iterator));
+  iter->alloc = bst->alloc;
   // Allocate memory for stack
-  iter->s = stack_create();
+  iter->s = stack_create_with_alloc(&bst->alloc);
   // If bst is empty, don't need to set anything else up
   if (bst->root != NULL) {
     struct bst_node *current = bst->root;
@@ -446,7 +459,7 @@ struct bst_iterator* bst_iterator_create(struct bst* bst) {
 void bst_iterator_free(struct bst_iterator* iter) {
   assert(iter);
   stack_free(iter->s); // Free stack first, then iterator
-  free(iter);
+  iter->alloc.release(iter->alloc.ctx, iter, sizeof(struct bst_iterator));
 }
 
 /*
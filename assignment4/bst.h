@@ -5,6 +5,8 @@
 #ifndef __BST_H
 #define __BST_H
 
+#include "allocator.h"
+
 /*
  * Structure used to represent a binary search tree.
  */
@@ -15,6 +17,16 @@ struct bst;
  */
 struct bst* bst_create();
 
+/*
+ * Creates a new, empty binary search tree whose memory, including the memory
+ * for each of its nodes and for any iterators over it, comes from a given
+ * allocator (see allocator.h), and returns a pointer to it.
+ *
+ * Params:
+ *   alloc - the allocator to be used by the new tree.  May not be NULL.
+ */
+struct bst* bst_create_with_alloc(const struct allocator* alloc);
+
 /*
  * Free the memory associated with a binary search tree.
  *
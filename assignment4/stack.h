@@ -5,6 +5,8 @@
 #ifndef __STACK_H
 #define __STACK_H
 
+#include "allocator.h"
+
 /*
  * Structure used to represent a stack.
  */
@@ -15,6 +17,16 @@ struct stack;
  */
 struct stack* stack_create();
 
+/*
+ * Creates a new, empty stack whose memory, including the memory for each of its
+ * nodes, comes from a given allocator (see allocator.h), and returns a pointer
+ * to it.
+ *
+ * Params:
+ *   alloc - the allocator to be used by the new stack.  May not be NULL.
+ */
+struct stack* stack_create_with_alloc(const struct allocator* alloc);
+
 /*
  * Free all of the memory associated with a stack.  Note that, while this
  * function cleans up all memory used in the stack itself, it does not free
@@ -415,6 +415,71 @@ void test_bst_iterator_iteration() {
   bst_free(bst);
 }
 
+/****************************************************************************
+ **
+ ** Allocator tests
+ **
+ ****************************************************************************/
+
+/*
+ * This function specifies a unit test for BSTs created with a custom allocator.
+ * It specifically builds the same tree from an arena and from a pool and makes
+ * sure both behave like a regular BST, including after the arena is reset and
+ * reused without freeing the first tree.
+ */
+void test_bst_with_alloc() {
+  int i, round, n = TEST_TREE_SIZES[0];
+  const int* tree_values = TEST_TREE_VALUES[0];
+  struct arena* arena = arena_create(256);
+  struct allocator alloc = arena_allocator(arena);
+  struct pool* pool;
+  struct bst* bst;
+
+  /*
+   * Build the tree from the arena twice, resetting the arena in between
+   * instead of calling bst_free().
+   */
+  for (round = 0; round < 2; round++) {
+    bst = bst_create_with_alloc(&alloc);
+    for (i = 0; i < n; i++) {
+      bst_insert(tree_values[i], bst);
+    }
+    TEST_CHECK_(bst_size(bst) == n, "arena bst %d has the correct size "
+      "(%d == %d)", round, bst_size(bst), n);
+    TEST_CHECK_(bst_height(bst) == TEST_TREE_HEIGHTS[0], "arena bst %d has "
+      "the correct height (%d == %d)", round, bst_height(bst),
+      TEST_TREE_HEIGHTS[0]);
+    arena_reset(arena);
+  }
+  arena_free(arena);
+
+  /*
+   * Build the tree from a pool and remove half of its values, which hands
+   * nodes back to the pool to be reused by the following inserts.  The pool's
+   * objects need to be big enough for the BST structure itself, too.
+   */
+  pool = pool_create(64, 4);
+  alloc = pool_allocator(pool);
+  bst = bst_create_with_alloc(&alloc);
+  for (i = 0; i < n; i++) {
+    bst_insert(tree_values[i], bst);
+  }
+  for (i = 0; i < n; i += 2) {
+    bst_remove(tree_values[i], bst);
+  }
+  for (i = 0; i < n; i += 2) {
+    bst_insert(tree_values[i], bst);
+  }
+  for (i = 0; i < n; i++) {
+    TEST_CHECK_(bst_contains(tree_values[i], bst), "pool bst contains %d",
+      tree_values[i]);
+  }
+  TEST_CHECK_(bst_size(bst) == n, "pool bst has the correct size (%d == %d)",
+    bst_size(bst), n);
+  bst_free(bst);
+  pool_free(pool);
+}
+
 /****************************************************************************
  **
  ** Test listing
@@ -434,6 +499,8 @@ TEST_LIST = {
   { "bst_iterator_create", test_bst_iterator_create },
   { "bst_iterator_create_empty", test_bst_iterator_create_empty },
   { "bst_iterator_iteration", test_bst_iterator_iteration },
+  /* allocator tests */
+  { "bst_with_alloc", test_bst_with_alloc },
   { NULL, NULL }
 };
 
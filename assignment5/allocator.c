@@ -0,0 +1,458 @@
+/*
+ * This file contains the definitions of structures and functions implementing
+ * the allocators declared in allocator.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+
+/*
+ * Allocations at least this many bytes long are mapped directly with mmap()
+ * by the system allocator instead of coming from malloc().  Resizing a mapped
+ * allocation with mremap() lets the kernel move page table entries around
+ * instead of copying every byte into a new buffer.
+ */
+#define SYSTEM_MMAP_THRESHOLD (1 << 20)
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define POOL_DEFAULT_OBJS_PER_BLOCK 256
+
+/*
+ * Every allocation handed out by an arena or pool is aligned to this many
+ * bytes, which is enough for any of the types stored in our data structures.
+ */
+#define ALLOC_ALIGN 16
+
+
+/*
+ * Auxilliary function to round a size up to a multiple of ALLOC_ALIGN.
+ */
+size_t _alloc_align_up(size_t size) {
+
+  assert(size <= SIZE_MAX - (ALLOC_ALIGN - 1));
+  return (size + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+
+}
+
+
+/*****************************************************************************
+ *
+ * System allocator
+ *
+ *****************************************************************************/
+
+/*
+ * Auxilliary function to map a new anonymous region large enough to hold a
+ * given number of bytes.
+ */
+void* _system_map(size_t size) {
+
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(mem != MAP_FAILED);
+  return mem;
+
+}
+
+
+void* _system_alloc(void* ctx, size_t size) {
+
+  (void)ctx;
+  if (size >= SYSTEM_MMAP_THRESHOLD) {
+    return _system_map(size);
+  }
+  void* mem = malloc(size > 0 ? size : 1);
+  assert(mem);
+  return mem;
+
+}
+
+
+/*
+ * Whether an allocation was mapped is a function of its size alone, so the
+ * old and new sizes tell us which kind of storage we're moving between.
+ * Contents are only copied when an allocation crosses between the two.
+ */
+void* _system_resize(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+
+  int old_mapped = old_size >= SYSTEM_MMAP_THRESHOLD;
+  int new_mapped = new_size >= SYSTEM_MMAP_THRESHOLD;
+  void* mem;
+
+  if (old_mapped && new_mapped) {
+#ifdef MREMAP_MAYMOVE
+    mem = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+    assert(mem != MAP_FAILED);
+#else
+    mem = _system_map(new_size);
+    memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+    munmap(ptr, old_size);
+#endif
+  } else if (old_mapped || new_mapped) {
+    mem = _system_alloc(ctx, new_size);
+    memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+    if (old_mapped) {
+      munmap(ptr, old_size);
+    } else {
+      free(ptr);
+    }
+  } else {
+    mem = realloc(ptr, new_size > 0 ? new_size : 1);
+    assert(mem);
+  }
+
+  return mem;
+
+}
+
+
+void _system_release(void* ctx, void* ptr, size_t size) {
+
+  (void)ctx;
+  if (size >= SYSTEM_MMAP_THRESHOLD) {
+    munmap(ptr, size);
+  } else {
+    free(ptr);
+  }
+
+}
+
+
+const struct allocator system_allocator = {
+  _system_alloc,
+  _system_resize,
+  _system_release,
+  NULL
+};
+
+
+/*****************************************************************************
+ *
+ * Arena allocator
+ *
+ *****************************************************************************/
+
+/*
+ * This structure represents a single block of memory owned by an arena.  The
+ * block's usable memory immediately follows this header.
+ */
+struct arena_block {
+  struct arena_block* next;
+  size_t size;
+};
+
+/*
+ * This is the definition of the arena structure.  Blocks are kept in a list
+ * with the current block at the head.  used counts how many bytes of the
+ * current block have been handed out, and last points at the most recent
+ * allocation so it can be resized or rolled back.
+ */
+struct arena {
+  struct arena_block* blocks;
+  size_t block_size;
+  size_t used;
+  char* last;
+};
+
+
+/*
+ * Auxilliary function to return the first usable byte of an arena block.
+ */
+char* _arena_block_mem(struct arena_block* block) {
+
+  return (char*)block + _alloc_align_up(sizeof(struct arena_block));
+
+}
+
+
+/*
+ * Auxilliary function to push a new block of at least size usable bytes onto
+ * the front of an arena's block list.
+ */
+void _arena_push_block(struct arena* arena, size_t size) {
+
+  size_t header = _alloc_align_up(sizeof(struct arena_block));
+  assert(size <= SIZE_MAX - header);
+  struct arena_block* block = malloc(header + size);
+  assert(block);
+  block->size = size;
+  block->next = arena->blocks;
+  arena->blocks = block;
+  arena->used = 0;
+
+}
+
+
+struct arena* arena_create(size_t block_size) {
+
+  struct arena* arena = malloc(sizeof(struct arena));
+  assert(arena);
+  arena->blocks = NULL;
+  arena->block_size = block_size > 0 ? _alloc_align_up(block_size)
+    : ARENA_DEFAULT_BLOCK_SIZE;
+  arena->last = NULL;
+  _arena_push_block(arena, arena->block_size);
+  return arena;
+
+}
+
+
+void arena_free(struct arena* arena) {
+
+  assert(arena);
+  while (arena->blocks) {
+    struct arena_block* next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = next;
+  }
+  free(arena);
+
+}
+
+
+void* arena_alloc(struct arena* arena, size_t size) {
+
+  assert(arena);
+  size = _alloc_align_up(size);
+
+  if (size > arena->blocks->size - arena->used) {
+    _arena_push_block(arena, size > arena->block_size ? size
+      : arena->block_size);
+  }
+
+  arena->last = _arena_block_mem(arena->blocks) + arena->used;
+  arena->used += size;
+  return arena->last;
+
+}
+
+
+void arena_reset(struct arena* arena) {
+
+  assert(arena);
+
+  /*
+   * Free every block except the oldest one, which sits at the tail of the
+   * list.  Oversized blocks are only ever pushed after the first block, so
+   * the one we keep always has the arena's regular block size.
+   */
+  while (arena->blocks->next) {
+    struct arena_block* next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = next;
+  }
+  arena->used = 0;
+  arena->last = NULL;
+
+}
+
+
+void* _arena_alloc(void* ctx, size_t size) {
+
+  return arena_alloc(ctx, size);
+
+}
+
+
+void* _arena_resize(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+
+  struct arena* arena = ctx;
+
+  /*
+   * The most recent allocation sits at the end of the used part of the
+   * current block, so it can grow or shrink in place as long as it fits.
+   */
+  if (ptr && ptr == arena->last) {
+    size_t start = (char*)ptr - _arena_block_mem(arena->blocks);
+    size_t new_aligned = _alloc_align_up(new_size);
+    if (new_aligned <= arena->blocks->size - start) {
+      arena->used = start + new_aligned;
+      return ptr;
+    }
+  }
+
+  void* mem = arena_alloc(arena, new_size);
+  if (ptr) {
+    memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+  }
+  return mem;
+
+}
+
+
+void _arena_release(void* ctx, void* ptr, size_t size) {
+
+  (void)size;
+  struct arena* arena = ctx;
+
+  /*
+   * Only the most recent allocation can be given back; everything else is
+   * reclaimed when the arena is reset.
+   */
+  if (ptr && ptr == arena->last) {
+    arena->used = (char*)ptr - _arena_block_mem(arena->blocks);
+    arena->last = NULL;
+  }
+
+}
+
+
+struct allocator arena_allocator(struct arena* arena) {
+
+  assert(arena);
+  struct allocator alloc = {
+    _arena_alloc,
+    _arena_resize,
+    _arena_release,
+    arena
+  };
+  return alloc;
+
+}
+
+
+/*****************************************************************************
+ *
+ * Pool allocator
+ *
+ *****************************************************************************/
+
+/*
+ * This is the definition of the pool structure.  Released objects are linked
+ * through their own first bytes into the free list.  Blocks are linked the
+ * same way through a header at their start so they can be freed with the pool.
+ */
+struct pool {
+  void* free_list;
+  void* blocks;
+  size_t obj_size;
+  size_t objs_per_block;
+};
+
+
+struct pool* pool_create(size_t obj_size, size_t objs_per_block) {
+
+  assert(obj_size > 0);
+  struct pool* pool = malloc(sizeof(struct pool));
+  assert(pool);
+
+  /*
+   * Every slot needs to be able to hold a free list link and stay aligned.
+   */
+  pool->obj_size = _alloc_align_up(obj_size > sizeof(void*) ? obj_size
+    : sizeof(void*));
+  pool->objs_per_block = objs_per_block > 0 ? objs_per_block
+    : POOL_DEFAULT_OBJS_PER_BLOCK;
+  pool->free_list = NULL;
+  pool->blocks = NULL;
+  return pool;
+
+}
+
+
+void pool_free(struct pool* pool) {
+
+  assert(pool);
+  while (pool->blocks) {
+    void* next = *(void**)pool->blocks;
+    free(pool->blocks);
+    pool->blocks = next;
+  }
+  free(pool);
+
+}
+
+
+/*
+ * Auxilliary function to allocate a new block for a pool and thread all of
+ * its slots onto the free list.
+ */
+void _pool_grow(struct pool* pool) {
+
+  size_t header = _alloc_align_up(sizeof(void*));
+  assert(pool->objs_per_block <= (SIZE_MAX - header) / pool->obj_size);
+  char* block = malloc(header + pool->obj_size * pool->objs_per_block);
+  assert(block);
+  *(void**)block = pool->blocks;
+  pool->blocks = block;
+
+  char* slot = block + header;
+  for (size_t i = 0; i < pool->objs_per_block; i++) {
+    *(void**)slot = pool->free_list;
+    pool->free_list = slot;
+    slot += pool->obj_size;
+  }
+
+}
+
+
+void* pool_alloc(struct pool* pool) {
+
+  assert(pool);
+  if (!pool->free_list) {
+    _pool_grow(pool);
+  }
+  void* obj = pool->free_list;
+  pool->free_list = *(void**)obj;
+  return obj;
+
+}
+
+
+void pool_release(struct pool* pool, void* obj) {
+
+  assert(pool);
+  if (obj) {
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+  }
+
+}
+
+
+void* _pool_alloc(void* ctx, size_t size) {
+
+  struct pool* pool = ctx;
+  assert(size <= pool->obj_size);
+  return pool_alloc(pool);
+
+}
+
+
+void* _pool_resize(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+
+  (void)old_size;
+  struct pool* pool = ctx;
+  assert(new_size <= pool->obj_size);
+  return ptr ? ptr : pool_alloc(pool);
+
+}
+
+
+void _pool_release(void* ctx, void* ptr, size_t size) {
+
+  (void)size;
+  pool_release(ctx, ptr);
+
+}
+
+
+struct allocator pool_allocator(struct pool* pool) {
+
+  assert(pool);
+  struct allocator alloc = {
+    _pool_alloc,
+    _pool_resize,
+    _pool_release,
+    pool
+  };
+  return alloc;
+
+}
@@ -5,16 +5,145 @@
 #ifndef __DYNARRAY_H
 #define __DYNARRAY_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "allocator.h"
+
 /*
- * Structure used to represent a dynamic array.
+ * Special index value that may be passed to functions that accept it to refer
+ * to the end of an array (i.e. the position after the last element for
+ * insertion, or the last element otherwise).  Because indices are unsigned,
+ * passing -1 has the same effect.
  */
-struct dynarray;
+#define DYNARRAY_END ((size_t)-1)
+
+/*
+ * The number of bytes of element storage built into every dynamic array
+ * structure.  Arrays start out storing their elements there and only move to
+ * separately allocated storage once they outgrow it, so small arrays need a
+ * single allocation.  This holds 4 pointers on 64-bit platforms, which is as
+ * much as fits next to the fields every access reads within 64 bytes.
+ */
+#define DYNARRAY_SMALL_BYTES 32
+
+/*
+ * Structure used to represent a dynamic array.  The data array is stored as
+ * raw bytes so that it can hold either generic void* pointers (for arrays made
+ * with dynarray_create()) or fixed-size records stored inline (for arrays made
+ * with dynarray_create_sized()).  Either way, element i starts at byte
+ * i * elem_size.  data points at small.bytes until the array outgrows it.
+ * For arrays opened with dynarray_open_mapped(), fd is the backing file and
+ * data points into a shared mapping of it; otherwise fd is -1.
+ *
+ * The fields read by every access come first, and the small buffer follows
+ * them directly, so the two together make up the structure's first 64 bytes.
+ * A small array's elements therefore share a cache line with its length and
+ * capacity whenever the structure starts on a cache line boundary, and never
+ * span more than two lines otherwise.  The fields only needed when the array
+ * is resized or freed come last.
+ *
+ * The fields are only visible here so that the inline accessors at the bottom
+ * of this file can be compiled directly into their callers.  Code outside of
+ * dynarray.c should use the functions below instead of touching them.
+ */
+struct dynarray {
+  char* data;
+  size_t length;
+  size_t capacity;
+  uint32_t elem_size;
+  int inline_elems;
+  union {
+    char bytes[DYNARRAY_SMALL_BYTES];
+    void* align_ptr;
+    long long align_ll;
+    double align_d;
+  } small;
+  double growth_factor;
+  int fd;
+  struct allocator alloc;
+};
+
+_Static_assert(offsetof(struct dynarray, small) + DYNARRAY_SMALL_BYTES <= 64,
+  "a dynarray's hot fields and small buffer must fit in 64 bytes");
 
 /*
  * Creates a new, empty dynamic array and returns a pointer to it.
  */
 struct dynarray* dynarray_create();
 
+/*
+ * Creates a new, empty dynamic array that stores fixed-size records inline in
+ * its underlying storage instead of storing pointers to them, and returns a
+ * pointer to it.  For arrays created this way, values passed to the insert
+ * and set functions are pointers to records that are copied into the array,
+ * and values returned by dynarray_get() are pointers to the records inside
+ * the array.  Those pointers remain valid only until the array is next
+ * resized or its elements are moved.
+ *
+ * Params:
+ *   elem_size - the size in bytes of each record stored in the array.  Must
+ *     be greater than 0 and less than 2^32.
+ */
+struct dynarray* dynarray_create_sized(size_t elem_size);
+
+/*
+ * Versions of dynarray_create() and dynarray_create_sized() that take all of
+ * the new array's memory, including the array structure itself, from a given
+ * allocator (see allocator.h) instead of from the system allocator.
+ *
+ * Params:
+ *   elem_size - see dynarray_create_sized()
+ *   alloc - the allocator to be used for the new array.  May not be NULL.  The
+ *     allocator is copied into the array, but any state its ctx points to
+ *     must outlive the array.
+ */
+struct dynarray* dynarray_create_with_alloc(const struct allocator* alloc);
+struct dynarray* dynarray_create_sized_with_alloc(size_t elem_size,
+  const struct allocator* alloc);
+
+/*
+ * Opens a record array whose storage is a memory-mapped file, creating the
+ * file if it doesn't exist, and returns a pointer to it.  The array behaves
+ * like one created with dynarray_create_sized(), except that its records live
+ * in the file.  Growing the array grows the file with posix_fallocate() and
+ * the mapping with mremap(), so arrays larger than RAM can be built, and
+ * reopening the file later gives back the same records without rebuilding
+ * them.  If the file or its mapping can't be grown, say because the disk is
+ * full, the functions that grow the array return -1 and leave it unchanged.
+ *
+ * Because records are stored as raw bytes, they should not contain pointers,
+ * which won't be meaningful once the file is reopened.
+ *
+ * Params:
+ *   path - the path of the file backing the array
+ *   elem_size - the size in bytes of each record.  Must be greater than 0,
+ *     and must match the record size the file was created with, if it already
+ *     exists.
+ *
+ * Return:
+ *   Returns a pointer to the array, or NULL if the file couldn't be opened or
+ *   mapped, or if it exists but wasn't created by this function with the same
+ *   record size.  The array should be freed with dynarray_free(), which
+ *   records the array's length in the file and closes it.
+ */
+struct dynarray* dynarray_open_mapped(const char* path, size_t elem_size);
+
+/*
+ * Flushes a mapped array's records and length to its file, blocking until they
+ * have been written.  Without calling this, changes still reach the file, but
+ * only whenever the kernel gets around to writing them back.  Does nothing for
+ * arrays that aren't mapped.
+ *
+ * Params:
+ *   da - the dynamic array to be flushed.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the records couldn't be written.
+ */
+int dynarray_sync(struct dynarray* da);
+
 /*
  * Free the memory associated with a dynamic array.  Note that, while this
  * function cleans up all memory used in the array itself, it does not free
@@ -29,7 +158,14 @@ void dynarray_free(struct dynarray* da);
 /*
  * Returns the length (i.e. the number of elements) of a given dynamic array.
  */
-int dynarray_length(struct dynarray* da);
+size_t dynarray_length(struct dynarray* da);
+
+/*
+ * Returns the size in bytes of the records stored in a dynamic array created
+ * with dynarray_create_sized(), or 0 for an array of pointers created with
+ * dynarray_create().
+ */
+size_t dynarray_elem_size(struct dynarray* da);
 
 /*
  * Inserts a new element to a dynamic array at a specified index.  All existing
@@ -39,10 +175,18 @@ int dynarray_length(struct dynarray* da);
  * Params:
  *   da - the dynamic array into which to insert an element.  May not be NULL.
  *   idx - the index in the array at which to insert the new element.  The
- *     special value -1 may be passed to insert at the end of the array.
- *   val - the value to be inserted.
+ *     special value DYNARRAY_END may be passed to insert at the end of the
+ *     array.
+ *   val - the value to be inserted.  For record arrays, this points to the
+ *     record to be copied into the array, or is NULL to insert a zeroed
+ *     record.  The record may be one of da's own, such as one returned by
+ *     dynarray_get(), in which case it's copied before anything is moved.
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the array is mapped and its file couldn't
+ *   be grown to make room, in which case the array is left unchanged.
  */
-void dynarray_insert(struct dynarray* da, int idx, void* val);
+int dynarray_insert(struct dynarray* da, size_t idx, void* val);
 
 /*
  * Removes an element at a specified index from a dynamic array.  All existing
@@ -51,21 +195,78 @@ void dynarray_insert(struct dynarray* da, int idx, void* val);
  *
  * Params:
  *   da - the dynamic array from which to remove an element.  May not be NULL.
- *   idx - the index of the element to be removed.  The special value -1 may
- *     be passed to remove the element at the end of the array.
+ *   idx - the index of the element to be removed.  The special value
+ *     DYNARRAY_END may be passed to remove the element at the end of the
+ *     array.
+ */
+void dynarray_remove(struct dynarray* da, size_t idx);
+
+/*
+ * Inserts a block of new elements into a dynamic array at a specified index.
+ * All existing elements following the specified index are moved back once to
+ * make room for the whole block, so inserting count elements costs the same
+ * as inserting a single one plus copying the block itself.
+ *
+ * Params:
+ *   da - the dynamic array into which to insert elements.  May not be NULL.
+ *   idx - the index in the array at which the first new element should be
+ *     inserted.  The special value DYNARRAY_END may be passed to insert at the
+ *     end of the array.
+ *   vals - an array of count values to be inserted, in order.  For pointer
+ *     arrays this is an array of void*, and for record arrays it is an array
+ *     of contiguous records.  If NULL, count zeroed elements are inserted.
+ *     May not point into da itself.
+ *   count - the number of values in vals
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the array is mapped and its file couldn't
+ *   be grown to make room, in which case the array is left unchanged.
+ */
+int dynarray_insert_range(struct dynarray* da, size_t idx, const void* vals,
+  size_t count);
+
+/*
+ * Appends a block of new elements to the end of a dynamic array.  This is
+ * equivalent to calling dynarray_insert_range() with an index of
+ * DYNARRAY_END.
+ *
+ * Params:
+ *   da - the dynamic array onto which to append elements.  May not be NULL.
+ *   vals - an array of count values to be appended, in order, laid out as
+ *     described for dynarray_insert_range().
+ *   count - the number of values in vals
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the array is mapped and its file couldn't
+ *   be grown to make room, in which case the array is left unchanged.
  */
-void dynarray_remove(struct dynarray* da, int idx);
+int dynarray_append_array(struct dynarray* da, const void* vals,
+  size_t count);
 
 /*
- * Returns the value of an existing element a dynamic array array.
+ * Removes a contiguous block of elements from a dynamic array.  All existing
+ * elements following the block are moved forward once to fill in the gap.
+ *
+ * Params:
+ *   da - the dynamic array from which to remove elements.  May not be NULL.
+ *   idx - the index of the first element to be removed.
+ *   count - the number of elements to remove.  idx + count may not exceed
+ *     the length of the array.
+ */
+void dynarray_remove_range(struct dynarray* da, size_t idx, size_t count);
+
+/*
+ * Returns the value of an existing element a dynamic array array.  For record
+ * arrays, this is a pointer to the record inside the array.
  *
  * Params:
  *   da - the dynamic array from which to get a value.  May not be NULL.
  *   idx - the index of the element whose value should be returned.  Must
- *     be between 0 and the length of the array.  The special value -1 may also
- *     be passed to return the element at the end of the array.
+ *     be between 0 and the length of the array.  The special value
+ *     DYNARRAY_END may also be passed to return the element at the end of the
+ *     array.
  */
-void* dynarray_get(struct dynarray* da, int idx);
+void* dynarray_get(struct dynarray* da, size_t idx);
 
 /*
  * Sets an existing element in a dynamic array array to a new value.
@@ -73,10 +274,115 @@ void* dynarray_get(struct dynarray* da, int idx);
  * Params:
  *   da - the dynamic array in which to set a value.  May not be NULL.
  *   idx - the index of the element whose value is to be set.  Must be
- *     between 0 and the length of the array.  The special value -1 may also be
- *     passed to set the element at the end of the array.
+ *     between 0 and the length of the array.  The special value DYNARRAY_END
+ *     may also be passed to set the element at the end of the array.
+ *   val - the new value to be set.  For record arrays, this points to the
+ *     record to be copied into the array.
+ */
+void dynarray_set(struct dynarray* da, size_t idx, void* val);
+
+/*
+ * Exchanges two elements of a dynamic array.  Unlike a swap written in terms
+ * of dynarray_get() and dynarray_set(), this works for record arrays too.
+ *
+ * Params:
+ *   da - the dynamic array in which to swap elements.  May not be NULL.
+ *   i, j - the indices of the elements to be swapped.  Must be between 0 and
+ *     the length of the array.
+ */
+void dynarray_swap(struct dynarray* da, size_t i, size_t j);
+
+/*
+ * The functions below are fast-path versions of the accessors above, meant
+ * for inner loops like sorting and heap percolation.  They are defined inline
+ * so that calls to them compile down to plain array indexing.  Their indices
+ * are checked with assert(), which means they are only checked in debug
+ * builds, and they don't accept DYNARRAY_END as a shorthand for the last
+ * element.
+ */
+
+/*
+ * Returns the underlying storage of a dynamic array.  For pointer arrays, this
+ * is an array of void*, and for record arrays it is an array of records.  The
+ * returned pointer is only valid until the array is next resized.
+ *
+ * Params:
+ *   da - the dynamic array whose storage is to be returned.  May not be NULL.
+ */
+static inline void* dynarray_data(struct dynarray* da) {
+  assert(da);
+  return da->data;
+}
+
+/*
+ * Unchecked version of dynarray_get().
+ *
+ * Params:
+ *   da - the dynamic array from which to get a value.  May not be NULL.
+ *   idx - the index of the element whose value should be returned.  Must be
+ *     between 0 and the length of the array.
+ */
+static inline void* dynarray_get_unchecked(struct dynarray* da, size_t idx) {
+  assert(da && idx < da->length);
+  char* slot = da->data + idx * da->elem_size;
+  return da->inline_elems ? (void*)slot : *(void**)slot;
+}
+
+/*
+ * Unchecked version of dynarray_set() for pointer arrays.  Record arrays
+ * should write through dynarray_data() or dynarray_get_unchecked() instead.
+ *
+ * Params:
+ *   da - the dynamic array in which to set a value.  May not be NULL.
+ *   idx - the index of the element whose value is to be set.  Must be
+ *     between 0 and the length of the array.
  *   val - the new value to be set
  */
-void dynarray_set(struct dynarray* da, int idx, void* val);
+static inline void dynarray_set_unchecked(struct dynarray* da, size_t idx,
+    void* val) {
+  assert(da && !da->inline_elems && idx < da->length);
+  ((void**)da->data)[idx] = val;
+}
+
+/*
+ * Makes sure a dynamic array has room for at least a given number of elements
+ * without needing to grow its underlying storage.  This is useful when the
+ * number of elements to be inserted is known ahead of time, since it replaces
+ * a series of incremental resizes with a single allocation.  The array's
+ * length is not changed.
+ *
+ * Params:
+ *   da - the dynamic array whose capacity is to be reserved.  May not be NULL.
+ *   capacity - the minimum number of elements the array should be able to hold
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the array is mapped and its file couldn't
+ *   be grown, in which case the array is left unchanged.
+ */
+int dynarray_reserve(struct dynarray* da, size_t capacity);
+
+/*
+ * Releases any unused capacity held by a dynamic array, so that its
+ * underlying storage is only as large as its current length requires.
+ *
+ * Params:
+ *   da - the dynamic array to be shrunk.  May not be NULL.
+ *
+ * Return:
+ *   Returns 0 on success or -1 if the array is mapped and its mapping couldn't
+ *   be shrunk, in which case the array is left unchanged.
+ */
+int dynarray_shrink_to_fit(struct dynarray* da);
+
+/*
+ * Sets the factor by which a dynamic array's capacity is multiplied each time
+ * it runs out of room.  The default factor is 2.  Smaller factors waste less
+ * memory at the cost of more frequent resizes.
+ *
+ * Params:
+ *   da - the dynamic array whose growth factor is to be set.  May not be NULL.
+ *   factor - the new growth factor.  Must be greater than 1.
+ */
+void dynarray_set_growth_factor(struct dynarray* da, double factor);
 
 #endif
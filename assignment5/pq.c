@@ -30,6 +30,7 @@ struct pq_element {
  */
 struct pq {
   struct dynarray *arr;
+  struct allocator alloc; // where the pq and its array get their memory
 };
 
 
@@ -38,8 +39,24 @@ struct pq {
  * return a pointer to it.
  */
 struct pq* pq_create() {
-  struct pq *tmp = (struct pq*)malloc(sizeof(struct pq));
-  tmp->arr = dynarray_create();
+  return pq_create_with_alloc(&system_allocator);
+}
+
+
+/*
+ * This function works like pq_create(), except that all of the new priority
+ * queue's memory comes from a given allocator.
+ *
+ * Params:
+ *   alloc - the allocator to be used by the new priority queue.  May not be
+ *     NULL.
+ */
+struct pq* pq_create_with_alloc(const struct allocator* alloc) {
+  assert(alloc);
+  struct pq *tmp = (struct pq*)alloc->alloc(alloc->ctx, sizeof(struct pq));
+  assert(tmp);
+  tmp->alloc = *alloc;
+  tmp->arr = dynarray_create_sized_with_alloc(sizeof(struct pq_element), alloc); // elements are stored inline in the heap array
   return tmp;
 }
 
@@ -55,7 +72,7 @@ struct pq* pq_create() {
 void pq_free(struct pq* pq) {
   assert(pq);
   dynarray_free(pq->arr);
-  free(pq);
+  pq->alloc.release(pq->alloc.ctx, pq, sizeof(struct pq));
 }
 
 
@@ -79,20 +96,22 @@ int pq_isempty(struct pq* pq) {
 /*
  * Helper function to swap elements in a priority queue
  */
-void swap(struct pq *pq, int first, int second) {
-  struct pq_element* tmp = (struct pq_element*)dynarray_get(pq->arr, first);
-  dynarray_set(pq->arr, first, dynarray_get(pq->arr, second));
-  dynarray_set(pq->arr, second, tmp);
+void swap(struct pq *pq, size_t first, size_t second) {
+  struct pq_element* heap = dynarray_data(pq->arr); // elements are stored inline, so we can swap them directly
+  struct pq_element tmp = heap[first];
+  heap[first] = heap[second];
+  heap[second] = tmp;
 }
 
 /*
  * Helper function to percolate an element up the heap.
  */
-void percolate_up(struct pq *pq, int index) {
+void percolate_up(struct pq *pq, size_t index) {
+  struct pq_element* heap = dynarray_data(pq->arr); // the heap doesn't get resized while percolating, so index it directly
   while(index != 0) { // if the current node is the root node, we can't percolate up any further
-    int parent = (index-1)/2; // calculate index of parent node
+    size_t parent = (index-1)/2; // calculate index of parent node
     // if the priority of current node is less than priority of parent node, we don't need to percolate up any further
-    if (((struct pq_element*)dynarray_get(pq->arr, index))->priority < ((struct pq_element*)dynarray_get(pq->arr, parent))->priority) {
+    if (heap[index].priority < heap[parent].priority) {
       break;
     }
     swap(pq, index, parent);
@@ -119,10 +138,10 @@ void percolate_up(struct pq *pq, int index) {
  */
 void pq_insert(struct pq* pq, void* data, int priority) {
   assert(pq);
-  struct pq_element *new = (struct pq_element*)malloc(sizeof(struct pq_element)); // Allocate memory for new node
-  new->data = data;
-  new->priority = priority;
-  dynarray_insert(pq->arr, -1, new); // append the new node to the end of the array
+  struct pq_element new; // The new node is copied into the array, so it doesn't need its own allocation
+  new.data = data;
+  new.priority = priority;
+  dynarray_insert(pq->arr, DYNARRAY_END, &new); // append the new node to the end of the array
   percolate_up(pq, dynarray_length(pq->arr) - 1); // percolate the new node up the heap
 }
 
@@ -165,17 +184,19 @@ int pq_max_priority(struct pq* pq) {
 /*
  * Helper function to percolate nodes down the heap
  */
-void percolate_down(struct pq* pq, int index) {
-  while((index+1)*2-1 < dynarray_length(pq->arr)) {
-    int left = (index+1)*2-1; // calculate index of left child node
-    int right = ((index+1)*2 < dynarray_length(pq->arr)) ? (index+1)*2 : left; // Catch edge case where only a left child node exists
+void percolate_down(struct pq* pq, size_t index) {
+  struct pq_element* heap = dynarray_data(pq->arr); // the heap doesn't get resized while percolating, so index it directly
+  size_t length = dynarray_length(pq->arr);
+  while((index+1)*2-1 < length) {
+    size_t left = (index+1)*2-1; // calculate index of left child node
+    size_t right = ((index+1)*2 < length) ? (index+1)*2 : left; // Catch edge case where only a left child node exists
     
     // If the priority of the current node is less than its left or right child
-    if (((struct pq_element*)dynarray_get(pq->arr, index))->priority < ((struct pq_element*)dynarray_get(pq->arr, left))->priority || 
-        ((struct pq_element*)dynarray_get(pq->arr, index))->priority < ((struct pq_element*)dynarray_get(pq->arr, right))->priority) 
+    if (heap[index].priority < heap[left].priority || 
+        heap[index].priority < heap[right].priority) 
     {
       // Find the child node with the greatest priority and swap
-      if (((struct pq_element*)dynarray_get(pq->arr, left))->priority > ((struct pq_element*)dynarray_get(pq->arr, right))->priority) {
+      if (heap[left].priority > heap[right].priority) {
         swap(pq, index, left);
         index = left;
       }
@@ -206,9 +227,8 @@ void percolate_down(struct pq* pq, int index) {
 void* pq_max_dequeue(struct pq* pq) {
   assert(!pq_isempty(pq));
   void *tmp = pq_max(pq); // Data that will be returned
-  free((struct pq_element*)dynarray_get(pq->arr, 0)); // free memory allocated to previous root node
-  dynarray_set(pq->arr, 0, dynarray_get(pq->arr, -1)); // replace root with last node in heap
-  dynarray_remove(pq->arr, -1); // remove the old last node
+  dynarray_set(pq->arr, 0, dynarray_get(pq->arr, DYNARRAY_END)); // replace root with last node in heap
+  dynarray_remove(pq->arr, DYNARRAY_END); // remove the old last node
   percolate_down(pq, 0); // percolate the node down the heap to restore heap property
   return tmp;
 }
@@ -6,9 +6,12 @@
 #ifndef __PQ_H
 #define __PQ_H
 
+#include "allocator.h"
+
 struct pq;
 
 struct pq* pq_create();
+struct pq* pq_create_with_alloc(const struct allocator* alloc);
 void pq_free(struct pq* pq);
 int pq_isempty(struct pq* pq);
 void pq_insert(struct pq* pq, void* data, int priority);
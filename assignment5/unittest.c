@@ -5,13 +5,18 @@
  * Acutest framework here: https://github.com/mity/acutest.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 #include "acutest.h"
 
 #include "pq.h"
+#include "dynarray.h"
 
 /*
  * This is a comparison function to be used with qsort() to sort an array of
@@ -265,6 +270,572 @@ void test_pq_insert_multiple() {
 }
 
 
+/*
+ * This function specifies a unit test for the dynamic array underlying the
+ * priority queue.  It specifically tests the bulk range functions, making sure
+ * a block inserted into the middle of an array lands in the right place and
+ * that removing a block closes the gap it leaves.
+ */
+void test_dynarray_ranges() {
+  struct dynarray* da = dynarray_create();
+  int vals[64];
+  void* block[32];
+  int i;
+
+  for (i = 0; i < 64; i++) {
+    vals[i] = i;
+  }
+
+  /*
+   * Build the array [0..15] [32..63] using appends, then splice [16..31] into
+   * the middle so the whole thing holds 0 through 63 in order.
+   */
+  for (i = 0; i < 16; i++) {
+    block[i] = &vals[i];
+  }
+  dynarray_append_array(da, block, 16);
+  for (i = 0; i < 32; i++) {
+    block[i] = &vals[32 + i];
+  }
+  dynarray_append_array(da, block, 32);
+  for (i = 0; i < 16; i++) {
+    block[i] = &vals[16 + i];
+  }
+  dynarray_insert_range(da, 16, block, 16);
+
+  TEST_CHECK_(dynarray_length(da) == 64, "length after inserts is correct "
+    "(%d == %d)", (int)dynarray_length(da), 64);
+  for (i = 0; i < 64; i++) {
+    TEST_CHECK_(*(int*)dynarray_get(da, i) == i,
+      "%d'th value after inserts is correct (%d == %d)", i,
+      *(int*)dynarray_get(da, i), i);
+  }
+
+  /*
+   * Remove [8..39] and make sure [0..7] [40..63] is what's left.
+   */
+  dynarray_remove_range(da, 8, 32);
+  TEST_CHECK_(dynarray_length(da) == 32, "length after remove is correct "
+    "(%d == %d)", (int)dynarray_length(da), 32);
+  for (i = 0; i < 32; i++) {
+    int expected = i < 8 ? i : i + 32;
+    TEST_CHECK_(*(int*)dynarray_get(da, i) == expected,
+      "%d'th value after remove is correct (%d == %d)", i,
+      *(int*)dynarray_get(da, i), expected);
+  }
+
+  dynarray_free(da);
+}
+
+
+/*
+ * This function specifies a unit test for the dynamic array underlying the
+ * priority queue.  It specifically tests that appending grows the array's
+ * capacity geometrically, for the default growth factor and a smaller one,
+ * that dynarray_reserve() makes room up front so later inserts don't move the
+ * array, and that dynarray_shrink_to_fit() trims the capacity to the length
+ * without losing any values.
+ */
+void test_dynarray_growth() {
+  double factors[] = {2.0, 1.5};
+  int max_resizes[] = {10, 16};
+  struct dynarray* da;
+  int vals[1000];
+  void* data;
+  size_t capacity;
+  int i, j, resizes;
+
+  for (i = 0; i < 1000; i++) {
+    vals[i] = i;
+  }
+
+  /*
+   * 1000 appends should only take a logarithmic number of resizes.
+   */
+  for (j = 0; j < 2; j++) {
+    da = dynarray_create();
+    dynarray_set_growth_factor(da, factors[j]);
+    capacity = da->capacity;
+    resizes = 0;
+    for (i = 0; i < 1000; i++) {
+      dynarray_insert(da, DYNARRAY_END, &vals[i]);
+      if (da->capacity != capacity) {
+        TEST_CHECK_(da->capacity >= da->length, "capacity covers length");
+        capacity = da->capacity;
+        resizes++;
+      }
+    }
+    TEST_CHECK_(resizes <= max_resizes[j], "growth factor %g took few resizes "
+      "(%d <= %d)", factors[j], resizes, max_resizes[j]);
+    dynarray_free(da);
+  }
+
+  /*
+   * Reserving room for every value up front means the array never moves.
+   */
+  da = dynarray_create();
+  TEST_CHECK_(dynarray_reserve(da, 1000) == 0, "reserve succeeded");
+  TEST_CHECK_(da->capacity >= 1000, "reserve made room (%d >= 1000)",
+    (int)da->capacity);
+  data = dynarray_data(da);
+  capacity = da->capacity;
+  for (i = 0; i < 1000; i++) {
+    dynarray_insert(da, DYNARRAY_END, &vals[i]);
+  }
+  TEST_CHECK_(dynarray_data(da) == data && da->capacity == capacity,
+    "inserts into reserved room didn't resize");
+  dynarray_reserve(da, 10);
+  TEST_CHECK_(da->capacity == capacity, "smaller reserve was ignored");
+
+  /*
+   * Shrinking trims the capacity to exactly the remaining values.
+   */
+  dynarray_remove_range(da, 100, 900);
+  dynarray_shrink_to_fit(da);
+  TEST_CHECK_(da->capacity == 100, "capacity after shrink is correct "
+    "(%d == 100)", (int)da->capacity);
+  for (i = 0; i < 100; i++) {
+    TEST_CHECK_(*(int*)dynarray_get(da, i) == i,
+      "%d'th value after shrink is correct (%d == %d)", i,
+      *(int*)dynarray_get(da, i), i);
+  }
+  dynarray_free(da);
+}
+
+
+/*
+ * This is the record type stored in the record array tests.  Its size isn't a
+ * multiple of a pointer's, so records that are copied whole, rather than
+ * field by field, still have to land at the right offsets.
+ */
+struct test_record {
+  int id;
+  double weight;
+  char tag[5];
+};
+
+
+/*
+ * This function specifies a unit test for record arrays.  It specifically
+ * inserts records at the end, front and middle of an array, and as zeroed
+ * records, and makes sure dynarray_get() returns pointers to copies of them
+ * in the right order, that dynarray_set() overwrites a record in place, that
+ * removing a record closes the gap, and that dynarray_elem_size() reports the
+ * record size.  It also inserts records taken from the array itself.
+ */
+void test_dynarray_records() {
+  struct dynarray* da = dynarray_create_sized(sizeof(struct test_record));
+  struct test_record rec, *r;
+  int expected[] = {2, 0, 7, 1}, i;
+
+  TEST_CHECK_(dynarray_elem_size(da) == sizeof(struct test_record),
+    "record size is correct (%d == %d)", (int)dynarray_elem_size(da),
+    (int)sizeof(struct test_record));
+
+  /*
+   * Build [2, 0, zeroed, 1] out of inserts at the end, front and middle.
+   */
+  for (i = 0; i < 3; i++) {
+    rec.id = i;
+    rec.weight = i / 4.0;
+    strcpy(rec.tag, "rec");
+    rec.tag[3] = (char)('0' + i);
+    dynarray_insert(da, i < 2 ? DYNARRAY_END : 0, &rec);
+  }
+  dynarray_insert(da, 2, NULL);
+
+  /*
+   * The array holds its own copies, so changing rec mustn't affect them.
+   */
+  rec.id = 7;
+  rec.weight = 7 / 4.0;
+  strcpy(rec.tag, "rec7");
+  r = dynarray_get(da, 2);
+  TEST_CHECK_(r->id == 0 && r->weight == 0.0 && r->tag[0] == '\0',
+    "inserted NULL record was zeroed");
+  dynarray_set(da, 2, &rec);
+  rec.id = -1;
+
+  TEST_CHECK_(dynarray_length(da) == 4, "length is correct (%d == 4)",
+    (int)dynarray_length(da));
+  for (i = 0; i < 4; i++) {
+    r = dynarray_get(da, i);
+    TEST_CHECK_(r->id == expected[i] && r->weight == expected[i] / 4.0 &&
+      r->tag[3] == '0' + expected[i],
+      "%d'th record is correct (%d == %d)", i, r->id, expected[i]);
+  }
+  TEST_CHECK_((char*)dynarray_get(da, 0) + sizeof(struct test_record) ==
+    (char*)dynarray_get(da, 1), "records are stored contiguously");
+
+  /*
+   * Removing the front record shifts the rest down.
+   */
+  dynarray_remove(da, 0);
+  TEST_CHECK_(dynarray_length(da) == 3, "length after remove is correct "
+    "(%d == 3)", (int)dynarray_length(da));
+  for (i = 0; i < 3; i++) {
+    r = dynarray_get(da, i);
+    TEST_CHECK_(r->id == expected[i + 1],
+      "%d'th record after remove is correct (%d == %d)", i, r->id,
+      expected[i + 1]);
+  }
+
+  dynarray_free(da);
+
+  /*
+   * Inserting one of the array's own records must copy it before the insert
+   * moves it, both with room to spare and when the array has to grow.
+   */
+  da = dynarray_create_sized(2 * sizeof(int));
+  for (i = 0; i < 2; i++) {
+    int pair[2] = {i, -i};
+    dynarray_insert(da, DYNARRAY_END, pair);
+  }
+  dynarray_insert(da, 0, dynarray_get(da, 1));
+  TEST_CHECK_(((int*)dynarray_get(da, 0))[0] == 1 &&
+    ((int*)dynarray_get(da, 1))[0] == 0 &&
+    ((int*)dynarray_get(da, 2))[0] == 1,
+    "record from the array was inserted before it");
+  while (dynarray_length(da) < da->capacity) {
+    dynarray_insert(da, DYNARRAY_END, NULL);
+  }
+  dynarray_insert(da, DYNARRAY_END, dynarray_get(da, 0));
+  r = dynarray_get(da, dynarray_length(da) - 1);
+  TEST_CHECK_(((int*)r)[0] == 1 && ((int*)r)[1] == -1,
+    "record from the array survived the array growing");
+  dynarray_free(da);
+}
+
+
+/*
+ * This function specifies a unit test for the unchecked inline accessors.  It
+ * specifically makes sure dynarray_get_unchecked() agrees with dynarray_get()
+ * for pointer and record arrays, that dynarray_set_unchecked() stores values
+ * dynarray_get() then returns, and that dynarray_data() exposes the elements
+ * as a plain C array.
+ */
+void test_dynarray_unchecked() {
+  struct dynarray* ptrs = dynarray_create();
+  struct dynarray* recs = dynarray_create_sized(2 * sizeof(int));
+  int vals[50], rec[2], ok = 1;
+  void** data;
+  int (*rec_data)[2];
+  size_t i;
+
+  for (i = 0; i < 50; i++) {
+    vals[i] = (int)i;
+    rec[0] = (int)i;
+    rec[1] = -(int)i;
+    dynarray_insert(ptrs, DYNARRAY_END, &vals[i]);
+    dynarray_insert(recs, DYNARRAY_END, rec);
+  }
+
+  for (i = 0; i < 50; i++) {
+    ok = ok && dynarray_get_unchecked(ptrs, i) == dynarray_get(ptrs, i) &&
+      dynarray_get_unchecked(recs, i) == dynarray_get(recs, i);
+  }
+  TEST_CHECK_(ok, "unchecked gets agree with dynarray_get()");
+
+  /*
+   * Reverse the pointer array in place with the unchecked accessors.
+   */
+  for (i = 0; i < 25; i++) {
+    void* tmp = dynarray_get_unchecked(ptrs, i);
+    dynarray_set_unchecked(ptrs, i, dynarray_get_unchecked(ptrs, 49 - i));
+    dynarray_set_unchecked(ptrs, 49 - i, tmp);
+  }
+  data = dynarray_data(ptrs);
+  rec_data = dynarray_data(recs);
+  for (i = 0, ok = 1; i < 50; i++) {
+    ok = ok && dynarray_get(ptrs, i) == &vals[49 - i] &&
+      data[i] == &vals[49 - i] && rec_data[i][0] == (int)i &&
+      rec_data[i][1] == -(int)i;
+  }
+  TEST_CHECK_(ok, "unchecked sets and data pointers are consistent");
+
+  dynarray_free(ptrs);
+  dynarray_free(recs);
+}
+
+
+/*
+ * This function specifies a unit test for the dynamic array underlying the
+ * priority queue.  It specifically tests that values survive moving out of the
+ * array's built-in small buffer as it grows and back into it when the array is
+ * shrunk, for both pointer arrays and record arrays.
+ */
+void test_dynarray_small_buffer() {
+  struct dynarray* ptrs = dynarray_create();
+  struct dynarray* recs = dynarray_create_sized(3 * sizeof(int));
+  int vals[100], rec[3];
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    vals[i] = i;
+    rec[0] = i;
+    rec[1] = -i;
+    rec[2] = 2 * i;
+    dynarray_insert(ptrs, DYNARRAY_END, &vals[i]);
+    dynarray_insert(recs, DYNARRAY_END, rec);
+  }
+
+  /*
+   * Remove all but the first 2 values and shrink both arrays, which should
+   * move their remaining values back into the small buffer.
+   */
+  dynarray_remove_range(ptrs, 2, 98);
+  dynarray_remove_range(recs, 2, 98);
+  dynarray_shrink_to_fit(ptrs);
+  dynarray_shrink_to_fit(recs);
+  TEST_CHECK_(dynarray_data(ptrs) == ptrs->small.bytes &&
+    dynarray_data(recs) == recs->small.bytes,
+    "both arrays moved back into their small buffers");
+
+  for (i = 0; i < 2; i++) {
+    int* r = dynarray_get(recs, i);
+    TEST_CHECK_(*(int*)dynarray_get(ptrs, i) == i,
+      "%d'th pointer value is correct (%d == %d)", i,
+      *(int*)dynarray_get(ptrs, i), i);
+    TEST_CHECK_(r[0] == i && r[1] == -i && r[2] == 2 * i,
+      "%d'th record is correct ({%d, %d, %d} == {%d, %d, %d})", i, r[0], r[1],
+      r[2], i, -i, 2 * i);
+  }
+
+  dynarray_free(ptrs);
+  dynarray_free(recs);
+}
+
+
+/*
+ * This function specifies a unit test for file-backed dynamic arrays.  It
+ * specifically fills a mapped array with enough records to make its file grow
+ * several times, then closes and reopens the file and makes sure all of the
+ * records come back.
+ */
+void test_dynarray_mapped() {
+  const char* path = "dynarray_test.bin";
+  struct dynarray* da;
+  int rec[2];
+  size_t i, n = 10000;
+
+  remove(path);
+  da = dynarray_open_mapped(path, sizeof(rec));
+  TEST_CHECK_(da != NULL, "mapped array was created");
+  if (!da) {
+    return;
+  }
+
+  for (i = 0; i < n; i++) {
+    rec[0] = (int)i;
+    rec[1] = (int)(n - i);
+    dynarray_insert(da, DYNARRAY_END, rec);
+  }
+  TEST_CHECK_(dynarray_sync(da) == 0, "mapped array was synced");
+  dynarray_free(da);
+
+  /*
+   * Opening the file with the wrong record size should fail instead of
+   * misinterpreting its contents.
+   */
+  da = dynarray_open_mapped(path, 3 * sizeof(int));
+  TEST_CHECK_(da == NULL, "mapped array with wrong record size was rejected");
+
+  da = dynarray_open_mapped(path, sizeof(rec));
+  TEST_CHECK_(da != NULL, "mapped array was reopened");
+  if (!da) {
+    return;
+  }
+  TEST_CHECK_(dynarray_length(da) == n, "reopened length is correct "
+    "(%d == %d)", (int)dynarray_length(da), (int)n);
+  for (i = 0; i < n; i++) {
+    int* r = dynarray_get(da, i);
+    TEST_CHECK_(r[0] == (int)i && r[1] == (int)(n - i),
+      "%d'th reopened record is correct ({%d, %d} == {%d, %d})", (int)i,
+      r[0], r[1], (int)i, (int)(n - i));
+  }
+  dynarray_free(da);
+  remove(path);
+}
+
+
+/*
+ * This function specifies a unit test for a mapped array whose file can't
+ * grow.  It caps the size of files this process may write, fills a mapped
+ * array until its file reaches the cap, and makes sure the insert that needs
+ * more room fails and leaves the array's records in place.
+ */
+void test_dynarray_mapped_full() {
+  const char* path = "dynarray_full_test.bin";
+  struct dynarray* da;
+  struct rlimit limit;
+  int rec[2];
+  int i, failed = 0;
+  size_t n = 0;
+
+  remove(path);
+  da = dynarray_open_mapped(path, sizeof(rec));
+  TEST_CHECK_(da != NULL, "mapped array was created");
+  if (!da) {
+    return;
+  }
+
+  /*
+   * Tests run in their own process, so the cap doesn't outlive this one.
+   */
+  signal(SIGXFSZ, SIG_IGN);
+  limit.rlim_cur = limit.rlim_max = 64 * 1024;
+  TEST_CHECK_(setrlimit(RLIMIT_FSIZE, &limit) == 0, "file size was capped");
+
+  for (i = 0; i < 100000 && !failed; i++) {
+    rec[0] = i;
+    rec[1] = -i;
+    if (dynarray_insert(da, DYNARRAY_END, rec) == 0) {
+      n++;
+    } else {
+      failed = 1;
+    }
+  }
+  TEST_CHECK_(failed, "insert past the file size cap failed");
+  TEST_CHECK_(dynarray_length(da) == n, "failed insert left length unchanged "
+    "(%d == %d)", (int)dynarray_length(da), (int)n);
+  TEST_CHECK_(dynarray_reserve(da, 100000) == -1,
+    "reserve past the file size cap failed");
+  for (i = 0; (size_t)i < n; i++) {
+    int* r = dynarray_get(da, i);
+    TEST_CHECK_(r[0] == i && r[1] == -i,
+      "%d'th record survived the failed insert ({%d, %d} == {%d, %d})", i,
+      r[0], r[1], i, -i);
+  }
+  dynarray_free(da);
+  remove(path);
+}
+
+
+/*
+ * This function specifies a unit test for arenas.  It specifically makes sure
+ * that releasing the most recent allocation through arena_allocator() rolls
+ * it back so the next allocation reuses its memory, that releasing an older
+ * allocation doesn't, that the most recent allocation is resized in place,
+ * and that arena_reset() starts handing out the arena's first block again.
+ */
+void test_arena_rollback() {
+  struct arena* arena = arena_create(256);
+  struct allocator alloc = arena_allocator(arena);
+  char *first, *a, *b, *c;
+
+  first = alloc.alloc(alloc.ctx, 16);
+  a = alloc.alloc(alloc.ctx, 16);
+  alloc.release(alloc.ctx, a, 16);
+  b = alloc.alloc(alloc.ctx, 16);
+  TEST_CHECK_(b == a, "most recent allocation was rolled back");
+
+  alloc.alloc(alloc.ctx, 16);
+  alloc.release(alloc.ctx, b, 16);
+  TEST_CHECK_(alloc.alloc(alloc.ctx, 16) != b,
+    "older allocation was not rolled back");
+
+  c = alloc.alloc(alloc.ctx, 16);
+  c[0] = 'x';
+  TEST_CHECK_(alloc.resize(alloc.ctx, c, 16, 48) == c,
+    "most recent allocation was resized in place");
+  c = alloc.resize(alloc.ctx, c, 48, 1024);
+  TEST_CHECK_(c[0] == 'x', "contents survived resize into a new block");
+
+  arena_reset(arena);
+  TEST_CHECK_(arena_alloc(arena, 16) == first,
+    "reset arena reuses its first block");
+  arena_free(arena);
+}
+
+
+/*
+ * This function specifies a unit test for pools.  It specifically makes sure
+ * that a pool hands out distinct objects, that a released object is the next
+ * one handed out, and that the pool keeps working once it needs more than one
+ * block.
+ */
+void test_pool_free_list() {
+  struct pool* pool = pool_create(24, 4);
+  void* objs[10];
+  int i, j, distinct = 1;
+
+  for (i = 0; i < 10; i++) {
+    objs[i] = pool_alloc(pool);
+    for (j = 0; j < i; j++) {
+      distinct = distinct && objs[i] != objs[j];
+    }
+  }
+  TEST_CHECK_(distinct, "pool handed out distinct objects");
+
+  pool_release(pool, objs[3]);
+  pool_release(pool, objs[7]);
+  TEST_CHECK_(pool_alloc(pool) == objs[7], "last released object was reused");
+  TEST_CHECK_(pool_alloc(pool) == objs[3], "first released object was reused");
+  pool_free(pool);
+}
+
+
+/*
+ * This function specifies a unit test for dynarray_create_with_alloc(),
+ * dynarray_create_sized_with_alloc() and pq_create_with_alloc().  It
+ * specifically builds arrays and PQs on an arena and on a pool and makes sure
+ * they hold the right values.  A pool can't grow an allocation past its
+ * object size, so the pool's objects are made big enough for each structure
+ * and for the array behind it at its largest.
+ */
+void test_create_with_alloc() {
+  struct arena* arena = arena_create(0);
+  struct pool* pool = pool_create(512, 16);
+  struct allocator allocs[2];
+  struct dynarray *ptrs, *recs;
+  struct pq* pq;
+  int vals[32], i, j, ok;
+
+  allocs[0] = arena_allocator(arena);
+  allocs[1] = pool_allocator(pool);
+  for (i = 0; i < 32; i++) {
+    vals[i] = i;
+  }
+
+  for (j = 0; j < 2; j++) {
+    ptrs = dynarray_create_with_alloc(&allocs[j]);
+    for (i = 0; i < 32; i++) {
+      dynarray_insert(ptrs, DYNARRAY_END, &vals[i]);
+    }
+    for (i = 0, ok = dynarray_length(ptrs) == 32; i < 32 && ok; i++) {
+      ok = dynarray_get(ptrs, i) == &vals[i];
+    }
+    TEST_CHECK_(ok, "pointer array %d holds the right values", j);
+    dynarray_free(ptrs);
+
+    recs = dynarray_create_sized_with_alloc(2 * sizeof(int), &allocs[j]);
+    for (i = 0; i < 32; i++) {
+      int rec[2] = {i, -i};
+      dynarray_insert(recs, DYNARRAY_END, rec);
+    }
+    for (i = 0, ok = dynarray_length(recs) == 32; i < 32 && ok; i++) {
+      int* rec = dynarray_get(recs, i);
+      ok = rec[0] == i && rec[1] == -i;
+    }
+    TEST_CHECK_(ok, "record array %d holds the right values", j);
+    dynarray_free(recs);
+
+    pq = pq_create_with_alloc(&allocs[j]);
+    for (i = 0; i < 16; i++) {
+      pq_insert(pq, &vals[i], (i * 7) % 16);
+    }
+    for (i = 15, ok = 1; i >= 0 && ok; i--) {
+      ok = pq_max_priority(pq) == i && pq_max_dequeue(pq) == &vals[i * 7 % 16];
+    }
+    TEST_CHECK_(ok && pq_isempty(pq), "PQ %d dequeued in order", j);
+    pq_free(pq);
+  }
+
+  arena_free(arena);
+  pool_free(pool);
+}
+
+
 /****************************************************************************
  **
  ** Test listing
@@ -275,5 +846,15 @@ TEST_LIST = {
   { "pq_create", test_pq_create },
   { "pq_insert_single", test_pq_insert_single },
   { "pq_insert_multiple", test_pq_insert_multiple },
+  { "dynarray_ranges", test_dynarray_ranges },
+  { "dynarray_growth", test_dynarray_growth },
+  { "dynarray_records", test_dynarray_records },
+  { "dynarray_unchecked", test_dynarray_unchecked },
+  { "dynarray_small_buffer", test_dynarray_small_buffer },
+  { "dynarray_mapped", test_dynarray_mapped },
+  { "dynarray_mapped_full", test_dynarray_mapped_full },
+  { "arena_rollback", test_arena_rollback },
+  { "pool_free_list", test_pool_free_list },
+  { "create_with_alloc", test_create_with_alloc },
   { NULL, NULL }
 };